@@ -19,18 +19,42 @@ FOUNDATION_EXPORT const unsigned char YYCacheVersionString[];
 #import <YYCache/YYMemoryCache.h>
 #import <YYCache/YYDiskCache.h>
 #import <YYCache/YYKVStorage.h>
+#import <YYCache/YYCacheLatency.h>
+#import <YYCache/YYCacheKey.h>
+#import <YYCache/YYCacheMissRatio.h>
+#import <YYCache/YYCacheHotKeys.h>
 #elif __has_include(<YYWebImage/YYCache.h>)
 #import <YYWebImage/YYMemoryCache.h>
 #import <YYWebImage/YYDiskCache.h>
 #import <YYWebImage/YYKVStorage.h>
+#import <YYWebImage/YYCacheLatency.h>
+#import <YYWebImage/YYCacheKey.h>
+#import <YYWebImage/YYCacheMissRatio.h>
+#import <YYWebImage/YYCacheHotKeys.h>
 #else
 #import "YYMemoryCache.h"
 #import "YYDiskCache.h"
 #import "YYKVStorage.h"
+#import "YYCacheLatency.h"
+#import "YYCacheKey.h"
+#import "YYCacheMissRatio.h"
+#import "YYCacheHotKeys.h"
 #endif
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ The statistics of the read-through path of a cache (`objectForKey:loader:` and
+ refresh-ahead). See the `statistics` of `memoryCache` and `diskCache` for the
+ hits and misses of each layer.
+ */
+typedef struct {
+    uint64_t loads;         ///< loader invocations (coalesced misses count once)
+    uint64_t loadFailures;  ///< loader invocations which returned nil
+    uint64_t refreshes;     ///< loader invocations for refresh-ahead
+    NSTimeInterval loadTime; ///< total time (in seconds) spent in the loader
+} YYCacheStatistics;
+
 
 /**
  `YYCache` is a thread safe key-value cache.
@@ -54,6 +78,29 @@ NS_ASSUME_NONNULL_BEGIN
 /** The underlying disk cache. see `YYDiskCache` for more information.*/
 @property (strong, readonly) YYDiskCache *diskCache;
 
+/**
+ The loader used to refresh the objects ahead of expiration, see `refreshAfter`.
+ The default value is nil.
+ */
+@property (nullable, copy) id<NSCoding> _Nullable (^loader)(NSString *key);
+
+/**
+ The soft expiry (in seconds) of the objects in memory cache. The default value is 0 (no refresh).
+ 
+ @discussion When a `loader` is registered, an object read `refreshAfter` seconds
+ after it's stored is still returned immediately, and a reload of the key is
+ started in background (once per key, coalesced with `objectForKey:loader:`).
+ If the loader returns nil, the current object is kept until it's trimmed.
+ It should be less than the `ageLimit` of the memory cache, so the readers of
+ popular keys never pay the full miss latency.
+ */
+@property NSTimeInterval refreshAfter;
+
+/**
+ The statistics of the read-through path (read-only).
+ */
+@property (readonly) YYCacheStatistics statistics;
+
 /**
  Create a new instance with the specified name.
  Multiple instances with the same name will make the cache unstable.
@@ -182,6 +229,40 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)objectForKey:(NSString *)key withBlock:(nullable void(^)(NSString *key, id<NSCoding> object))block;
 
+/**
+ Returns the value associated with a given key, the value is loaded with the
+ loader if it's neither in memory cache nor in disk cache.
+ This method may blocks the calling thread until the value is loaded.
+ 
+ @param key    A string identifying the value. If nil, just return nil.
+ @param loader A block which returns the value of the key. If nil, it calls `objectForKey:`.
+ @return The value associated with key, or nil if the loader returns nil.
+ 
+ @discussion Concurrent misses of the same key are coalesced: only one thread
+ invokes the loader, the others wait for its result. The loaded value is stored
+ in both memory cache and disk cache.
+ 
+ @warning The loader should not call this method with the same key, it will deadlock.
+ */
+- (nullable id<NSCoding>)objectForKey:(NSString *)key loader:(nullable id<NSCoding> _Nullable (^)(NSString *key))loader;
+
+/**
+ Returns the value associated with a given key, the value is loaded with the
+ loader if it's neither in memory cache nor in disk cache.
+ This method returns immediately and invoke the passed block in background queue
+ when the value is loaded.
+ 
+ @param key    A string identifying the value. If nil, just return nil.
+ @param loader A block which returns the value of the key, it's invoked in background queue.
+ @param block  A block which will be invoked in background queue when finished.
+ 
+ @discussion Concurrent misses of the same key (from this method or the sync one)
+ are coalesced into one loader invocation, see `objectForKey:loader:`.
+ */
+- (void)objectForKey:(NSString *)key
+              loader:(nullable id<NSCoding> _Nullable (^)(NSString *key))loader
+           withBlock:(nullable void(^)(NSString *key, id<NSCoding> _Nullable object))block;
+
 /**
  Sets the value of the specified key in the cache.
  This method may blocks the calling thread until file write finished.
@@ -12,8 +12,30 @@
 #import "YYCache.h"
 #import "YYMemoryCache.h"
 #import "YYDiskCache.h"
+#import "YYCacheKey.h"
+#import <QuartzCore/QuartzCore.h>
+#import <pthread.h>
+
+/**
+ A pending load of a key. The first thread which misses the key (the leader)
+ invokes the loader, other threads which miss the same key wait on the group.
+ */
+@interface _YYCacheLoad : NSObject {
+    @package
+    dispatch_group_t _group; // left by the leader when the object is loaded
+    id<NSCoding> _object;
+}
+@end
+
+@implementation _YYCacheLoad
+@end
 
-@implementation YYCache
+
+@implementation YYCache {
+    pthread_mutex_t _loadLock;
+    NSMutableDictionary<NSString *, _YYCacheLoad *> *_loads; // key -> pending load
+    YYCacheStatistics _statistics; // accessed in _loadLock
+}
 
 - (instancetype) init {
     NSLog(@"Use \"initWithName\" or \"initWithPath\" to create YYCache instance.");
@@ -39,9 +61,15 @@
     _name = name;
     _diskCache = diskCache;
     _memoryCache = memoryCache;
+    pthread_mutex_init(&_loadLock, NULL);
+    _loads = [NSMutableDictionary new];
     return self;
 }
 
+- (void)dealloc {
+    pthread_mutex_destroy(&_loadLock);
+}
+
 + (instancetype)cacheWithName:(NSString *)name {
 	return [[YYCache alloc] initWithName:name];
 }
@@ -50,6 +78,39 @@
     return [[YYCache alloc] initWithPath:path];
 }
 
+/// Store the object in memory cache, with the refresh time if there's a loader.
+- (void)_setMemoryObject:(id<NSCoding>)object forKey:(NSString *)key {
+    NSTimeInterval refreshAfter = self.loader ? self.refreshAfter : 0;
+    [_memoryCache setObject:object forKey:key withCost:0 ttl:0 refreshAfter:refreshAfter];
+}
+
+/// Returns the object in memory cache, a reload is started in background if
+/// the object needs refresh, the current object is returned meanwhile.
+- (id<NSCoding>)_memoryObjectForKey:(NSString *)key loader:(id<NSCoding> (^)(NSString *key))loader {
+    BOOL needsRefresh = NO;
+    id<NSCoding> object = [_memoryCache objectForKey:key needsRefresh:&needsRefresh];
+    if (needsRefresh) [self _refreshObjectForKey:key loader:loader ?: self.loader];
+    return object;
+}
+
+- (void)_refreshObjectForKey:(NSString *)key loader:(id<NSCoding> (^)(NSString *key))loader {
+    if (!loader) return;
+    BOOL leader;
+    _YYCacheLoad *load = [self _joinLoadForKey:key leader:&leader];
+    // 已经有线程在加载
+    if (!leader) return;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self _runLoad:load forKey:key loader:loader refresh:YES];
+    });
+}
+
+- (YYCacheStatistics)statistics {
+    pthread_mutex_lock(&_loadLock);
+    YYCacheStatistics statistics = _statistics;
+    pthread_mutex_unlock(&_loadLock);
+    return statistics;
+}
+
 - (BOOL)containsObjectForKey:(NSString *)key {
     return [_memoryCache containsObjectForKey:key] || [_diskCache containsObjectForKey:key];
 }
@@ -67,11 +128,11 @@
 }
 
 - (id<NSCoding>)objectForKey:(NSString *)key {
-    id<NSCoding> object = [_memoryCache objectForKey:key];
+    id<NSCoding> object = [self _memoryObjectForKey:key loader:nil];
     if (!object) {
         object = [_diskCache objectForKey:key];
         if (object) {
-            [_memoryCache setObject:object forKey:key];
+            [self _setMemoryObject:object forKey:key];
         }
     }
     return object;
@@ -79,7 +140,7 @@
 
 - (void)objectForKey:(NSString *)key withBlock:(void (^)(NSString *key, id<NSCoding> object))block {
     if (!block) return;
-    id<NSCoding> object = [_memoryCache objectForKey:key];
+    id<NSCoding> object = [self _memoryObjectForKey:key loader:nil];
     if (object) {
         dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
             block(key, object);
@@ -89,14 +150,115 @@
     }
 }
 
+/// Returns the pending load of the key, a new load is created if there's none,
+/// `leader` is set to YES if the caller should invoke the loader.
+- (_YYCacheLoad *)_joinLoadForKey:(NSString *)key leader:(BOOL *)leader {
+    pthread_mutex_lock(&_loadLock);
+    _YYCacheLoad *load = _loads[key];
+    *leader = load == nil;
+    if (!load) {
+        load = [_YYCacheLoad new];
+        load->_group = dispatch_group_create();
+        dispatch_group_enter(load->_group);
+        _loads[key] = load;
+    }
+    pthread_mutex_unlock(&_loadLock);
+    return load;
+}
+
+/// Invoked by the leader: look up the memory cache and disk cache again, then
+/// the loader. The loaded object is stored in the memory cache, and the waiters
+/// are woken before it's written to the disk cache. A refresh always invokes
+/// the loader, and keeps the current object if the loader returns nil.
+- (id<NSCoding>)_runLoad:(_YYCacheLoad *)load forKey:(NSString *)key loader:(id<NSCoding> (^)(NSString *key))loader refresh:(BOOL)refresh {
+    // 磁盘缓存会读取和写入同一个key，预先计算UTF-8和文件名
+    key = [YYCacheKey keyWithString:key];
+    id<NSCoding> object = nil;
+    BOOL loaded = NO;
+    NSTimeInterval loadTime = -1; // <0 means the loader isn't invoked
+    if (refresh) {
+        NSTimeInterval begin = CACurrentMediaTime();
+        object = loader(key);
+        loadTime = CACurrentMediaTime() - begin;
+        loaded = object != nil;
+        if (loaded) [self _setMemoryObject:object forKey:key];
+        else object = [_memoryCache objectForKey:key];
+    } else {
+        // 在加入等待表之前，其他线程可能刚刚加载完成
+        object = [_memoryCache objectForKey:key];
+        if (!object) {
+            object = [_diskCache objectForKey:key];
+            if (!object) {
+                NSTimeInterval begin = CACurrentMediaTime();
+                object = loader(key);
+                loadTime = CACurrentMediaTime() - begin;
+                loaded = object != nil;
+            }
+            if (object) [self _setMemoryObject:object forKey:key];
+        }
+    }
+    load->_object = object;
+    pthread_mutex_lock(&_loadLock);
+    [_loads removeObjectForKey:key];
+    if (loadTime >= 0) {
+        _statistics.loads++;
+        if (!loaded) _statistics.loadFailures++;
+        if (refresh) _statistics.refreshes++;
+        _statistics.loadTime += loadTime;
+    }
+    pthread_mutex_unlock(&_loadLock);
+    // 唤醒等待的线程
+    dispatch_group_leave(load->_group);
+    if (loaded) [_diskCache setObject:object forKey:key];
+    return object;
+}
+
+- (id<NSCoding>)objectForKey:(NSString *)key loader:(id<NSCoding> (^)(NSString *key))loader {
+    if (!key) return nil;
+    if (!loader) return [self objectForKey:key];
+    id<NSCoding> object = [self _memoryObjectForKey:key loader:loader];
+    if (object) return object;
+    // 同一个key同时只有一个线程加载，其他线程等待它的结果
+    BOOL leader;
+    _YYCacheLoad *load = [self _joinLoadForKey:key leader:&leader];
+    if (leader) return [self _runLoad:load forKey:key loader:loader refresh:NO];
+    dispatch_group_wait(load->_group, DISPATCH_TIME_FOREVER);
+    return load->_object;
+}
+
+- (void)objectForKey:(NSString *)key loader:(id<NSCoding> (^)(NSString *key))loader withBlock:(void (^)(NSString *key, id<NSCoding> object))block {
+    if (!block) return;
+    if (!loader) {
+        [self objectForKey:key withBlock:block];
+        return;
+    }
+    id<NSCoding> object = key ? [self _memoryObjectForKey:key loader:loader] : nil;
+    if (object || !key) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            block(key, object);
+        });
+        return;
+    }
+    BOOL leader;
+    _YYCacheLoad *load = [self _joinLoadForKey:key leader:&leader];
+    dispatch_group_notify(load->_group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        block(key, load->_object);
+    });
+    if (leader) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self _runLoad:load forKey:key loader:loader refresh:NO];
+        });
+    }
+}
+
 // 缓存实现，默认同时进行内存缓存与文件缓存
 - (void)setObject:(id<NSCoding>)object forKey:(NSString *)key {
-    [_memoryCache setObject:object forKey:key];
+    [self _setMemoryObject:object forKey:key];
     [_diskCache setObject:object forKey:key];
 }
 
 - (void)setObject:(id<NSCoding>)object forKey:(NSString *)key withBlock:(void (^)(void))block {
-    [_memoryCache setObject:object forKey:key];
+    [self _setMemoryObject:object forKey:key];
     [_diskCache setObject:object forKey:key withBlock:block];
 }
 
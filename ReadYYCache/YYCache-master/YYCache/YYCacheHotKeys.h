@@ -0,0 +1,94 @@
+//
+//  YYCacheHotKeys.h
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A key reported by `YYCacheHotKeyTracker`.
+ */
+@interface YYCacheHotKey : NSObject
+
+/** The key. */
+@property (readonly) id key;
+
+/** The estimated number of recorded accesses, it's never less than the real number. */
+@property (readonly) uint64_t count;
+
+/** The max overestimation of `count`, the real number is at least `count - error`. */
+@property (readonly) uint64_t error;
+
+@end
+
+
+/**
+ YYCacheHotKeyTracker finds the most frequently accessed keys (heavy hitters)
+ with the Space-Saving algorithm. Set it to the `hotKeyTracker` of `YYMemoryCache`
+ or `YYDiskCache` to record the keys of their accesses, then export the hot keys
+ periodically, e.g. to move a hammered key out of the shared cache into a front
+ cache of its own.
+
+ @discussion The tracker keeps `capacity` counters. A key which is not tracked
+ takes over the counter with the least count, and inherits the count as its error.
+ So any key accessed more than 1/capacity of the recorded accesses is reported,
+ and the counts of the reported keys are accurate for a skewed workload.
+
+ A record doesn't wait: if another thread is recording at the same moment, the
+ record is dropped, so the tracker never adds a lock hot spot to the access path.
+ The counts are a sample of the accesses in that case, they are still relative
+ to each other. The tracked keys are retained until they are replaced or reset.
+ */
+@interface YYCacheHotKeyTracker : NSObject
+
+/**
+ Creates a tracker with 64 counters.
+ */
+- (instancetype)init;
+
+/**
+ The designated initializer.
+
+ @param capacity The number of counters (the max number of reported keys),
+     it's clamped to [1, 65536].
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+/** The number of counters. */
+@property (readonly) NSUInteger capacity;
+
+/** The number of recorded accesses (dropped ones excluded). */
+@property (readonly) uint64_t recordedCount;
+
+/**
+ Records an access of the key.
+
+ @param key The key, it should be immutable (it's retained, and compared with
+     `hash` and `isEqual:`). If nil, this method has no effect.
+ */
+- (void)recordKey:(id)key;
+
+/**
+ Returns the hottest keys, in descending order of count.
+
+ @param count The max number of keys to return.
+ @param reset Whether to remove all counters, so the next export only contains
+     the accesses after this one.
+ */
+- (NSArray<YYCacheHotKey *> *)hotKeys:(NSUInteger)count reset:(BOOL)reset;
+
+/**
+ Removes all counters.
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,249 @@
+//
+//  YYCacheHotKeys.m
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import "YYCacheHotKeys.h"
+#import <pthread.h>
+
+/*
+ Space-Saving (Metwally et al., 2005): `capacity` counters in a min-heap by count,
+ and a hash table (linear probing) from key to counter. A tracked key increases
+ its count and sinks in the heap; an untracked key replaces the key of the heap
+ root (the least count), with count = min + 1 and error = min.
+ */
+#define _YYHotKeyNil UINT32_MAX
+#define _YYHotKeyMaxCapacity 65536
+
+typedef struct {
+    CFTypeRef key;     // retained
+    NSUInteger hash;
+    uint64_t count;
+    uint64_t error;
+    uint32_t heapIndex;
+} _YYHotKeyCounter;
+
+
+@implementation YYCacheHotKey {
+    @package
+    id _key;
+    uint64_t _count;
+    uint64_t _error;
+}
+
+- (id)key {
+    return _key;
+}
+
+- (uint64_t)count {
+    return _count;
+}
+
+- (uint64_t)error {
+    return _error;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> %@ count:%llu error:%llu", self.class, self, _key, _count, _error];
+}
+
+@end
+
+
+@implementation YYCacheHotKeyTracker {
+    pthread_mutex_t _lock;
+    _YYHotKeyCounter *_counters; // _capacity
+    uint32_t *_heap;             // counter indexes, min-heap by count
+    uint32_t *_table;            // counter indexes by hash
+    uint32_t _tableMask;
+    uint32_t _capacity;
+    uint32_t _count;             // counters in use
+    uint64_t _recordedCount;
+}
+
+- (instancetype)init {
+    return [self initWithCapacity:64];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    pthread_mutex_init(&_lock, NULL);
+    _capacity = (uint32_t)MAX(1, MIN(capacity, _YYHotKeyMaxCapacity));
+    uint32_t tableCapacity = 16;
+    while (tableCapacity < _capacity * 2) tableCapacity <<= 1;
+    _tableMask = tableCapacity - 1;
+    _counters = calloc(_capacity, sizeof(_YYHotKeyCounter));
+    _heap = calloc(_capacity, sizeof(uint32_t));
+    _table = malloc(tableCapacity * sizeof(uint32_t));
+    memset(_table, 0xFF, tableCapacity * sizeof(uint32_t));
+    return self;
+}
+
+- (void)dealloc {
+    for (uint32_t i = 0; i < _count; i++) CFRelease(_counters[i].key);
+    free(_counters);
+    free(_heap);
+    free(_table);
+    pthread_mutex_destroy(&_lock);
+}
+
+- (NSUInteger)capacity {
+    return _capacity;
+}
+
+- (uint64_t)recordedCount {
+    pthread_mutex_lock(&_lock);
+    uint64_t count = _recordedCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+#pragma mark - private (lock held)
+
+/// Returns the table slot of the key, or the empty slot where it should be inserted.
+- (uint32_t)_slotForKey:(CFTypeRef)key hash:(NSUInteger)hash {
+    uint32_t i = (uint32_t)(hash ^ ((uint64_t)hash >> 32)) & _tableMask;
+    while (_table[i] != _YYHotKeyNil) {
+        _YYHotKeyCounter *counter = _counters + _table[i];
+        if (counter->hash == hash && (counter->key == key || CFEqual(counter->key, key))) break;
+        i = (i + 1) & _tableMask;
+    }
+    return i;
+}
+
+/// Removes a slot with backward shift, no tombstone is left.
+- (void)_eraseSlot:(uint32_t)slot {
+    uint32_t hole = slot, i = slot;
+    while (1) {
+        i = (i + 1) & _tableMask;
+        uint32_t index = _table[i];
+        if (index == _YYHotKeyNil) break;
+        NSUInteger hash = _counters[index].hash;
+        uint32_t home = (uint32_t)(hash ^ ((uint64_t)hash >> 32)) & _tableMask;
+        if (((i - home) & _tableMask) >= ((i - hole) & _tableMask)) {
+            _table[hole] = index;
+            hole = i;
+        }
+    }
+    _table[hole] = _YYHotKeyNil;
+}
+
+- (void)_heapSwap:(uint32_t)a with:(uint32_t)b {
+    uint32_t t = _heap[a];
+    _heap[a] = _heap[b];
+    _heap[b] = t;
+    _counters[_heap[a]].heapIndex = a;
+    _counters[_heap[b]].heapIndex = b;
+}
+
+- (void)_heapSiftDown:(uint32_t)i {
+    while (1) {
+        uint32_t left = i * 2 + 1, right = left + 1, min = i;
+        if (left < _count && _counters[_heap[left]].count < _counters[_heap[min]].count) min = left;
+        if (right < _count && _counters[_heap[right]].count < _counters[_heap[min]].count) min = right;
+        if (min == i) break;
+        [self _heapSwap:i with:min];
+        i = min;
+    }
+}
+
+- (void)_heapSiftUp:(uint32_t)i {
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (_counters[_heap[parent]].count <= _counters[_heap[i]].count) break;
+        [self _heapSwap:i with:parent];
+        i = parent;
+    }
+}
+
+#pragma mark - public
+
+- (void)recordKey:(id)key {
+    if (!key) return;
+    NSUInteger hash = [key hash];
+    CFTypeRef cfKey = (__bridge CFTypeRef)key;
+    CFTypeRef replaced = NULL;
+    // 其它线程正在记录时直接丢弃，不阻塞缓存的访问
+    if (pthread_mutex_trylock(&_lock) != 0) return;
+    _recordedCount++;
+    uint32_t slot = [self _slotForKey:cfKey hash:hash];
+    uint32_t index = _table[slot];
+    if (index != _YYHotKeyNil) {
+        _counters[index].count++;
+        [self _heapSiftDown:_counters[index].heapIndex];
+    } else if (_count < _capacity) {
+        index = _count++;
+        _YYHotKeyCounter *counter = _counters + index;
+        counter->key = CFRetain(cfKey);
+        counter->hash = hash;
+        counter->count = 1;
+        counter->error = 0;
+        counter->heapIndex = index;
+        _heap[index] = index;
+        _table[slot] = index;
+        [self _heapSiftUp:index];
+    } else {
+        // 替换计数最小的key，继承它的计数作为误差
+        index = _heap[0];
+        _YYHotKeyCounter *counter = _counters + index;
+        [self _eraseSlot:[self _slotForKey:counter->key hash:counter->hash]];
+        replaced = counter->key;
+        counter->key = CFRetain(cfKey);
+        counter->hash = hash;
+        counter->error = counter->count;
+        counter->count++;
+        _table[[self _slotForKey:cfKey hash:hash]] = index;
+        [self _heapSiftDown:0];
+    }
+    pthread_mutex_unlock(&_lock);
+    if (replaced) CFRelease(replaced);
+}
+
+- (NSArray<YYCacheHotKey *> *)hotKeys:(NSUInteger)count reset:(BOOL)reset {
+    pthread_mutex_lock(&_lock);
+    uint32_t used = _count;
+    _YYHotKeyCounter *counters = malloc(MAX(1, used) * sizeof(_YYHotKeyCounter));
+    memcpy(counters, _counters, used * sizeof(_YYHotKeyCounter));
+    if (reset) {
+        // 计数器中的key交给拷贝释放
+        _count = 0;
+        _recordedCount = 0;
+        memset(_table, 0xFF, (_tableMask + 1) * sizeof(uint32_t));
+    } else {
+        for (uint32_t i = 0; i < used; i++) CFRetain(counters[i].key);
+    }
+    pthread_mutex_unlock(&_lock);
+
+    qsort_b(counters, used, sizeof(_YYHotKeyCounter), ^int(const void *a, const void *b) {
+        uint64_t ca = ((const _YYHotKeyCounter *)a)->count, cb = ((const _YYHotKeyCounter *)b)->count;
+        return ca < cb ? 1 : (ca > cb ? -1 : 0);
+    });
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:MIN(count, used)];
+    for (uint32_t i = 0; i < used; i++) {
+        if (i < count) {
+            YYCacheHotKey *hotKey = [YYCacheHotKey new];
+            hotKey->_key = (__bridge id)counters[i].key;
+            hotKey->_count = counters[i].count;
+            hotKey->_error = counters[i].error;
+            [keys addObject:hotKey];
+        }
+        CFRelease(counters[i].key);
+    }
+    free(counters);
+    return keys;
+}
+
+- (void)reset {
+    [self hotKeys:0 reset:YES];
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> capacity:%lu recorded:%llu", self.class, self, (unsigned long)_capacity, self.recordedCount];
+}
+
+@end
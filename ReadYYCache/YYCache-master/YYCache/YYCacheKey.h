@@ -0,0 +1,65 @@
+//
+//  YYCacheKey.h
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ YYCacheKey is an immutable string key, the values derived from the string are
+ computed only once: the hash, the UTF-8 bytes and the filename of `YYDiskCache`.
+
+ @discussion YYCacheKey is a subclass of NSString, so it can be passed to any
+ method which takes a key: `YYCache`, `YYMemoryCache` (uses `hash`), `YYDiskCache`
+ and `YYKVStorage` (use `UTF8String` to bind the key, and `filename` for the file
+ of a large value). Create a key once and reuse it for the lookups of the same
+ string, so a memory miss which goes to disk doesn't convert or hash the string
+ again in each tier.
+
+ A key is equal to any string with the same characters, and its hash is the same
+ as the string's hash, so it can be mixed with plain strings as keys.
+ */
+@interface YYCacheKey : NSString <NSCopying>
+
+/**
+ Returns a key for the string.
+
+ @param string The string. If it's already a YYCacheKey, it's returned directly.
+ */
++ (instancetype)keyWithString:(NSString *)string;
+
+/**
+ The designated initializer. The hash and UTF-8 bytes are computed here.
+
+ @param string The string of the key.
+ */
+- (instancetype)initWithString:(NSString *)string NS_DESIGNATED_INITIALIZER;
+
+/** The original string. */
+@property (readonly) NSString *string;
+
+/** The precomputed hash, same as `string.hash`. */
+@property (readonly) NSUInteger hash;
+
+/** The precomputed NUL-terminated UTF-8 bytes, valid during the key's lifetime. */
+@property (nullable, readonly) const char *UTF8String NS_RETURNS_INNER_POINTER;
+
+/** The length of `UTF8String` in bytes (without NUL). */
+@property (readonly) NSUInteger UTF8Length;
+
+/**
+ The MD5 of the UTF-8 bytes in lowercase hex, it's the default filename of
+ `YYDiskCache`. It's computed at the first access and then cached.
+ */
+@property (readonly) NSString *filename;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,126 @@
+//
+//  YYCacheKey.m
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import "YYCacheKey.h"
+#import <CommonCrypto/CommonCrypto.h>
+
+@implementation YYCacheKey {
+    NSString *_string;
+    NSUInteger _hash;
+    char *_utf8;
+    NSUInteger _utf8Length;
+    CFStringRef _filename; // retained, set once at the first access
+}
+
++ (instancetype)keyWithString:(NSString *)string {
+    if ([string isKindOfClass:[YYCacheKey class]]) return (YYCacheKey *)string;
+    return [[self alloc] initWithString:string];
+}
+
+- (instancetype)init {
+    return [self initWithString:@""];
+}
+
+- (instancetype)initWithCoder:(NSCoder *)aDecoder {
+    NSString *string = [[NSString alloc] initWithCoder:aDecoder];
+    return [self initWithString:string ?: @""];
+}
+
+- (instancetype)initWithString:(NSString *)string {
+    self = [super init];
+    _string = [string copy];
+    _hash = CFHash((__bridge CFStringRef)_string);
+    _utf8Length = [_string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    _utf8 = malloc(_utf8Length + 1);
+    if (![_string getCString:_utf8 maxLength:_utf8Length + 1 encoding:NSUTF8StringEncoding]) {
+        _utf8[0] = 0;
+        _utf8Length = 0;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_utf8);
+    if (_filename) CFRelease(_filename);
+}
+
+- (NSString *)string {
+    return _string;
+}
+
+- (NSUInteger)hash {
+    return _hash;
+}
+
+- (const char *)UTF8String {
+    return _utf8;
+}
+
+- (NSUInteger)UTF8Length {
+    return _utf8Length;
+}
+
+- (NSString *)filename {
+    CFStringRef filename = __atomic_load_n(&_filename, __ATOMIC_ACQUIRE);
+    if (filename) return (__bridge NSString *)filename;
+    // 多个线程可能同时计算，只有一个结果被保存
+    unsigned char result[CC_MD5_DIGEST_LENGTH];
+    CC_MD5(_utf8, (CC_LONG)_utf8Length, result);
+    NSString *string = [NSString stringWithFormat:
+                        @"%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
+                        result[0],  result[1],  result[2],  result[3],
+                        result[4],  result[5],  result[6],  result[7],
+                        result[8],  result[9],  result[10], result[11],
+                        result[12], result[13], result[14], result[15]
+                        ];
+    CFStringRef computed = CFBridgingRetain(string);
+    if (__atomic_compare_exchange_n(&_filename, &filename, computed, NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return (__bridge NSString *)computed;
+    }
+    CFRelease(computed);
+    return (__bridge NSString *)filename;
+}
+
+#pragma mark - NSString
+
+- (NSUInteger)length {
+    return _string.length;
+}
+
+- (unichar)characterAtIndex:(NSUInteger)index {
+    return [_string characterAtIndex:index];
+}
+
+- (void)getCharacters:(unichar *)buffer range:(NSRange)range {
+    [_string getCharacters:buffer range:range];
+}
+
+- (BOOL)isEqual:(id)object {
+    if (self == object) return YES;
+    if ([object isKindOfClass:[YYCacheKey class]]) {
+        YYCacheKey *key = object;
+        return _hash == key->_hash && [_string isEqualToString:key->_string];
+    }
+    return [_string isEqual:object];
+}
+
+- (BOOL)isEqualToString:(NSString *)aString {
+    return [self isEqual:aString];
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    return self; // immutable
+}
+
+- (Class)classForCoder {
+    return [NSString class]; // archived as a plain string
+}
+
+@end
@@ -0,0 +1,115 @@
+//
+//  YYCacheLatency.h
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The operations recorded by `YYCacheLatencyRecorder`.
+ */
+typedef NS_ENUM(NSUInteger, YYCacheOperation) {
+    YYCacheOperationMemoryGet = 0,   ///< -[YYMemoryCache objectForKey:]
+    YYCacheOperationMemorySet,       ///< -[YYMemoryCache setObject:forKey:]
+    YYCacheOperationMemoryTrim,      ///< each trim (cost, count, age) of YYMemoryCache
+    YYCacheOperationDiskGet,         ///< -[YYDiskCache objectForKey:]
+    YYCacheOperationDiskSet,         ///< -[YYDiskCache setObject:forKey:]
+    YYCacheOperationDiskTrim,        ///< each trim (cost, count, age, free space) of YYDiskCache
+    YYCacheOperationStorageSQLRead,  ///< a step of a read-only statement of YYKVStorage
+    YYCacheOperationStorageSQLWrite, ///< a step of a statement which writes the database
+    YYCacheOperationStorageCheckpoint, ///< a WAL checkpoint of YYKVStorage
+    YYCacheOperationStorageFileRead,   ///< a file read of YYKVStorage
+    YYCacheOperationStorageFileWrite,  ///< a file write of YYKVStorage
+    YYCacheOperationStorageFileDelete, ///< a file delete of YYKVStorage
+    YYCacheOperationCount,
+};
+
+/**
+ An immutable latency histogram, created by `YYCacheLatencyRecorder`.
+
+ @discussion The latencies are kept in log-linear buckets (32 buckets per power
+ of two, like HdrHistogram), so a percentile is accurate to about 3%.
+ Snapshots can be merged, e.g. the snapshots of several caches or periods.
+ */
+@interface YYCacheLatencySnapshot : NSObject
+
+/** The number of recorded operations. */
+@property (readonly) uint64_t count;
+
+/** The total latency in seconds. */
+@property (readonly) NSTimeInterval totalLatency;
+
+/** The max latency in seconds. */
+@property (readonly) NSTimeInterval maxLatency;
+
+/** The mean latency in seconds, 0 if there's no operation. */
+@property (readonly) NSTimeInterval meanLatency;
+
+/**
+ Returns the latency at the percentile.
+
+ @param percentile The percentile in [0, 100], such as 50, 99, 99.9.
+ @return The latency in seconds (the upper bound of its bucket), 0 if there's no operation.
+ */
+- (NSTimeInterval)latencyAtPercentile:(double)percentile;
+
+/**
+ Returns a new snapshot which contains the operations of both snapshots.
+ */
+- (YYCacheLatencySnapshot *)snapshotByMergingSnapshot:(YYCacheLatencySnapshot *)snapshot;
+
+@end
+
+
+/**
+ YYCacheLatencyRecorder records the latencies of cache operations into a histogram
+ per operation. Set it to the `latencyRecorder` of `YYMemoryCache`, `YYDiskCache`
+ or `YYKVStorage` to record their operations, a recorder may be shared by them.
+
+ @discussion Recording is lock-free (a few relaxed atomic adds), and it may be
+ called from any thread. Export the snapshots periodically with `reset` to get
+ the latencies of each period.
+ */
+@interface YYCacheLatencyRecorder : NSObject
+
+/**
+ Records an operation.
+
+ @param operation The operation.
+ @param beginTime The `mach_absolute_time()` when the operation began.
+ @return The current `mach_absolute_time()`, it's the begin time of the next operation.
+ */
+- (uint64_t)recordOperation:(YYCacheOperation)operation beginTime:(uint64_t)beginTime;
+
+/**
+ Records an operation.
+
+ @param operation The operation.
+ @param latency   The latency in nanoseconds.
+ */
+- (void)recordOperation:(YYCacheOperation)operation latency:(uint64_t)latency;
+
+/**
+ Returns the snapshot of an operation.
+
+ @param operation The operation.
+ @param reset     Whether to reset the histogram. The operations recorded while
+     resetting are in either this snapshot or the next one, none is lost.
+ */
+- (YYCacheLatencySnapshot *)snapshotForOperation:(YYCacheOperation)operation reset:(BOOL)reset;
+
+/**
+ Reset the histograms of all operations.
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,170 @@
+//
+//  YYCacheLatency.m
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import "YYCacheLatency.h"
+#import <mach/mach_time.h>
+#import <stdatomic.h>
+
+/*
+ Log-linear buckets: values below 32ns have their own bucket, above that each
+ power of two [2^e, 2^(e+1)) is split into 32 buckets. Values above 2^41ns
+ (about 36 minutes) are clamped.
+ */
+#define _YYHistogramSubBits 5
+#define _YYHistogramSubCount (1 << _YYHistogramSubBits)
+#define _YYHistogramMaxExponent 40
+#define _YYHistogramBucketCount ((_YYHistogramMaxExponent - _YYHistogramSubBits + 2) * _YYHistogramSubCount)
+
+static inline NSUInteger _YYHistogramIndex(uint64_t value) {
+    uint64_t max = (1ULL << (_YYHistogramMaxExponent + 1)) - 1;
+    if (value > max) value = max;
+    if (value < _YYHistogramSubCount) return (NSUInteger)value;
+    unsigned exponent = 63 - __builtin_clzll(value);
+    return (exponent - _YYHistogramSubBits + 1) * _YYHistogramSubCount + ((value >> (exponent - _YYHistogramSubBits)) & (_YYHistogramSubCount - 1));
+}
+
+/// The max value of the bucket.
+static inline uint64_t _YYHistogramBucketMax(NSUInteger index) {
+    if (index < _YYHistogramSubCount) return index;
+    unsigned shift = (unsigned)(index / _YYHistogramSubCount) - 1;
+    uint64_t low = (uint64_t)(_YYHistogramSubCount + index % _YYHistogramSubCount) << shift;
+    return low + (1ULL << shift) - 1;
+}
+
+typedef struct {
+    _Atomic(uint64_t) counts[_YYHistogramBucketCount];
+    _Atomic(uint64_t) total; // sum of latencies
+    _Atomic(uint64_t) max;
+} _YYHistogram;
+
+
+@implementation YYCacheLatencySnapshot {
+    @package
+    uint64_t *_counts; // _YYHistogramBucketCount
+    uint64_t _count;
+    uint64_t _total;
+    uint64_t _max;
+}
+
+- (instancetype)init {
+    self = [super init];
+    _counts = calloc(_YYHistogramBucketCount, sizeof(uint64_t));
+    return self;
+}
+
+- (void)dealloc {
+    free(_counts);
+}
+
+- (uint64_t)count {
+    return _count;
+}
+
+- (NSTimeInterval)totalLatency {
+    return _total / (double)NSEC_PER_SEC;
+}
+
+- (NSTimeInterval)maxLatency {
+    return _max / (double)NSEC_PER_SEC;
+}
+
+- (NSTimeInterval)meanLatency {
+    return _count ? _total / (double)_count / NSEC_PER_SEC : 0;
+}
+
+- (NSTimeInterval)latencyAtPercentile:(double)percentile {
+    if (_count == 0) return 0;
+    percentile = MAX(0, MIN(100, percentile));
+    uint64_t rank = (uint64_t)ceil(percentile / 100 * _count);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (NSUInteger i = 0; i < _YYHistogramBucketCount; i++) {
+        seen += _counts[i];
+        if (seen >= rank) return MIN(_YYHistogramBucketMax(i), _max) / (double)NSEC_PER_SEC;
+    }
+    return self.maxLatency;
+}
+
+- (YYCacheLatencySnapshot *)snapshotByMergingSnapshot:(YYCacheLatencySnapshot *)snapshot {
+    YYCacheLatencySnapshot *merged = [YYCacheLatencySnapshot new];
+    for (NSUInteger i = 0; i < _YYHistogramBucketCount; i++) {
+        merged->_counts[i] = _counts[i] + snapshot->_counts[i];
+    }
+    merged->_count = _count + snapshot->_count;
+    merged->_total = _total + snapshot->_total;
+    merged->_max = MAX(_max, snapshot->_max);
+    return merged;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> count:%llu p50:%.6f p99:%.6f p99.9:%.6f max:%.6f", self.class, self,
+            _count, [self latencyAtPercentile:50], [self latencyAtPercentile:99], [self latencyAtPercentile:99.9], self.maxLatency];
+}
+
+@end
+
+
+@implementation YYCacheLatencyRecorder {
+    _YYHistogram *_histograms; // YYCacheOperationCount
+    mach_timebase_info_data_t _timebase;
+}
+
+- (instancetype)init {
+    self = [super init];
+    _histograms = calloc(YYCacheOperationCount, sizeof(_YYHistogram));
+    mach_timebase_info(&_timebase);
+    return self;
+}
+
+- (void)dealloc {
+    free(_histograms);
+}
+
+- (uint64_t)recordOperation:(YYCacheOperation)operation beginTime:(uint64_t)beginTime {
+    uint64_t now = mach_absolute_time();
+    uint64_t ticks = now > beginTime ? now - beginTime : 0;
+    [self recordOperation:operation latency:ticks * _timebase.numer / _timebase.denom];
+    return now;
+}
+
+- (void)recordOperation:(YYCacheOperation)operation latency:(uint64_t)latency {
+    if (operation >= YYCacheOperationCount) return;
+    _YYHistogram *histogram = _histograms + operation;
+    atomic_fetch_add_explicit(&histogram->counts[_YYHistogramIndex(latency)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->total, latency, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (latency > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, latency, memory_order_relaxed, memory_order_relaxed));
+}
+
+- (YYCacheLatencySnapshot *)snapshotForOperation:(YYCacheOperation)operation reset:(BOOL)reset {
+    YYCacheLatencySnapshot *snapshot = [YYCacheLatencySnapshot new];
+    if (operation >= YYCacheOperationCount) return snapshot;
+    _YYHistogram *histogram = _histograms + operation;
+    for (NSUInteger i = 0; i < _YYHistogramBucketCount; i++) {
+        uint64_t count = reset ? atomic_exchange_explicit(&histogram->counts[i], 0, memory_order_relaxed)
+                               : atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+        snapshot->_counts[i] = count;
+        snapshot->_count += count;
+    }
+    // 总数由各个桶累加，与 total/max 之间不是严格一致的快照
+    snapshot->_total = reset ? atomic_exchange_explicit(&histogram->total, 0, memory_order_relaxed)
+                             : atomic_load_explicit(&histogram->total, memory_order_relaxed);
+    snapshot->_max = reset ? atomic_exchange_explicit(&histogram->max, 0, memory_order_relaxed)
+                           : atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    return snapshot;
+}
+
+- (void)reset {
+    for (NSUInteger i = 0; i < YYCacheOperationCount; i++) {
+        [self snapshotForOperation:i reset:YES];
+    }
+}
+
+@end
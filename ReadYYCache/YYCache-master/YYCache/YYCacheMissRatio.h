@@ -0,0 +1,99 @@
+//
+//  YYCacheMissRatio.h
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ YYCacheMissRatioEstimator estimates the hit ratio of a cache at other sizes
+ (the miss ratio curve), from the reuse distances of the accessed keys. Set it to
+ the `missRatioEstimator` of `YYMemoryCache` or `YYDiskCache` to record its
+ accesses, then ask the hit ratio at the candidate `countLimit` or `costLimit`.
+
+ @discussion It's an implementation of SHARDS (Waldspurger et al., FAST '15):
+ only the keys whose hash falls in a small sample (1% by default) are tracked,
+ their reuse distances (the number and cost of distinct keys accessed since the
+ last access of the same key) are scaled by the sample rate into a histogram.
+ When the sampled keys reach the limit, the sample rate is lowered, so the memory
+ is bounded (about 100 bytes per sampled key) for any number of keys.
+
+ An unsampled access only costs a hash and an atomic add, so it can be recorded
+ in the access methods. The estimation is for an LRU cache without expiration,
+ other eviction policies usually have a hit ratio not lower than LRU's. Each
+ cache should have its own estimator.
+ */
+@interface YYCacheMissRatioEstimator : NSObject
+
+/**
+ Creates an estimator with sample rate 0.01 and at most 8192 sampled keys.
+ */
+- (instancetype)init;
+
+/**
+ The designated initializer.
+
+ @param sampleRate     The initial rate of sampled keys in (0, 1]. A lower rate
+     uses less memory and CPU, but the estimation of a small cache is less accurate.
+ @param maxSampledKeys The max number of tracked keys, the sample rate is lowered
+     when it's reached. 0 means no limit.
+ */
+- (instancetype)initWithSampleRate:(double)sampleRate maxSampledKeys:(NSUInteger)maxSampledKeys NS_DESIGNATED_INITIALIZER;
+
+/** The current sample rate. */
+@property (readonly) double sampleRate;
+
+/** The number of recorded reads. */
+@property (readonly) uint64_t readCount;
+
+/** The number of recorded reads of the sampled keys. */
+@property (readonly) uint64_t sampledReadCount;
+
+/**
+ Records a read of a key (a hit or a miss of the cache).
+
+ @param hash The hash of the key, such as `key.hash`.
+ @param cost The cost of the value if it's known, 0 keeps the last recorded cost.
+ */
+- (void)recordReadWithHash:(uint64_t)hash cost:(NSUInteger)cost;
+
+/**
+ Records a write of a key. A write moves the key to the MRU position like a read,
+ but it's not counted as a reference.
+
+ @param hash The hash of the key, such as `key.hash`.
+ @param cost The cost of the value.
+ */
+- (void)recordWriteWithHash:(uint64_t)hash cost:(NSUInteger)cost;
+
+/**
+ Returns the estimated hit ratio of the recorded reads, if the cache holds at
+ most `count` objects.
+
+ @return The hit ratio in [0, 1], 0 if there's no read.
+ */
+- (double)hitRatioForCount:(NSUInteger)count;
+
+/**
+ Returns the estimated hit ratio of the recorded reads, if the cache holds at
+ most `cost` total cost.
+
+ @return The hit ratio in [0, 1], 0 if there's no read.
+ */
+- (double)hitRatioForCost:(NSUInteger)cost;
+
+/**
+ Removes the sampled keys and the histograms, and restores the initial sample rate.
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
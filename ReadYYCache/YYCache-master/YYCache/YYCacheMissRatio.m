@@ -0,0 +1,418 @@
+//
+//  YYCacheMissRatio.m
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import "YYCacheMissRatio.h"
+#import <pthread.h>
+#import <stdatomic.h>
+
+/*
+ A key is sampled if the low 24 bits of its mixed hash are below the threshold,
+ the sample rate is threshold / 2^24. Lowering the threshold removes the keys
+ above it, the remaining keys are still a uniform sample.
+
+ The reuse distance of a key is computed with Fenwick trees over the access time:
+ each sampled key adds 1 (and its cost) at the time of its last access, so the
+ distinct keys accessed after a key are the sum after its time. The times are
+ renumbered (compacted) when they reach the capacity of the trees.
+
+ The distances are kept in log-linear buckets (32 buckets per power of two, like
+ YYCacheLatencySnapshot), weighted by 1 / sample rate at the time of the read.
+ The difference between all reads and the weight of the sampled reads is counted
+ as hits of distance 0 (SHARDS_adj), it corrects the error of the few hot keys
+ which are sampled or not.
+ */
+#define _YYMissRatioSampleBits 24
+#define _YYMissRatioSampleMask ((1U << _YYMissRatioSampleBits) - 1)
+#define _YYMissRatioSubBits 5
+#define _YYMissRatioSubCount (1 << _YYMissRatioSubBits)
+#define _YYMissRatioMaxExponent 47
+#define _YYMissRatioBucketCount ((_YYMissRatioMaxExponent - _YYMissRatioSubBits + 2) * _YYMissRatioSubCount)
+#define _YYMissRatioNil UINT32_MAX
+#define _YYMissRatioDefaultCapacity 1024
+
+static inline uint64_t _YYMissRatioMix(uint64_t h) {
+    // splitmix64 finalizer, with a different constant from the shard selection of YYMemoryCache
+    h ^= 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/// Every read is counted, a thread adds to the stripe selected by its
+/// pthread_self so the readers of the cache rarely write a common cache line
+/// (as the statistics of YYMemoryCache).
+#define _YYMissRatioReadStripeCount 16
+
+typedef struct {
+    _Atomic(uint64_t) count;
+} __attribute__((aligned(128))) _YYMissRatioReadStripe;
+
+static inline void _YYMissRatioReadStripeAdd(_YYMissRatioReadStripe *stripes) {
+    NSUInteger index = _YYMissRatioMix((uintptr_t)pthread_self()) & (_YYMissRatioReadStripeCount - 1);
+    atomic_fetch_add_explicit(&stripes[index].count, 1, memory_order_relaxed);
+}
+
+static uint64_t _YYMissRatioReadStripeSum(_YYMissRatioReadStripe *stripes) {
+    uint64_t sum = 0;
+    for (NSUInteger i = 0; i < _YYMissRatioReadStripeCount; i++) {
+        sum += atomic_load_explicit(&stripes[i].count, memory_order_relaxed);
+    }
+    return sum;
+}
+
+static inline NSUInteger _YYMissRatioBucketIndex(uint64_t value) {
+    uint64_t max = (1ULL << (_YYMissRatioMaxExponent + 1)) - 1;
+    if (value > max) value = max;
+    if (value < _YYMissRatioSubCount) return (NSUInteger)value;
+    unsigned exponent = 63 - __builtin_clzll(value);
+    return (exponent - _YYMissRatioSubBits + 1) * _YYMissRatioSubCount + ((value >> (exponent - _YYMissRatioSubBits)) & (_YYMissRatioSubCount - 1));
+}
+
+static inline uint64_t _YYMissRatioBucketMin(NSUInteger index) {
+    if (index < _YYMissRatioSubCount) return index;
+    unsigned shift = (unsigned)(index / _YYMissRatioSubCount) - 1;
+    return (uint64_t)(_YYMissRatioSubCount + index % _YYMissRatioSubCount) << shift;
+}
+
+static inline uint64_t _YYMissRatioBucketWidth(NSUInteger index) {
+    if (index < _YYMissRatioSubCount) return 1;
+    return 1ULL << ((unsigned)(index / _YYMissRatioSubCount) - 1);
+}
+
+typedef struct {
+    uint64_t key;  // mixed hash
+    uint64_t cost;
+    uint32_t time; // time of the last access
+} _YYMissRatioKey;
+
+typedef struct {
+    _YYMissRatioKey *keys;
+    uint32_t keyCount;
+    uint32_t keyCapacity;
+    uint32_t maxKeys;      // 0 means no limit
+    uint32_t *table;       // index of keys, linear probing
+    uint32_t tableMask;
+    uint32_t *treeCounts;  // Fenwick tree of keys by time, 1-based
+    uint64_t *treeCosts;   // Fenwick tree of costs by time, 1-based
+    uint32_t timeCapacity;
+    uint32_t time;         // the last access time
+    uint64_t totalCost;
+    _Atomic(uint32_t) threshold;
+    double *countBuckets;  // _YYMissRatioBucketCount
+    double *costBuckets;   // _YYMissRatioBucketCount
+    double totalWeight;
+    uint64_t sampledReads;
+} _YYMissRatio;
+
+static inline void _YYMissRatioTreeAdd(_YYMissRatio *mr, uint32_t time, int32_t count, int64_t cost) {
+    for (uint32_t i = time; i <= mr->timeCapacity; i += i & -i) {
+        mr->treeCounts[i] += count;
+        mr->treeCosts[i] += cost;
+    }
+}
+
+static inline void _YYMissRatioTreeSum(_YYMissRatio *mr, uint32_t time, uint64_t *count, uint64_t *cost) {
+    uint64_t c = 0, s = 0;
+    for (uint32_t i = time; i > 0; i -= i & -i) {
+        c += mr->treeCounts[i];
+        s += mr->treeCosts[i];
+    }
+    *count = c;
+    *cost = s;
+}
+
+static inline uint32_t _YYMissRatioFind(_YYMissRatio *mr, uint64_t key, uint32_t *slot) {
+    uint32_t i = (uint32_t)(key >> 32) & mr->tableMask;
+    while (mr->table[i] != _YYMissRatioNil) {
+        if (mr->keys[mr->table[i]].key == key) break;
+        i = (i + 1) & mr->tableMask;
+    }
+    *slot = i;
+    return mr->table[i];
+}
+
+/// Removes a slot with backward shift, no tombstone is left.
+static void _YYMissRatioTableErase(_YYMissRatio *mr, uint32_t slot) {
+    uint32_t hole = slot, i = slot;
+    while (1) {
+        i = (i + 1) & mr->tableMask;
+        uint32_t index = mr->table[i];
+        if (index == _YYMissRatioNil) break;
+        uint32_t home = (uint32_t)(mr->keys[index].key >> 32) & mr->tableMask;
+        // 当前元素的理想位置不在 (hole, i] 之间时，可以移到空位
+        if (((i - home) & mr->tableMask) >= ((i - hole) & mr->tableMask)) {
+            mr->table[hole] = index;
+            hole = i;
+        }
+    }
+    mr->table[hole] = _YYMissRatioNil;
+}
+
+/// Renumbers the access times to 1...keyCount in order, and rebuilds the table and trees.
+static void _YYMissRatioCompact(_YYMissRatio *mr) {
+    // 按时间排序 (计数排序：时间各不相同，且都不超过 timeCapacity)
+    uint32_t *order = malloc((mr->time + 1) * sizeof(uint32_t));
+    memset(order, 0xFF, (mr->time + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < mr->keyCount; i++) order[mr->keys[i].time] = i;
+    _YYMissRatioKey *keys = malloc(mr->keyCapacity * sizeof(_YYMissRatioKey));
+    uint32_t count = 0;
+    for (uint32_t t = 1; t <= mr->time; t++) {
+        if (order[t] == _YYMissRatioNil) continue;
+        keys[count] = mr->keys[order[t]];
+        keys[count].time = count + 1;
+        count++;
+    }
+    free(order);
+    free(mr->keys);
+    mr->keys = keys;
+    mr->time = count;
+
+    memset(mr->table, 0xFF, (mr->tableMask + 1) * sizeof(uint32_t));
+    memset(mr->treeCounts, 0, (mr->timeCapacity + 1) * sizeof(uint32_t));
+    memset(mr->treeCosts, 0, (mr->timeCapacity + 1) * sizeof(uint64_t));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t slot;
+        _YYMissRatioFind(mr, keys[i].key, &slot);
+        mr->table[slot] = i;
+        _YYMissRatioTreeAdd(mr, keys[i].time, 1, (int64_t)keys[i].cost);
+    }
+}
+
+static void _YYMissRatioResize(_YYMissRatio *mr, uint32_t capacity) {
+    mr->keyCapacity = capacity;
+    mr->keys = realloc(mr->keys, capacity * sizeof(_YYMissRatioKey));
+    uint32_t tableCapacity = 16;
+    while (tableCapacity < capacity * 2) tableCapacity <<= 1;
+    mr->tableMask = tableCapacity - 1;
+    free(mr->table);
+    mr->table = malloc(tableCapacity * sizeof(uint32_t));
+    mr->timeCapacity = capacity * 2;
+    free(mr->treeCounts);
+    free(mr->treeCosts);
+    mr->treeCounts = malloc((mr->timeCapacity + 1) * sizeof(uint32_t));
+    mr->treeCosts = malloc((mr->timeCapacity + 1) * sizeof(uint64_t));
+    _YYMissRatioCompact(mr);
+}
+
+static void _YYMissRatioInit(_YYMissRatio *mr, double sampleRate, uint32_t maxKeys) {
+    memset(mr, 0, sizeof(_YYMissRatio));
+    uint32_t threshold = (uint32_t)MAX(1, MIN(sampleRate, 1) * (_YYMissRatioSampleMask + 1.0));
+    atomic_init(&mr->threshold, threshold);
+    mr->maxKeys = maxKeys;
+    mr->countBuckets = calloc(_YYMissRatioBucketCount, sizeof(double));
+    mr->costBuckets = calloc(_YYMissRatioBucketCount, sizeof(double));
+    _YYMissRatioResize(mr, maxKeys ? maxKeys : _YYMissRatioDefaultCapacity);
+}
+
+static void _YYMissRatioFree(_YYMissRatio *mr) {
+    free(mr->keys);
+    free(mr->table);
+    free(mr->treeCounts);
+    free(mr->treeCosts);
+    free(mr->countBuckets);
+    free(mr->costBuckets);
+}
+
+static inline BOOL _YYMissRatioSampled(_YYMissRatio *mr, uint64_t key) {
+    return (key & _YYMissRatioSampleMask) < atomic_load_explicit(&mr->threshold, memory_order_relaxed);
+}
+
+/// Lowers the sample rate by 1/8, and removes the keys which are not sampled anymore.
+/// Returns NO if the rate is already the lowest.
+static BOOL _YYMissRatioLowerRate(_YYMissRatio *mr) {
+    uint32_t threshold = atomic_load_explicit(&mr->threshold, memory_order_relaxed);
+    if (threshold <= 1) return NO;
+    threshold -= MAX(1, threshold / 8);
+    atomic_store_explicit(&mr->threshold, threshold, memory_order_relaxed);
+    for (uint32_t i = 0; i < mr->keyCount;) {
+        _YYMissRatioKey *key = mr->keys + i;
+        if (_YYMissRatioSampled(mr, key->key)) {
+            i++;
+            continue;
+        }
+        uint32_t slot;
+        _YYMissRatioFind(mr, key->key, &slot);
+        _YYMissRatioTableErase(mr, slot);
+        _YYMissRatioTreeAdd(mr, key->time, -1, -(int64_t)key->cost);
+        mr->totalCost -= key->cost;
+        // 用最后一个元素填补空位
+        mr->keyCount--;
+        if (i != mr->keyCount) {
+            *key = mr->keys[mr->keyCount];
+            _YYMissRatioFind(mr, key->key, &slot);
+            mr->table[slot] = i;
+        }
+    }
+    return YES;
+}
+
+/// Records an access of a sampled key, `cost` 0 keeps the last cost.
+static void _YYMissRatioAccess(_YYMissRatio *mr, uint64_t key, uint64_t cost, BOOL read) {
+    if (mr->time == mr->timeCapacity) _YYMissRatioCompact(mr);
+    double weight = (double)(_YYMissRatioSampleMask + 1) / atomic_load_explicit(&mr->threshold, memory_order_relaxed);
+    uint32_t slot;
+    uint32_t index = _YYMissRatioFind(mr, key, &slot);
+    if (index != _YYMissRatioNil) {
+        _YYMissRatioKey *entry = mr->keys + index;
+        if (cost == 0) cost = entry->cost;
+        if (read) {
+            // 在该key之后访问过的key的数量和开销，按采样率放大
+            uint64_t count, sum;
+            _YYMissRatioTreeSum(mr, entry->time, &count, &sum);
+            uint64_t countDistance = mr->keyCount - count;
+            uint64_t costDistance = mr->totalCost - sum;
+            mr->countBuckets[_YYMissRatioBucketIndex((uint64_t)(countDistance * weight))] += weight;
+            mr->costBuckets[_YYMissRatioBucketIndex((uint64_t)(costDistance * weight) + cost)] += weight;
+            mr->totalWeight += weight;
+            mr->sampledReads++;
+        }
+        _YYMissRatioTreeAdd(mr, entry->time, -1, -(int64_t)entry->cost);
+        mr->totalCost -= entry->cost;
+    } else {
+        if (read) {
+            // 第一次访问，任何大小都不命中
+            mr->totalWeight += weight;
+            mr->sampledReads++;
+        }
+        if (mr->maxKeys && mr->keyCount >= mr->maxKeys) {
+            while (mr->keyCount >= mr->maxKeys && _YYMissRatioSampled(mr, key) && _YYMissRatioLowerRate(mr));
+            if (mr->keyCount >= mr->maxKeys || !_YYMissRatioSampled(mr, key)) return;
+            _YYMissRatioFind(mr, key, &slot); // the table was changed
+        } else if (mr->keyCount == mr->keyCapacity) {
+            _YYMissRatioResize(mr, mr->keyCapacity * 2);
+            _YYMissRatioFind(mr, key, &slot);
+        }
+        index = mr->keyCount++;
+        mr->table[slot] = index;
+        mr->keys[index].key = key;
+    }
+    _YYMissRatioKey *entry = mr->keys + index;
+    entry->cost = cost;
+    entry->time = ++mr->time;
+    _YYMissRatioTreeAdd(mr, entry->time, 1, (int64_t)cost);
+    mr->totalCost += cost;
+}
+
+/// Returns the weight of the reads whose distance is less than `size`.
+static double _YYMissRatioWeightBelow(const double *buckets, uint64_t size) {
+    double weight = 0;
+    for (NSUInteger i = 0; i < _YYMissRatioBucketCount; i++) {
+        uint64_t min = _YYMissRatioBucketMin(i), width = _YYMissRatioBucketWidth(i);
+        if (min >= size) break;
+        if (min + width <= size) {
+            weight += buckets[i];
+        } else {
+            // 线性插值
+            weight += buckets[i] * (size - min) / width;
+        }
+    }
+    return weight;
+}
+
+
+@implementation YYCacheMissRatioEstimator {
+    pthread_mutex_t _lock;
+    _YYMissRatio _missRatio;
+    double _initialRate;
+    _YYMissRatioReadStripe *_readCounts; // _YYMissRatioReadStripeCount stripes
+}
+
+- (instancetype)init {
+    return [self initWithSampleRate:0.01 maxSampledKeys:8192];
+}
+
+- (instancetype)initWithSampleRate:(double)sampleRate maxSampledKeys:(NSUInteger)maxSampledKeys {
+    self = [super init];
+    pthread_mutex_init(&_lock, NULL);
+    _initialRate = sampleRate > 0 ? sampleRate : 0.01;
+    _YYMissRatioInit(&_missRatio, _initialRate, (uint32_t)MIN(maxSampledKeys, UINT32_MAX / 4));
+    posix_memalign((void **)&_readCounts, sizeof(_YYMissRatioReadStripe), _YYMissRatioReadStripeCount * sizeof(_YYMissRatioReadStripe));
+    memset(_readCounts, 0, _YYMissRatioReadStripeCount * sizeof(_YYMissRatioReadStripe));
+    return self;
+}
+
+- (void)dealloc {
+    _YYMissRatioFree(&_missRatio);
+    free(_readCounts);
+    pthread_mutex_destroy(&_lock);
+}
+
+- (double)sampleRate {
+    return atomic_load_explicit(&_missRatio.threshold, memory_order_relaxed) / (double)(_YYMissRatioSampleMask + 1);
+}
+
+- (uint64_t)readCount {
+    return _YYMissRatioReadStripeSum(_readCounts);
+}
+
+- (uint64_t)sampledReadCount {
+    pthread_mutex_lock(&_lock);
+    uint64_t count = _missRatio.sampledReads;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (void)recordReadWithHash:(uint64_t)hash cost:(NSUInteger)cost {
+    _YYMissRatioReadStripeAdd(_readCounts);
+    uint64_t key = _YYMissRatioMix(hash);
+    if (!_YYMissRatioSampled(&_missRatio, key)) return;
+    pthread_mutex_lock(&_lock);
+    _YYMissRatioAccess(&_missRatio, key, cost, YES);
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)recordWriteWithHash:(uint64_t)hash cost:(NSUInteger)cost {
+    uint64_t key = _YYMissRatioMix(hash);
+    if (!_YYMissRatioSampled(&_missRatio, key)) return;
+    pthread_mutex_lock(&_lock);
+    _YYMissRatioAccess(&_missRatio, key, cost, NO);
+    pthread_mutex_unlock(&_lock);
+}
+
+/// Returns the hit ratio of the reads whose distance (by count or cost) is less than `size`.
+- (double)_hitRatioForSize:(uint64_t)size byCost:(BOOL)byCost {
+    pthread_mutex_lock(&_lock);
+    const double *buckets = byCost ? _missRatio.costBuckets : _missRatio.countBuckets;
+    double reads = _YYMissRatioReadStripeSum(_readCounts);
+    double sampled = _missRatio.totalWeight;
+    double hits = sampled > 0 ? _YYMissRatioWeightBelow(buckets, size) : 0;
+    pthread_mutex_unlock(&_lock);
+    if (sampled <= 0 || reads <= 0) return 0;
+    // 未被采样到的读取 (期望值与采样值之差) 计入距离为0的命中
+    hits += size > 0 ? reads - sampled : 0;
+    return MAX(0, MIN(1, hits / reads));
+}
+
+- (double)hitRatioForCount:(NSUInteger)count {
+    return [self _hitRatioForSize:count byCost:NO];
+}
+
+- (double)hitRatioForCost:(NSUInteger)cost {
+    // 距离包含值本身的开销，不超过cost即命中
+    return [self _hitRatioForSize:(uint64_t)cost + 1 byCost:YES];
+}
+
+- (void)reset {
+    pthread_mutex_lock(&_lock);
+    uint32_t maxKeys = _missRatio.maxKeys;
+    _YYMissRatioFree(&_missRatio);
+    _YYMissRatioInit(&_missRatio, _initialRate, maxKeys);
+    for (NSUInteger i = 0; i < _YYMissRatioReadStripeCount; i++) {
+        atomic_store_explicit(&_readCounts[i].count, 0, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> reads:%llu sampled:%llu rate:%.4f", self.class, self,
+            self.readCount, self.sampledReadCount, self.sampleRate];
+}
+
+@end
@@ -11,8 +11,28 @@
 
 #import <Foundation/Foundation.h>
 
+@class YYCacheLatencyRecorder;
+@class YYCacheMissRatioEstimator;
+@class YYCacheHotKeyTracker;
+
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ The statistics of a disk cache, all counters are accumulated since the cache
+ is created.
+ */
+typedef struct {
+    uint64_t hits;           ///< reads which returned data
+    uint64_t misses;         ///< reads which returned nil
+    uint64_t writes;         ///< successful writes (insert or update)
+    uint64_t costEvictions;  ///< items removed by `costLimit` or `freeDiskSpaceLimit`
+    uint64_t countEvictions; ///< items removed by `countLimit`
+    uint64_t ageEvictions;   ///< items removed by `ageLimit`
+    uint64_t removals;       ///< items removed explicitly (removeObject..., removeAllObjects)
+    uint64_t bytesRead;      ///< bytes of the data read (before unarchiving)
+    uint64_t bytesWritten;   ///< bytes of the data written (after archiving)
+} YYDiskCacheStatistics;
+
 /**
  YYDiskCache is a thread-safe cache that stores key-value pairs backed by SQLite
  and file system (similar to NSURLCache's disk cache).
@@ -136,6 +156,36 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property BOOL errorLogsEnabled;
 
+/**
+ The recorder of the latencies of `objectForKey:`, `setObject:forKey:`, trims
+ and the SQL and file calls of the underlying storage. Default is nil (not recorded).
+ 
+ @discussion The recorder should be set before the cache is accessed by other
+ threads, and should not be replaced later (reset its snapshots instead).
+ */
+@property (nullable, strong) YYCacheLatencyRecorder *latencyRecorder;
+
+/**
+ The estimator of the hit ratio at other `countLimit` or `costLimit`, it records
+ the reads (`objectForKey:`) and writes (`setObject:forKey:`) of the cache, the
+ cost is the length of the archived data. Default is nil (not recorded).
+ 
+ @discussion The estimator should be set before the cache is accessed by other
+ threads, and should not be shared with other caches.
+ */
+@property (nullable, strong) YYCacheMissRatioEstimator *missRatioEstimator;
+
+/**
+ The tracker of the most frequently accessed keys, it records the keys of
+ `containsObjectForKey:`, `objectForKey:`, `setObject:forKey:` and
+ `removeObjectForKey:`. Default is nil (not recorded).
+ 
+ @discussion All accesses of a disk cache are serialized by one lock, a hot key
+ in the tracker may be kept in a memory cache in front of the disk cache. The
+ tracker should be set before the cache is accessed by other threads.
+ */
+@property (nullable, strong) YYCacheHotKeyTracker *hotKeyTracker;
+
 #pragma mark - Initializer
 ///=============================================================================
 /// @name Initializer
@@ -319,6 +369,15 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)totalCostWithBlock:(void(^)(NSInteger totalCost))block;
 
+/**
+ Returns the statistics of this cache.
+ The counters are updated inside the lock which the access methods already hold,
+ so counting costs nothing extra on the hot path.
+ 
+ @return The statistics accumulated since the cache is created.
+ */
+- (YYDiskCacheStatistics)statistics;
+
 
 #pragma mark - Trim
 ///=============================================================================
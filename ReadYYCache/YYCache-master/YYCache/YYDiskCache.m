@@ -11,10 +11,15 @@
 
 #import "YYDiskCache.h"
 #import "YYKVStorage.h"
+#import "YYCacheLatency.h"
+#import "YYCacheMissRatio.h"
+#import "YYCacheHotKeys.h"
+#import "YYCacheKey.h"
 #import <UIKit/UIKit.h>
 #import <CommonCrypto/CommonCrypto.h>
 #import <objc/runtime.h>
 #import <time.h>
+#import <mach/mach_time.h>
 
 #define Lock() dispatch_semaphore_wait(self->_lock, DISPATCH_TIME_FOREVER)
 #define Unlock() dispatch_semaphore_signal(self->_lock)
@@ -88,6 +93,8 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     YYKVStorage *_kv;
     dispatch_semaphore_t _lock;
     dispatch_queue_t _queue;
+    YYDiskCacheStatistics _statistics; // accessed in lock
+    YYCacheLatencyRecorder *_latencyRecorder;
 }
 
 - (void)_trimRecursively {
@@ -106,10 +113,16 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
         __strong typeof(_self) self = _self;
         if (!self) return;
         Lock();
+        YYCacheLatencyRecorder *recorder = self->_latencyRecorder;
+        uint64_t begin = recorder ? mach_absolute_time() : 0;
         [self _trimToCost:self.costLimit];
+        begin = [recorder recordOperation:YYCacheOperationDiskTrim beginTime:begin];
         [self _trimToCount:self.countLimit];
+        begin = [recorder recordOperation:YYCacheOperationDiskTrim beginTime:begin];
         [self _trimToAge:self.ageLimit];
+        begin = [recorder recordOperation:YYCacheOperationDiskTrim beginTime:begin];
         [self _trimToFreeDiskSpace:self.freeDiskSpaceLimit];
+        [recorder recordOperation:YYCacheOperationDiskTrim beginTime:begin];
         Unlock();
     });
 }
@@ -117,17 +130,19 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 - (void)_trimToCost:(NSUInteger)costLimit {
     if (costLimit >= INT_MAX) return;
     [_kv removeItemsToFitSize:(int)costLimit];
-    
+    _statistics.costEvictions += _kv.removedItemsCount;
 }
 
 - (void)_trimToCount:(NSUInteger)countLimit {
     if (countLimit >= INT_MAX) return;
     [_kv removeItemsToFitCount:(int)countLimit];
+    _statistics.countEvictions += _kv.removedItemsCount;
 }
 
 - (void)_trimToAge:(NSTimeInterval)ageLimit {
     if (ageLimit <= 0) {
         [_kv removeAllItems];
+        _statistics.ageEvictions += _kv.removedItemsCount;
         return;
     }
     long timestamp = time(NULL);
@@ -135,6 +150,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     long age = timestamp - ageLimit;
     if (age >= INT_MAX) return;
     [_kv removeItemsEarlierThanTime:(int)age];
+    _statistics.ageEvictions += _kv.removedItemsCount;
 }
 
 - (void)_trimToFreeDiskSpace:(NSUInteger)targetFreeDiskSpace {
@@ -153,7 +169,10 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 - (NSString *)_filenameForKey:(NSString *)key {
     NSString *filename = nil;
     if (_customFileNameBlock) filename = _customFileNameBlock(key);
-    if (!filename) filename = _YYNSStringMD5(key);
+    if (!filename) {
+        // YYCacheKey 已缓存了文件名，不需要再次计算MD5
+        filename = [key isKindOfClass:[YYCacheKey class]] ? ((YYCacheKey *)key).filename : _YYNSStringMD5(key);
+    }
     return filename;
 }
 
@@ -224,6 +243,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 
 - (BOOL)containsObjectForKey:(NSString *)key {
     if (!key) return NO;
+    [_hotKeyTracker recordKey:key];
     Lock();
     BOOL contains = [_kv itemExistsForKey:key];
     Unlock();
@@ -242,10 +262,23 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 
 - (id<NSCoding>)objectForKey:(NSString *)key {
     if (!key) return nil;
+    __unsafe_unretained YYCacheLatencyRecorder *recorder = _latencyRecorder;
+    uint64_t begin = recorder ? mach_absolute_time() : 0;
+    [_hotKeyTracker recordKey:key];
     Lock();
     YYKVStorageItem *item = [_kv getItemForKey:key];
+    if (item.value) {
+        _statistics.hits++;
+        _statistics.bytesRead += item.value.length;
+    } else {
+        _statistics.misses++;
+    }
     Unlock();
-    if (!item.value) return nil;
+    [_missRatioEstimator recordReadWithHash:key.hash cost:item.value.length];
+    if (!item.value) {
+        if (recorder) [recorder recordOperation:YYCacheOperationDiskGet beginTime:begin];
+        return nil;
+    }
     
     id object = nil;
     if (_customUnarchiveBlock) {
@@ -261,6 +294,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     if (object && item.extendedData) {
         [YYDiskCache setExtendedData:item.extendedData toObject:object];
     }
+    if (recorder) [recorder recordOperation:YYCacheOperationDiskGet beginTime:begin];
     return object;
 }
 
@@ -284,6 +318,8 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
         return;
     }
     
+    __unsafe_unretained YYCacheLatencyRecorder *recorder = _latencyRecorder;
+    uint64_t begin = recorder ? mach_absolute_time() : 0;
     NSData *extendedData = [YYDiskCache getExtendedDataFromObject:object];
     NSData *value = nil;
     // 你可以customArchiveBlock外部归档数据
@@ -301,6 +337,8 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
         }
     }
     if (!value) return;
+    [_missRatioEstimator recordWriteWithHash:key.hash cost:value.length];
+    [_hotKeyTracker recordKey:key];
     NSString *filename = nil;
     if (_kv.type != YYKVStorageTypeSQLite) {
         // ** 缓存类型非YYKVStorageTypeSQLite **
@@ -314,9 +352,13 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     // 加锁
 
     Lock();
-    [_kv saveItemWithKey:key value:value filename:filename extendedData:extendedData];
+    if ([_kv saveItemWithKey:key value:value filename:filename extendedData:extendedData]) {
+        _statistics.writes++;
+        _statistics.bytesWritten += value.length;
+    }
     // 解锁
     Unlock();
+    if (recorder) [recorder recordOperation:YYCacheOperationDiskSet beginTime:begin];
 }
 
 - (void)setObject:(id<NSCoding>)object forKey:(NSString *)key withBlock:(void(^)(void))block {
@@ -330,8 +372,10 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 
 - (void)removeObjectForKey:(NSString *)key {
     if (!key) return;
+    [_hotKeyTracker recordKey:key];
     Lock();
     [_kv removeItemForKey:key];
+    _statistics.removals += _kv.removedItemsCount;
     Unlock();
 }
 
@@ -347,6 +391,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 - (void)removeAllObjects {
     Lock();
     [_kv removeAllItems];
+    _statistics.removals += _kv.removedItemsCount;
     Unlock();
 }
 
@@ -369,11 +414,33 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
             return;
         }
         Lock();
-        [_kv removeAllItemsWithProgressBlock:progress endBlock:end];
+        [self->_kv removeAllItemsWithProgressBlock:progress endBlock:end];
+        self->_statistics.removals += self->_kv.removedItemsCount;
         Unlock();
     });
 }
 
+- (YYCacheLatencyRecorder *)latencyRecorder {
+    Lock();
+    YYCacheLatencyRecorder *recorder = _latencyRecorder;
+    Unlock();
+    return recorder;
+}
+
+- (void)setLatencyRecorder:(YYCacheLatencyRecorder *)latencyRecorder {
+    Lock();
+    _latencyRecorder = latencyRecorder;
+    _kv.latencyRecorder = latencyRecorder;
+    Unlock();
+}
+
+- (YYDiskCacheStatistics)statistics {
+    Lock();
+    YYDiskCacheStatistics statistics = _statistics;
+    Unlock();
+    return statistics;
+}
+
 - (NSInteger)totalCount {
     Lock();
     int count = [_kv getItemsCount];
@@ -410,7 +477,9 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 
 - (void)trimToCount:(NSUInteger)count {
     Lock();
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     [self _trimToCount:count];
+    [_latencyRecorder recordOperation:YYCacheOperationDiskTrim beginTime:begin];
     Unlock();
 }
 
@@ -425,7 +494,9 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 
 - (void)trimToCost:(NSUInteger)cost {
     Lock();
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     [self _trimToCost:cost];
+    [_latencyRecorder recordOperation:YYCacheOperationDiskTrim beginTime:begin];
     Unlock();
 }
 
@@ -440,7 +511,9 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 
 - (void)trimToAge:(NSTimeInterval)age {
     Lock();
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     [self _trimToAge:age];
+    [_latencyRecorder recordOperation:YYCacheOperationDiskTrim beginTime:begin];
     Unlock();
 }
 
@@ -11,6 +11,8 @@
 
 #import <Foundation/Foundation.h>
 
+@class YYCacheLatencyRecorder;
+
 NS_ASSUME_NONNULL_BEGIN
 
 /**
@@ -104,6 +106,10 @@ typedef NS_ENUM(NSUInteger, YYKVStorageType) {
 @property (nonatomic, readonly) YYKVStorageType type;  ///< The type of this storage.
 //是否要打开错误日志
 @property (nonatomic) BOOL errorLogsEnabled;           ///< Set `YES` to enable error logs for debug.
+//记录SQL和文件操作的耗时
+@property (nullable, nonatomic, strong) YYCacheLatencyRecorder *latencyRecorder; ///< Records the latencies of SQL steps, checkpoints and file calls. Default is nil.
+//上一次删除操作删除的缓存数量
+@property (nonatomic, readonly) int removedItemsCount; ///< The number of items removed by the last `remove...` method (the changed rows reported by sqlite), 0 if it failed before removing.
 
 //初始化方法
 #pragma mark - Initializer
@@ -10,8 +10,10 @@
 //
 
 #import "YYKVStorage.h"
+#import "YYCacheLatency.h"
 #import <UIKit/UIKit.h>
 #import <time.h>
+#import <mach/mach_time.h>
 
 #if __has_include(<sqlite3.h>)
 #import <sqlite3.h>
@@ -87,6 +89,8 @@ static UIApplication *_YYSharedApplication() {
     CFMutableDictionaryRef _dbStmtCache;
     NSTimeInterval _dbLastOpenErrorTime;
     NSUInteger _dbOpenErrorCount;
+    
+    int _removedItemsCount;
 }
 
 
@@ -170,8 +174,20 @@ static UIApplication *_YYSharedApplication() {
 
 - (void)_dbCheckpoint {
     if (![self _dbCheck]) return;
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     // Cause a checkpoint to occur, merge `sqlite-wal` file to `sqlite` file.
     sqlite3_wal_checkpoint(_db, NULL);
+    [_latencyRecorder recordOperation:YYCacheOperationStorageCheckpoint beginTime:begin];
+}
+
+/// Step the statement, the latency is recorded as read or write by the statement.
+- (int)_dbStep:(sqlite3_stmt *)stmt {
+    if (!_latencyRecorder) return sqlite3_step(stmt);
+    uint64_t begin = mach_absolute_time();
+    int result = sqlite3_step(stmt);
+    YYCacheOperation operation = sqlite3_stmt_readonly(stmt) ? YYCacheOperationStorageSQLRead : YYCacheOperationStorageSQLWrite;
+    [_latencyRecorder recordOperation:operation beginTime:begin];
+    return result;
 }
 
 - (BOOL)_dbExecute:(NSString *)sql {
@@ -254,7 +270,7 @@ static UIApplication *_YYSharedApplication() {
     sqlite3_bind_int(stmt, 6, timestamp);
     sqlite3_bind_blob(stmt, 7, extendedData.bytes, (int)extendedData.length, 0);
     
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_DONE) {
         //** 未完成执行数据库 **
         
@@ -271,7 +287,7 @@ static UIApplication *_YYSharedApplication() {
     if (!stmt) return NO;
     sqlite3_bind_int(stmt, 1, (int)time(NULL));
     sqlite3_bind_text(stmt, 2, key.UTF8String, -1, NULL);
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_DONE) {
         if (_errorLogsEnabled) NSLog(@"%s line:%d sqlite update error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return NO;
@@ -292,7 +308,7 @@ static UIApplication *_YYSharedApplication() {
     }
     
     [self _dbBindJoinedKeys:keys stmt:stmt fromIndex:1];
-    result = sqlite3_step(stmt);
+    result = [self _dbStep:stmt];
     sqlite3_finalize(stmt);
     if (result != SQLITE_DONE) {
         if (_errorLogsEnabled) NSLog(@"%s line:%d sqlite update error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
@@ -310,7 +326,7 @@ static UIApplication *_YYSharedApplication() {
     // 绑定参数
     sqlite3_bind_text(stmt, 1, key.UTF8String, -1, NULL);
 //    执行操作
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_DONE) {
         //** 未完成执行数据库 **
         
@@ -318,6 +334,8 @@ static UIApplication *_YYSharedApplication() {
         if (_errorLogsEnabled) NSLog(@"%s line:%d db delete error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return NO;
     }
+    // 累计删除的记录数
+    _removedItemsCount += sqlite3_changes(_db);
     return YES;
 }
 
@@ -332,12 +350,13 @@ static UIApplication *_YYSharedApplication() {
     }
     
     [self _dbBindJoinedKeys:keys stmt:stmt fromIndex:1];
-    result = sqlite3_step(stmt);
+    result = [self _dbStep:stmt];
     sqlite3_finalize(stmt);
     if (result == SQLITE_ERROR) {
         if (_errorLogsEnabled) NSLog(@"%s line:%d sqlite delete error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return NO;
     }
+    _removedItemsCount += sqlite3_changes(_db);
     return YES;
 }
 
@@ -346,11 +365,12 @@ static UIApplication *_YYSharedApplication() {
     sqlite3_stmt *stmt = [self _dbPrepareStmt:sql];
     if (!stmt) return NO;
     sqlite3_bind_int(stmt, 1, size);
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_DONE) {
         if (_errorLogsEnabled) NSLog(@"%s line:%d sqlite delete error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return NO;
     }
+    _removedItemsCount += sqlite3_changes(_db);
     return YES;
 }
 
@@ -359,11 +379,12 @@ static UIApplication *_YYSharedApplication() {
     sqlite3_stmt *stmt = [self _dbPrepareStmt:sql];
     if (!stmt) return NO;
     sqlite3_bind_int(stmt, 1, time);
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_DONE) {
         if (_errorLogsEnabled)  NSLog(@"%s line:%d sqlite delete error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return NO;
     }
+    _removedItemsCount += sqlite3_changes(_db);
     return YES;
 }
 // 转换模型YYKVStorageItem
@@ -403,7 +424,7 @@ static UIApplication *_YYSharedApplication() {
     
     YYKVStorageItem *item = nil;
 //    执行操作
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result == SQLITE_ROW) {
         //** 存在可读的row **
         
@@ -439,7 +460,7 @@ static UIApplication *_YYSharedApplication() {
     [self _dbBindJoinedKeys:keys stmt:stmt fromIndex:1];
     NSMutableArray *items = [NSMutableArray new];
     do {
-        result = sqlite3_step(stmt);
+        result = [self _dbStep:stmt];
         if (result == SQLITE_ROW) {
             YYKVStorageItem *item = [self _dbGetItemFromStmt:stmt excludeInlineData:excludeInlineData];
             if (item) [items addObject:item];
@@ -461,7 +482,7 @@ static UIApplication *_YYSharedApplication() {
     if (!stmt) return nil;
     sqlite3_bind_text(stmt, 1, key.UTF8String, -1, NULL);
     
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result == SQLITE_ROW) {
         const void *inline_data = sqlite3_column_blob(stmt, 0);
         int inline_data_bytes = sqlite3_column_bytes(stmt, 0);
@@ -483,7 +504,7 @@ static UIApplication *_YYSharedApplication() {
     // 绑定参数
     sqlite3_bind_text(stmt, 1, key.UTF8String, -1, NULL);
     // 执行操作
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result == SQLITE_ROW) {
         //** 存在可读的row **
         
@@ -517,7 +538,7 @@ static UIApplication *_YYSharedApplication() {
     [self _dbBindJoinedKeys:keys stmt:stmt fromIndex:1];
     NSMutableArray *filenames = [NSMutableArray new];
     do {
-        result = sqlite3_step(stmt);
+        result = [self _dbStep:stmt];
         if (result == SQLITE_ROW) {
             char *filename = (char *)sqlite3_column_text(stmt, 0);
             if (filename && *filename != 0) {
@@ -544,7 +565,7 @@ static UIApplication *_YYSharedApplication() {
     
     NSMutableArray *filenames = [NSMutableArray new];
     do {
-        int result = sqlite3_step(stmt);
+        int result = [self _dbStep:stmt];
         if (result == SQLITE_ROW) {
             char *filename = (char *)sqlite3_column_text(stmt, 0);
             if (filename && *filename != 0) {
@@ -570,7 +591,7 @@ static UIApplication *_YYSharedApplication() {
     
     NSMutableArray *filenames = [NSMutableArray new];
     do {
-        int result = sqlite3_step(stmt);
+        int result = [self _dbStep:stmt];
         if (result == SQLITE_ROW) {
             char *filename = (char *)sqlite3_column_text(stmt, 0);
             if (filename && *filename != 0) {
@@ -596,7 +617,7 @@ static UIApplication *_YYSharedApplication() {
     
     NSMutableArray *items = [NSMutableArray new];
     do {
-        int result = sqlite3_step(stmt);
+        int result = [self _dbStep:stmt];
         if (result == SQLITE_ROW) {
             char *key = (char *)sqlite3_column_text(stmt, 0);
             char *filename = (char *)sqlite3_column_text(stmt, 1);
@@ -622,7 +643,7 @@ static UIApplication *_YYSharedApplication() {
     sqlite3_stmt *stmt = [self _dbPrepareStmt:sql];
     if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, key.UTF8String, -1, NULL);
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_ROW) {
         if (_errorLogsEnabled) NSLog(@"%s line:%d sqlite query error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return -1;
@@ -634,7 +655,7 @@ static UIApplication *_YYSharedApplication() {
     NSString *sql = @"select sum(size) from manifest;";
     sqlite3_stmt *stmt = [self _dbPrepareStmt:sql];
     if (!stmt) return -1;
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_ROW) {
         if (_errorLogsEnabled) NSLog(@"%s line:%d sqlite query error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return -1;
@@ -646,7 +667,7 @@ static UIApplication *_YYSharedApplication() {
     NSString *sql = @"select count(*) from manifest;";
     sqlite3_stmt *stmt = [self _dbPrepareStmt:sql];
     if (!stmt) return -1;
-    int result = sqlite3_step(stmt);
+    int result = [self _dbStep:stmt];
     if (result != SQLITE_ROW) {
         if (_errorLogsEnabled) NSLog(@"%s line:%d sqlite query error (%d): %s", __FUNCTION__, __LINE__, result, sqlite3_errmsg(_db));
         return -1;
@@ -660,18 +681,26 @@ static UIApplication *_YYSharedApplication() {
 - (BOOL)_fileWriteWithName:(NSString *)filename data:(NSData *)data {
     // 拼接文件路径
     NSString *path = [_dataPath stringByAppendingPathComponent:filename];
-    return [data writeToFile:path atomically:NO];
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
+    BOOL result = [data writeToFile:path atomically:NO];
+    [_latencyRecorder recordOperation:YYCacheOperationStorageFileWrite beginTime:begin];
+    return result;
 }
 
 - (NSData *)_fileReadWithName:(NSString *)filename {
     NSString *path = [_dataPath stringByAppendingPathComponent:filename];
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     NSData *data = [NSData dataWithContentsOfFile:path];
+    [_latencyRecorder recordOperation:YYCacheOperationStorageFileRead beginTime:begin];
     return data;
 }
 // 删除文件
 - (BOOL)_fileDeleteWithName:(NSString *)filename {
     NSString *path = [_dataPath stringByAppendingPathComponent:filename];
-    return [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
+    BOOL result = [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    [_latencyRecorder recordOperation:YYCacheOperationStorageFileDelete beginTime:begin];
+    return result;
 }
 
 - (BOOL)_fileMoveAllToTrash {
@@ -829,8 +858,13 @@ static UIApplication *_YYSharedApplication() {
         return [self _dbSaveWithKey:key value:value fileName:nil extendedData:extendedData];
     }
 }
+- (int)removedItemsCount {
+    return _removedItemsCount;
+}
+
 //删除缓存
 - (BOOL)removeItemForKey:(NSString *)key {
+    _removedItemsCount = 0;
     if (key.length == 0) return NO;
     // 判断缓存方式
     switch (_type) {
@@ -858,6 +892,7 @@ static UIApplication *_YYSharedApplication() {
 }
 
 - (BOOL)removeItemForKeys:(NSArray *)keys {
+    _removedItemsCount = 0;
     if (keys.count == 0) return NO;
     switch (_type) {
         case YYKVStorageTypeSQLite: {
@@ -876,6 +911,7 @@ static UIApplication *_YYSharedApplication() {
 }
 
 - (BOOL)removeItemsLargerThanSize:(int)size {
+    _removedItemsCount = 0;
     if (size == INT_MAX) return YES;
     if (size <= 0) return [self removeAllItems];
     
@@ -902,6 +938,7 @@ static UIApplication *_YYSharedApplication() {
 }
 
 - (BOOL)removeItemsEarlierThanTime:(int)time {
+    _removedItemsCount = 0;
     if (time <= 0) return YES;
     if (time == INT_MAX) return [self removeAllItems];
     
@@ -928,6 +965,7 @@ static UIApplication *_YYSharedApplication() {
 }
 
 - (BOOL)removeItemsToFitSize:(int)maxSize {
+    _removedItemsCount = 0;
     if (maxSize == INT_MAX) return YES;
     if (maxSize <= 0) return [self removeAllItems];
     
@@ -958,6 +996,7 @@ static UIApplication *_YYSharedApplication() {
 }
 
 - (BOOL)removeItemsToFitCount:(int)maxCount {
+    _removedItemsCount = 0;
     if (maxCount == INT_MAX) return YES;
     if (maxCount <= 0) return [self removeAllItems];
     
@@ -988,8 +1027,12 @@ static UIApplication *_YYSharedApplication() {
 }
 
 - (BOOL)removeAllItems {
+    _removedItemsCount = 0;
+    // 整个数据库被移到回收站，没有逐条删除，先查询记录数
+    int count = [self _dbGetTotalItemCount];
     if (![self _dbClose]) return NO;
     [self _reset];
+    _removedItemsCount = MAX(count, 0);
     if (![self _dbOpen]) return NO;
     if (![self _dbInitialize]) return NO;
     return YES;
@@ -997,7 +1040,7 @@ static UIApplication *_YYSharedApplication() {
 
 - (void)removeAllItemsWithProgressBlock:(void(^)(int removedCount, int totalCount))progress
                                endBlock:(void(^)(BOOL error))end {
-    
+    _removedItemsCount = 0;
     int total = [self _dbGetTotalItemCount];
     if (total <= 0) {
         if (end) end(total < 0);
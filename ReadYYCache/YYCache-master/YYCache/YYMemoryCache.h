@@ -11,8 +11,89 @@
 
 #import <Foundation/Foundation.h>
 
+@class YYCacheLatencyRecorder;
+@class YYCacheMissRatioEstimator;
+@class YYCacheHotKeyTracker;
+
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ The eviction policy of YYMemoryCache.
+ */
+typedef NS_ENUM(NSUInteger, YYMemoryCacheEvictionPolicy) {
+    
+    /// Least-recently-used (default). Each cache hit moves the object to the head
+    /// of the LRU list, so a read needs the same exclusive lock as a write.
+    YYMemoryCacheEvictionPolicyLRU = 0,
+    
+    /// CLOCK (second chance). A cache hit only sets the reference bit of the 
+    /// object, a clock hand sweeps the objects when evicting: referenced objects 
+    /// lose the bit and get a second chance, the first unreferenced one is evicted.
+    /// Readers share a read-write lock, only writes and evictions are exclusive.
+    /// The access time of an object is updated at most once per pass of the hand,
+    /// and `ageLimit` is checked from the hand, so it's less precise than LRU.
+    YYMemoryCacheEvictionPolicyCLOCK,
+    
+    /// LRU with buffered reordering. A cache hit is recorded into a striped lossy
+    /// ring buffer with a shared (read) lock, and the buffer is replayed in batch 
+    /// by the next writer, or by a reader that gets the write lock with `trylock`.
+    /// The order is exact LRU except for the hits dropped when a buffer is full.
+    YYMemoryCacheEvictionPolicyBufferedLRU,
+    
+    /// W-TinyLFU. New objects enter a small LRU admission window (1% of the 
+    /// objects), then a segmented LRU main region (probation and protected).
+    /// When evicting, the object leaving the window and the oldest probation
+    /// object are compared with a 4-bit count-min sketch (aged periodically),
+    /// and the less frequent one is removed, so one-off scans can't flush the 
+    /// frequently used objects. `countLimit` and `costLimit` are respected as 
+    /// other policies, the segments are sized by object count.
+    YYMemoryCacheEvictionPolicyTinyLFU,
+    
+    /// ARC (Adaptive Replacement Cache). Objects seen once and objects seen at 
+    /// least twice are kept in two LRU lists, and the keys recently evicted from
+    /// each list are remembered (without objects) to adapt the size of the lists.
+    YYMemoryCacheEvictionPolicyARC,
+    
+    /// 2Q. New objects enter a FIFO queue (25% of the objects), the keys evicted
+    /// from it are remembered, and come back into a LRU list if set again. Hits
+    /// in the FIFO queue don't promote objects.
+    YYMemoryCacheEvictionPolicy2Q,
+    
+    /// S3-FIFO. New objects enter a small FIFO queue (10% of the objects), the
+    /// ones accessed before leaving it move to a main FIFO queue, others are 
+    /// evicted and remembered. A hit only increases the object's frequency, the
+    /// main queue reinserts accessed objects instead of evicting them.
+    YYMemoryCacheEvictionPolicyS3FIFO,
+};
+
+/**
+ The memory pressure level, see `trimForPressureLevel:`.
+ */
+typedef NS_ENUM(NSUInteger, YYMemoryCachePressureLevel) {
+    /// The system is low on memory (memory pressure warning, or app enters background).
+    /// The cache is trimmed to `warningPressureRatio`.
+    YYMemoryCachePressureLevelWarning = 1,
+    
+    /// The system is critically low on memory (memory warning of the app).
+    /// The cache is trimmed to `criticalPressureRatio`.
+    YYMemoryCachePressureLevelCritical = 2,
+};
+
+/**
+ The statistics of a memory cache, all counters are accumulated since the cache 
+ is created.
+ */
+typedef struct {
+    uint64_t hits;           ///< reads which returned an object
+    uint64_t misses;         ///< reads which returned nil (including expired objects)
+    uint64_t inserts;        ///< writes of a new key
+    uint64_t updates;        ///< writes of an existing key
+    uint64_t costEvictions;  ///< objects evicted by `costLimit` (or memory pressure)
+    uint64_t countEvictions; ///< objects evicted by `countLimit` (or memory pressure)
+    uint64_t ageEvictions;   ///< objects removed by `ageLimit` or ttl
+    uint64_t removals;       ///< objects removed explicitly (removeObject..., removeAllObjects)
+} YYMemoryCacheStatistics;
+
 /**
  YYMemoryCache is a fast in-memory cache that stores key-value pairs.
  In contrast to NSDictionary, keys are retained and not copied.
@@ -21,15 +102,85 @@ NS_ASSUME_NONNULL_BEGIN
  YYMemoryCache objects differ from NSCache in a few ways:
  
  * It uses LRU (least-recently-used) to remove objects; NSCache's eviction method
-   is non-deterministic.
+   is non-deterministic. CLOCK can be used instead for read-heavy workloads.
  * It can be controlled by cost, count and age; NSCache's limits are imprecise.
  * It can be configured to automatically evict objects when receive memory 
    warning or app enter background.
+ * It can be split into several shards to reduce lock contention on multi-core
+   devices.
  
  The time of `Access Methods` in YYMemoryCache is typically in constant time (O(1)).
  */
 @interface YYMemoryCache : NSObject
 
+#pragma mark - Initializer
+///=============================================================================
+/// @name Initializer
+///=============================================================================
+
+/**
+ Create a new cache with a single shard, all keys are guarded by one lock.
+ */
+- (instancetype)init;
+
+/**
+ Create a new cache whose objects are spread over several shards.
+ 
+ @discussion Each key is assigned to a shard by its hash. Every shard has its own
+ lock and LRU list, so the threads which access different keys rarely block each
+ other. The `costLimit`, `countLimit` and `ageLimit` are still applied to the whole
+ cache: when the cache goes over a limit, objects are evicted from the LRU end of
+ the shard which holds the most cost (or count). So the eviction order is LRU in
+ each shard, and only approximately LRU for the whole cache.
+ 
+ @param shardCount The number of shards. It will be rounded up to a power of 2 
+     (max 1024), 0 and 1 means a single shard.
+ @return A new cache object.
+ */
+- (instancetype)initWithShardCount:(NSUInteger)shardCount;
+
+/**
+ Create a new cache with the specified shard count and eviction policy.
+ 
+ @param shardCount     The number of shards, see `initWithShardCount:`.
+ @param evictionPolicy The eviction policy, see `YYMemoryCacheEvictionPolicy`.
+ @return A new cache object.
+ */
+- (instancetype)initWithShardCount:(NSUInteger)shardCount
+                    evictionPolicy:(YYMemoryCacheEvictionPolicy)evictionPolicy;
+
+/**
+ Create a new cache with a fixed capacity, see `initWithCapacity:shardCount:evictionPolicy:`.
+ 
+ @param capacity The max number of objects.
+ @return A new cache object.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ Create a new cache with a fixed capacity, the specified shard count and eviction policy.
+ 
+ @discussion All nodes, hash table slots and the data of eviction policy are
+ allocated up front. Each shard holds at most `capacity / shardCount` (rounded up)
+ objects: when a new object is added to a full shard, the victim of the shard is
+ evicted and its node is reused by the new object. So once the objects are created,
+ `setObject:forKey:` and the eviction don't allocate memory, and the latency is
+ predictable.
+ 
+ This holds as long as the evicted objects are released asynchronously in 
+ background (the default), including the objects evicted by `costLimit`. Expired
+ objects are removed by the automatic trim instead of by writes.
+ 
+ @param capacity       The max number of objects, `countLimit` is set to it 
+     (rounded up to a multiple of the shard count). 0 means no fixed capacity.
+ @param shardCount     The number of shards, see `initWithShardCount:`.
+ @param evictionPolicy The eviction policy, see `YYMemoryCacheEvictionPolicy`.
+ @return A new cache object.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+                      shardCount:(NSUInteger)shardCount
+                  evictionPolicy:(YYMemoryCacheEvictionPolicy)evictionPolicy NS_DESIGNATED_INITIALIZER;
+
 #pragma mark - Attribute
 ///=============================================================================
 /// @name Attribute
@@ -44,6 +195,59 @@ NS_ASSUME_NONNULL_BEGIN
 /** The total cost of objects in the cache (read-only). */
 @property (readonly) NSUInteger totalCost;
 
+/** The number of shards (read-only). Default is 1. */
+@property (readonly) NSUInteger shardCount;
+
+/** The fixed capacity (read-only), see `initWithCapacity:`. Default is 0 (no fixed capacity). */
+@property (readonly) NSUInteger capacity;
+
+/** The bytes of the slab arenas which hold the values of `setData:forKey:` (read-only). */
+@property (readonly) NSUInteger totalSlabBytes;
+
+/** The eviction policy (read-only). Default is YYMemoryCacheEvictionPolicyLRU. */
+@property (readonly) YYMemoryCacheEvictionPolicy evictionPolicy;
+
+/**
+ The statistics of the cache (read-only).
+ 
+ @discussion The counters are striped by thread and summed when this property is
+ read, so counting has no measurable cost on the access methods. The values 
+ are not a consistent snapshot while the cache is being accessed.
+ */
+@property (readonly) YYMemoryCacheStatistics statistics;
+
+/**
+ The recorder of the latencies of `objectForKey:`, `setObject:forKey:` and trims.
+ Default is nil (not recorded).
+ 
+ @discussion The recorder should be set before the cache is accessed by other
+ threads, and should not be replaced later (reset its snapshots instead).
+ */
+@property (nullable, strong) YYCacheLatencyRecorder *latencyRecorder;
+
+/**
+ The estimator of the hit ratio at other `countLimit` or `costLimit`, it records
+ the reads (`objectForKey:`) and writes (`setObject:forKey:`) of the cache.
+ Default is nil (not recorded).
+ 
+ @discussion The estimator should be set before the cache is accessed by other
+ threads, and should not be shared with other caches. A read is recorded without
+ its cost, the cost of the last write of the key is used.
+ */
+@property (nullable, strong) YYCacheMissRatioEstimator *missRatioEstimator;
+
+/**
+ The tracker of the most frequently accessed keys, it records the keys of reads,
+ writes and removals. Default is nil (not recorded).
+ 
+ @discussion A key accessed by many threads makes its shard's lock a hot spot,
+ the tracker reports such keys, so they can be moved out of the cache (e.g. into
+ a front cache of each thread) or spread over the shards. An integer key is 
+ recorded as NSNumber. The tracker should be set before the cache is accessed 
+ by other threads.
+ */
+@property (nullable, strong) YYCacheHotKeyTracker *hotKeyTracker;
+
 
 #pragma mark - Limit
 ///=============================================================================
@@ -54,8 +258,9 @@ NS_ASSUME_NONNULL_BEGIN
  The maximum number of objects the cache should hold.
  
  @discussion The default value is NSUIntegerMax, which means no limit.
- This is not a strict limit—if the cache goes over the limit, some objects in the
- cache could be evicted later in backgound thread.
+ This is not a strict limit—if the cache goes over the limit, the writer evicts
+ a few objects (at most 8 per write) before it returns, the rest is evicted 
+ by later writes or by the automatic trim.
  */
 @property NSUInteger countLimit;
 
@@ -63,8 +268,9 @@ NS_ASSUME_NONNULL_BEGIN
  The maximum total cost that the cache can hold before it starts evicting objects.
  
  @discussion The default value is NSUIntegerMax, which means no limit.
- This is not a strict limit—if the cache goes over the limit, some objects in the
- cache could be evicted later in backgound thread.
+ This is not a strict limit—if the cache goes over the limit, the writer evicts
+ a few objects (at most 8 per write) before it returns, the rest is evicted 
+ by later writes or by the automatic trim.
  */
 
 //YYCache暴露出来的costLimit我理解为是缓存文件的总内存限制，但是除非用户自己手动调用YYMemory 的- (void)setObject:(id)object forKey:(id)key withCost:(NSUInteger)cost;这个方法，不然直接通过最上YYCache这个类调用- (void)setObject:(id<NSCoding>)object forKey:(NSString *)key;这个属性就毫无疑义了，因为默认所有文件的cost都是0
@@ -81,6 +287,21 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property NSTimeInterval ageLimit;
 
+/**
+ The fraction of the cache kept under `YYMemoryCachePressureLevelWarning`. Default is 0.5.
+ 
+ @discussion The cache is trimmed (coldest objects first) to this fraction of 
+ `costLimit` and `countLimit`, or of `totalCost` and `totalCount` if they are
+ below the limits. 0 means remove all objects.
+ */
+@property double warningPressureRatio;
+
+/**
+ The fraction of the cache kept under `YYMemoryCachePressureLevelCritical`. Default is 0.25.
+ See `warningPressureRatio`.
+ */
+@property double criticalPressureRatio;
+
 /**
  The auto trim check time interval in seconds. Default is 5.0.
  
@@ -90,14 +311,15 @@ NS_ASSUME_NONNULL_BEGIN
 @property NSTimeInterval autoTrimInterval;
 
 /**
- If `YES`, the cache will remove all objects when the app receives a memory warning.
- The default value is `YES`.
+ If `YES`, the cache will be trimmed with `YYMemoryCachePressureLevelCritical`
+ when the app receives a memory warning, and with the level reported by the system
+ when the memory pressure changes. The default value is `YES`.
  */
 @property BOOL shouldRemoveAllObjectsOnMemoryWarning;
 
 /**
- If `YES`, The cache will remove all objects when the app enter background.
- The default value is `YES`.
+ If `YES`, The cache will be trimmed with `YYMemoryCachePressureLevelWarning`
+ when the app enter background. The default value is `YES`.
  */
 @property BOOL shouldRemoveAllObjectsWhenEnteringBackground;
 
@@ -129,6 +351,23 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property BOOL releaseAsynchronously;
 
+/**
+ If `YES`, the automatic trim compresses the NSData values (at least 256 bytes)
+ in the colder half of the cache with LZ4. Default is NO.
+
+ @discussion A compressed value is decompressed by the next `objectForKey:`, and
+ the data is put back to the cache, so only the values which are not accessed
+ for a while stay compressed. The cost of a compressed value is scaled by its
+ compression ratio (a cost of 0 stays 0), so with the length as cost (such as
+ `setData:forKey:`), the cache holds more compressible data (like JSON or plist)
+ within the same `costLimit`. The data which can't be compressed by at least 1/8
+ is kept as is. The compression runs in the trim queue, not in the access methods.
+
+ A hit of a compressed value costs a decompression and a new data is returned,
+ don't enable it if the values are compared by pointer.
+ */
+@property BOOL compressesColdData;
+
 
 #pragma mark - Access Methods
 ///=============================================================================
@@ -151,6 +390,19 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (nullable id)objectForKey:(id)key;
 
+/**
+ Returns the value associated with a given key, and whether the value should be
+ refreshed.
+ 
+ @param key          An object identifying the value. If nil, just return nil.
+ @param needsRefresh Set to YES if the refresh time of the value (see
+     `setObject:forKey:withCost:ttl:refreshAfter:`) has passed. Only one caller
+     gets YES for each refresh time, it should reload and set the value again.
+ @return The value associated with key, or nil if no value is associated with key.
+     A value which needs refresh is still returned.
+ */
+- (nullable id)objectForKey:(id)key needsRefresh:(nullable BOOL *)needsRefresh;
+
 /**
  Sets the value of the specified key in the cache (0 cost).
  
@@ -172,12 +424,42 @@ NS_ASSUME_NONNULL_BEGIN
  
  @param object The object to store in the cache. If nil, it calls `removeObjectForKey`.
  @param key    The key with which to associate the value. If nil, this method has no effect.
- @param cost   The cost with which to associate the key-value pair.
+ @param cost   The cost with which to associate the key-value pair. A cost larger
+               than UINT32_MAX is counted as UINT32_MAX.
  @discussion Unlike an NSMutableDictionary object, a cache does not copy the key
  objects that are put into it.
  */
 - (void)setObject:(nullable id)object forKey:(id)key withCost:(NSUInteger)cost;
 
+/**
+ Sets the value of the specified key in the cache, and associates the key-value
+ pair with the specified cost and time-to-live.
+ 
+ @param object The object to store in the cache. If nil, it calls `removeObjectForKey`.
+ @param key    The key with which to associate the value. If nil, this method has no effect.
+ @param cost   The cost with which to associate the key-value pair.
+ @param ttl    The time-to-live in seconds. If 0 or negative, the object never 
+               expires (`ageLimit` still applies).
+ @discussion An expired object is never returned. It's removed by a timing wheel
+ when the cache is written or automatically trimmed, the cost is O(1) per object.
+ */
+- (void)setObject:(nullable id)object forKey:(id)key withCost:(NSUInteger)cost ttl:(NSTimeInterval)ttl;
+
+/**
+ Sets the value of the specified key in the cache, and associates the key-value
+ pair with the specified cost, time-to-live and refresh time.
+ 
+ @param object       The object to store in the cache. If nil, it calls `removeObjectForKey`.
+ @param key          The key with which to associate the value. If nil, this method has no effect.
+ @param cost         The cost with which to associate the key-value pair.
+ @param ttl          The time-to-live in seconds. If 0 or negative, the object never expires.
+ @param refreshAfter The soft expiry in seconds. If 0 or negative, the object never needs refresh.
+ @discussion After `refreshAfter` seconds the object is still returned, but one 
+ reader of `objectForKey:needsRefresh:` is told to refresh it. It should be less
+ than `ttl` and `ageLimit`, so a popular object is reloaded before it expires.
+ */
+- (void)setObject:(nullable id)object forKey:(id)key withCost:(NSUInteger)cost ttl:(NSTimeInterval)ttl refreshAfter:(NSTimeInterval)refreshAfter;
+
 /**
  Removes the value of the specified key in the cache.
  
@@ -185,11 +467,142 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)removeObjectForKey:(id)key;
 
+/**
+ Returns the values associated with the given keys.
+ 
+ @param keys The keys identifying the values.
+ @return A dictionary of the keys which are in cache and their values, the keys
+ are retained and not copied.
+ @discussion The keys are grouped by shard, each shard is locked only once for 
+ the whole batch. A hit updates the eviction order as `objectForKey:` does.
+ */
+- (NSDictionary *)objectsForKeys:(NSArray *)keys;
+
+/**
+ Sets the values of the specified keys in the cache.
+ 
+ @param objects The objects to store in the cache.
+ @param keys    The keys with which to associate the values.
+ @param costs   The costs of the key-value pairs, nil means 0 cost.
+ @discussion If the counts of the arrays are not equal, this method has no effect.
+ Each shard is locked only once for the whole batch, and the objects are evicted 
+ once after all values are stored (at most 8 objects per stored value).
+ */
+- (void)setObjects:(NSArray *)objects forKeys:(NSArray *)keys costs:(nullable NSArray<NSNumber *> *)costs;
+
+/**
+ Removes the values of the specified keys in the cache. Each shard is locked 
+ only once for the whole batch.
+ 
+ @param keys The keys identifying the values to be removed.
+ */
+- (void)removeObjectsForKeys:(NSArray *)keys;
+
 /**
  Empties the cache immediately.
  */
 - (void)removeAllObjects;
 
+/**
+ Enumerates the keys and objects in the cache, without blocking other threads
+ for long.
+ 
+ @discussion The shards are enumerated one by one, the objects of a shard are
+ visited in MRU order of its list (a segmented policy such as ARC has several
+ lists, they are enumerated in turn). The shard's lock is held only while at 
+ most 64 objects are copied, and the block is invoked without lock, so a large
+ cache can be enumerated in background, and the block may access the cache.
+ 
+ The enumeration is weakly consistent: an object which stays in the cache and
+ is not accessed during the enumeration is visited exactly once; an object which
+ is added, removed or accessed during the enumeration may be visited or not 
+ (or twice, if a segmented policy moves it to a list which is not enumerated yet).
+ Expired objects are skipped. An integer key is passed as NSNumber.
+ 
+ @param block The block to invoke with each key and object, set `*stop` to YES 
+     to stop the enumeration.
+ */
+- (void)enumerateKeysAndObjectsUsingBlock:(void (^)(id key, id obj, BOOL *stop))block;
+
+
+#pragma mark - Integer Keys
+///=============================================================================
+/// @name Integer Keys
+///=============================================================================
+
+/*
+ These methods use a 64-bit integer as the key, without boxing it in NSNumber.
+ The key is not retained or stored: it's mixed into a hash with a bijective
+ integer mixer, so the hash identifies the key, and a lookup never calls 
+ `-hash` or `-isEqual:`. Integer keys and object keys are different keys, 
+ e.g. `@1` and `1`. Otherwise they share the same limits, eviction policy, 
+ statistics and trimming.
+ */
+
+/**
+ Returns a Boolean value that indicates whether a given integer key is in cache.
+ */
+- (BOOL)containsObjectForIntegerKey:(uint64_t)key;
+
+/**
+ Returns the value associated with a given integer key.
+ 
+ @param key An integer identifying the value.
+ @return The value associated with key, or nil if no value is associated with key.
+ */
+- (nullable id)objectForIntegerKey:(uint64_t)key;
+
+/**
+ Sets the value of the specified integer key in the cache (0 cost).
+ 
+ @param object The object to store in the cache. If nil, it calls `removeObjectForIntegerKey:`.
+ @param key    The integer with which to associate the value.
+ */
+- (void)setObject:(nullable id)object forIntegerKey:(uint64_t)key;
+
+/**
+ Sets the value of the specified integer key in the cache, and associates the
+ key-value pair with the specified cost.
+ 
+ @param object The object to store in the cache. If nil, it calls `removeObjectForIntegerKey:`.
+ @param key    The integer with which to associate the value.
+ @param cost   The cost with which to associate the key-value pair.
+ */
+- (void)setObject:(nullable id)object forIntegerKey:(uint64_t)key withCost:(NSUInteger)cost;
+
+/**
+ Removes the value of the specified integer key in the cache.
+ */
+- (void)removeObjectForIntegerKey:(uint64_t)key;
+
+
+#pragma mark - Data Values
+///=============================================================================
+/// @name Data Values
+///=============================================================================
+
+/**
+ Copies the bytes of data into the slab store, and sets the copy as the value of
+ the specified key. The cost of the value is the size of its chunk.
+ 
+ @discussion The slab store keeps the bytes in chunks of size classes (64 bytes,
+ then growing by 1.25x up to 512KB) carved from 1MB arenas, like memcached. The
+ cost includes the unused tail of the chunk, and the freed chunks are reused by
+ the next values of the same class, so with a `costLimit`, the memory of the bytes
+ (see `totalSlabBytes`) stays close to the limit, and the malloc heap is not 
+ fragmented by the payloads of different sizes. An arena is returned to system
+ only when all of its chunks are free, so after a large trim the memory may stay
+ above the limit until the arenas are reused or emptied.
+ 
+ The value returned by `objectForKey:` is an immutable NSData which refers to the
+ chunk, the chunk is freed when the value is released (it may outlive the cache).
+ Data larger than 512KB is copied with `-copy`, and its cost is its length.
+ 
+ @param data The data to be stored in the cache. If nil, it calls `removeObjectForKey:`.
+ @param key  The key with which to associate the value. If nil, this method has no effect.
+ */
+- (void)setData:(nullable NSData *)data forKey:(id)key;
+
 
 #pragma mark - Trim
 ///=============================================================================
@@ -217,6 +630,15 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)trimToAge:(NSTimeInterval)age;
 
+/**
+ Removes the coldest objects from the cache, until the `totalCost` and `totalCount`
+ are below the fraction of the pressure level (see `warningPressureRatio`).
+ Unlike `removeAllObjects`, the hot objects are kept, so there's no miss storm 
+ after the pressure.
+ @param level The memory pressure level.
+ */
+- (void)trimForPressureLevel:(YYMemoryCachePressureLevel)level;
+
 @end
 
 NS_ASSUME_NONNULL_END
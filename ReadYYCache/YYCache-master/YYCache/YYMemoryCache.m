@@ -10,51 +10,635 @@
 //
 
 #import "YYMemoryCache.h"
+#import "YYMemoryCacheInternal.h"
+#import "YYCacheLatency.h"
+#import "YYCacheMissRatio.h"
+#import "YYCacheHotKeys.h"
 #import <UIKit/UIKit.h>
 #import <CoreFoundation/CoreFoundation.h>
 #import <QuartzCore/QuartzCore.h>
 #import <pthread.h>
+#import <stdatomic.h>
+#import <mach/mach_time.h>
 
 
 static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
     return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
 }
 
+NSTimeInterval (*_YYMemoryCacheClock)(void) = NULL;
+
+/// Returns the current time of the caches, see `_YYMemoryCacheClock`.
+static inline NSTimeInterval _YYMemoryCacheNow(void) {
+    return _YYMemoryCacheClock ? _YYMemoryCacheClock() : CACurrentMediaTime();
+}
+
+/// Mix the bits of an object's hash (murmur3 finalizer). The result is used to
+/// select a shard (high bits), a group (middle bits) and a control byte (low
+/// 7 bits) in the hash table, so all bits need to be well distributed.
+static inline uint64_t _YYMemoryCacheHashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/// Returns the mixed hash of a key.
+static inline uint64_t _YYMemoryCacheHash(id key) {
+    return _YYMemoryCacheHashMix(CFHash((__bridge CFTypeRef)(key)));
+}
+
+/// Returns the mixed hash of an integer key. The mixer is a bijection, so two
+/// integer keys never have the same hash, and the node doesn't store the key.
+static inline uint64_t _YYMemoryCacheIntegerHash(uint64_t key) {
+    return _YYMemoryCacheHashMix(key);
+}
+
+/// Returns the integer key of a hash, the inverse of `_YYMemoryCacheIntegerHash()`.
+static inline uint64_t _YYMemoryCacheIntegerKey(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0x9cb4b2f8129337dbULL; // inverse of 0xc4ceb9fe1a85ec53
+    h ^= h >> 33;
+    h *= 0x4f74430c22a54005ULL; // inverse of 0xff51afd7ed558ccd
+    h ^= h >> 33;
+    return h;
+}
+
 /**
- A node in linked map.
- Typically, you should not use this class directly.
+ The total cost and count of a memory cache.
+ It's shared by all shards of the cache, so the limits can be checked without
+ holding the lock of other shards.
  */
+typedef struct {
+    _Atomic(NSUInteger) cost;
+    _Atomic(NSUInteger) count;
+} _YYLinkedMapTotals;
 
-//链表节点
-@interface _YYLinkedMapNode : NSObject {
-    @package
-    
-//    因为每个node都会被CFDictionary进行retain操作，所以这里使用的是__unsafe_unretained
-    
-//指向前一个节点
-    __unsafe_unretained _YYLinkedMapNode *_prev; // retained by dic
-//指向后一个节点
-    __unsafe_unretained _YYLinkedMapNode *_next; // retained by dic
-//缓存key
-    id _key;
-//缓存对象
-    id _value;
-//当前缓存开销
-    NSUInteger _cost;
-//缓存时间
-    NSTimeInterval _time;
+/// Index of a node in the slabs of _YYLinkedMap.
+typedef uint32_t _YYLinkedMapIndex;
+
+/// Invalid node index, used like `nil`.
+#define _YYLinkedMapNil UINT32_MAX
+
+/// Each slab holds (1 << _YYLinkedMapSlabShift) nodes.
+#define _YYLinkedMapSlabShift 8
+#define _YYLinkedMapSlabSize (1 << _YYLinkedMapSlabShift)
+#define _YYLinkedMapSlabMask (_YYLinkedMapSlabSize - 1)
+
+/// The max cost of a node, a larger cost is clamped.
+#define _YYLinkedMapMaxCost UINT32_MAX
+
+/// Resolution of the coarse time in _YYLinkedMapLink (1/16 second).
+#define _YYLinkedMapTimeScale 16
+
+/**
+ A node in linked map is split into two plain C structs with the same index:
+ the link (list pointers, access time and policy bits) and the entry (key,
+ value and everything else). They are carved from two parallel slabs, so the
+ eviction policies walk the lists over the small links only, and never touch
+ the entries until a victim is chosen.
+ Nodes are linked by index instead of pointer. Unused nodes are kept in a free
+ list and reused by later insertions.
+ Typically, you should not use these structs directly.
+ */
+
+//链表节点的热数据 (16字节)，淘汰时只遍历这部分
+typedef struct {
+//指向前一个节点 (索引)
+    _YYLinkedMapIndex _prev;
+//指向后一个节点 (索引)，节点空闲时指向下一个空闲节点
+    _YYLinkedMapIndex _next;
+//缓存时间 (粗粒度，见_YYLinkedMapTimeFromInterval)
+    uint32_t _time;
+//CLOCK的引用位，命中时由读线程原子地设置 (S3-FIFO用作访问频率，最大为3)
+    uint8_t _referenced;
+//节点所在的链表 (见_YYLinkedMapList)
+    uint8_t _segment;
+} _YYLinkedMapLink;
+
+//链表节点的冷数据 (64字节)
+typedef struct {
+//节点在哈希表中的位置
+    uint32_t _slot;
+//节点每次被移除时+1，用来识别读缓冲区中过期的记录
+    uint32_t _generation;
+//时间轮中的前后节点 (索引)
+    _YYLinkedMapIndex _timerPrev;
+    _YYLinkedMapIndex _timerNext;
+//缓存key (retained)，整数key为NULL (key保存在_hash中，见_YYMemoryCacheIntegerHash)
+    CFTypeRef _key;
+//缓存对象 (retained)，空闲节点为NULL
+    CFTypeRef _value;
+//key的hash，查找和扩容时不需要再调用 -hash
+    uint64_t _hash;
+//过期时间，0表示不过期
+    NSTimeInterval _expire;
+//软过期时间，到期后读取仍返回旧值，并由一个读线程触发刷新，0表示不刷新
+    NSTimeInterval _refresh;
+//当前缓存开销 (最大为_YYLinkedMapMaxCost)
+    uint32_t _cost;
+//节点在时间轮中的桶
+    uint16_t _timerBucket;
+//缓存值压缩后不够小，不再尝试压缩 (值被替换时清除，见compressesColdData)
+    uint8_t _incompressible;
     
-//    通过以上6个成员变量，就能完成时间，空间，数量的淘汰算法
+//    通过以上成员变量，就能完成时间，空间，数量的淘汰算法
+} _YYLinkedMapNode;
+
+/// Converts `_YYMemoryCacheNow()` to the coarse time of a link.
+static inline uint32_t _YYLinkedMapTimeFromInterval(NSTimeInterval time) {
+    double value = time * _YYLinkedMapTimeScale;
+    if (value <= 0) return 0;
+    return value >= UINT32_MAX ? UINT32_MAX : (uint32_t)value;
 }
-@end
 
-@implementation _YYLinkedMapNode
-@end
+/// Converts the coarse time of a link to seconds.
+static inline NSTimeInterval _YYLinkedMapTimeToInterval(uint32_t time) {
+    return time / (NSTimeInterval)_YYLinkedMapTimeScale;
+}
 
+static inline uint32_t _YYLinkedMapClampCost(NSUInteger cost) {
+    return cost > _YYLinkedMapMaxCost ? _YYLinkedMapMaxCost : (uint32_t)cost;
+}
+
+#define _YYLinkedMapReadBufferStripes 4
+#define _YYLinkedMapReadBufferSize 32
+#define _YYLinkedMapReadBufferMask (_YYLinkedMapReadBufferSize - 1)
+
+/**
+ A lossy ring buffer of hits, used by BufferedLRU policy.
+ Readers append (generation << 32 | index) with CAS while holding the map's read
+ lock, a full buffer drops the hit. The buffer is drained with the write lock 
+ held, so the drainer never races with a reader.
+ */
+typedef struct {
+    _Atomic(uint32_t) writeCount;
+    uint32_t readCount; // only changed by the drainer
+    _Atomic(uint64_t) records[_YYLinkedMapReadBufferSize];
+} __attribute__((aligned(64))) _YYLinkedMapReadBuffer;
 
 /**
- A linked map used by YYMemoryCache.
- It's not thread-safe and does not validate the parameters.
+ A growable array of removed entries, used to release them together.
+ */
+typedef struct {
+    _YYLinkedMapEntry *entries;
+    NSUInteger count;
+    NSUInteger capacity;
+} _YYLinkedMapHolder;
+
+static void _YYLinkedMapHolderAdd(_YYLinkedMapHolder *holder, _YYLinkedMapEntry entry) {
+    if (!entry.value) return;
+    if (holder->count == holder->capacity) {
+        holder->capacity = holder->capacity ? holder->capacity * 2 : 16;
+        holder->entries = realloc(holder->entries, holder->capacity * sizeof(_YYLinkedMapEntry));
+    }
+    holder->entries[holder->count++] = entry;
+}
+
+static void _YYLinkedMapHolderRelease(_YYLinkedMapHolder holder) {
+    for (NSUInteger i = 0; i < holder.count; i++) {
+        if (holder.entries[i].key) CFRelease(holder.entries[i].key);
+        CFRelease(holder.entries[i].value);
+    }
+    free(holder.entries);
+}
+
+
+/*
+ Reclaimer: a background thread which releases the removed key-value pairs.
+ 
+ Removed pairs are appended to a bounded MPSC queue (Vyukov's array queue, each
+ cell has a sequence number), no memory is allocated for this. The reclaimer 
+ thread takes the pairs in batches and releases them. It sleeps on a semaphore
+ when the queue is empty, a producer only signals it if it's sleeping. When the
+ queue is full, the producer releases the pair itself.
+ */
+
+#define _YYReclaimerBatchSize 256
+
+typedef struct {
+    _Atomic(NSUInteger) sequence;
+    _YYLinkedMapEntry entry;
+} _YYReclaimerCell;
+
+static struct {
+    _YYReclaimerCell cells[_YYReclaimerQueueSize];
+    _Atomic(NSUInteger) tail __attribute__((aligned(64))); // next position to enqueue
+    NSUInteger head __attribute__((aligned(64)));          // next position to dequeue, reclaimer thread only
+    _Atomic(BOOL) sleeping;
+    dispatch_semaphore_t semaphore;
+} _YYReclaimer;
+
+/// Take a pair from queue, returns NO if the queue is empty. Reclaimer thread only.
+static BOOL _YYReclaimerDequeue(_YYLinkedMapEntry *entry) {
+    _YYReclaimerCell *cell = &_YYReclaimer.cells[_YYReclaimer.head & (_YYReclaimerQueueSize - 1)];
+    NSUInteger sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    if (sequence != _YYReclaimer.head + 1) return NO;
+    *entry = cell->entry;
+    atomic_store_explicit(&cell->sequence, _YYReclaimer.head + _YYReclaimerQueueSize, memory_order_release);
+    _YYReclaimer.head++;
+    return YES;
+}
+
+static void *_YYReclaimerMain(void *context) {
+    pthread_setname_np("com.ibireme.cache.memory.reclaimer");
+    // QoS 是 iOS 8 才有的 (弱链接)，更早的系统降低线程优先级
+    if (&pthread_set_qos_class_self_np) {
+        pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+    } else {
+        [NSThread setThreadPriority:0.3];
+    }
+    _YYLinkedMapEntry batch[_YYReclaimerBatchSize];
+    for (;;) {
+        NSUInteger count = 0;
+        while (count < _YYReclaimerBatchSize && _YYReclaimerDequeue(&batch[count])) count++;
+        if (count == 0) {
+            // 先标记为休眠再检查一次，避免错过生产者的唤醒
+            atomic_store(&_YYReclaimer.sleeping, YES);
+            atomic_thread_fence(memory_order_seq_cst);
+            if (_YYReclaimerDequeue(&batch[0])) {
+                atomic_store(&_YYReclaimer.sleeping, NO);
+                count = 1;
+            } else {
+                dispatch_semaphore_wait(_YYReclaimer.semaphore, DISPATCH_TIME_FOREVER);
+                continue;
+            }
+        }
+        @autoreleasepool {
+            for (NSUInteger i = 0; i < count; i++) {
+                if (batch[i].key) CFRelease(batch[i].key);
+                CFRelease(batch[i].value);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void _YYReclaimerInit(void) {
+    for (NSUInteger i = 0; i < _YYReclaimerQueueSize; i++) {
+        atomic_init(&_YYReclaimer.cells[i].sequence, i);
+    }
+    _YYReclaimer.semaphore = dispatch_semaphore_create(0);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    pthread_create(&thread, &attr, _YYReclaimerMain, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+void _YYReclaimerRelease(_YYLinkedMapEntry entry) {
+    if (!entry.value) return;
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, _YYReclaimerInit);
+    NSUInteger position = atomic_load_explicit(&_YYReclaimer.tail, memory_order_relaxed);
+    for (;;) {
+        _YYReclaimerCell *cell = &_YYReclaimer.cells[position & (_YYReclaimerQueueSize - 1)];
+        NSUInteger sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        NSInteger diff = (NSInteger)sequence - (NSInteger)position;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&_YYReclaimer.tail, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                cell->entry = entry;
+                atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+                break;
+            }
+        } else if (diff < 0) {
+            // 队列已满，直接在当前线程释放
+            if (entry.key) CFRelease(entry.key);
+            CFRelease(entry.value);
+            return;
+        } else {
+            position = atomic_load_explicit(&_YYReclaimer.tail, memory_order_relaxed);
+        }
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&_YYReclaimer.sleeping) && atomic_exchange(&_YYReclaimer.sleeping, NO)) {
+        dispatch_semaphore_signal(_YYReclaimer.semaphore);
+    }
+}
+
+/// Returns the node at the index in slabs.
+static inline _YYLinkedMapNode *_YYLinkedMapSlabsGetNode(_YYLinkedMapNode **slabs, _YYLinkedMapIndex index) {
+    return &slabs[index >> _YYLinkedMapSlabShift][index & _YYLinkedMapSlabMask];
+}
+
+/// Release all nodes in use (free nodes have NULL value), then free the slabs.
+static void _YYLinkedMapSlabsRelease(_YYLinkedMapNode **slabs, _YYLinkedMapLink **linkSlabs, uint32_t slabCount) {
+    for (uint32_t i = 0; i < slabCount; i++) {
+        _YYLinkedMapNode *slab = slabs[i];
+        for (NSUInteger j = 0; j < _YYLinkedMapSlabSize; j++) {
+            if (!slab[j]._value) continue;
+            if (slab[j]._key) CFRelease(slab[j]._key);
+            CFRelease(slab[j]._value);
+        }
+        free(slab);
+        free(linkSlabs[i]);
+    }
+    free(slabs);
+    free(linkSlabs);
+}
+
+
+/*
+ Hash table of _YYLinkedMap (open addressing, similar to Swiss table).
+ 
+ The slots are divided into groups of 8. Each slot has a control byte:
+ 0x80 is empty, 0xFE is deleted, and a full slot stores the low 7 bits of the
+ key's hash. A lookup loads the 8 control bytes of a group as one 64-bit word
+ and compares them in parallel, so only the slots whose control byte matches
+ need to check the node. The groups are probed in triangular sequence, and a
+ lookup stops at the first group which has an empty slot.
+ 
+ The slots store node index, the node caches the full hash, so the key's
+ -hash and -isEqual: are not called for mismatched slots or when resizing.
+ */
+#define _YYLinkedMapCtrlEmpty ((uint8_t)0x80)
+#define _YYLinkedMapCtrlDeleted ((uint8_t)0xFE)
+#define _YYLinkedMapGroupSize 8
+#define _YYLinkedMapGroupLSBs 0x0101010101010101ULL
+#define _YYLinkedMapGroupMSBs 0x8080808080808080ULL
+
+/// Returns a bit mask of the bytes in group which equal to h2 (the highest bit
+/// of each matched byte is set). It may have false positive, which is checked
+/// with the node's hash later.
+static inline uint64_t _YYLinkedMapGroupMatch(uint64_t group, uint8_t h2) {
+    uint64_t x = group ^ (_YYLinkedMapGroupLSBs * h2);
+    return (x - _YYLinkedMapGroupLSBs) & ~x & _YYLinkedMapGroupMSBs;
+}
+
+/// Returns a bit mask of the empty bytes in group.
+static inline uint64_t _YYLinkedMapGroupMatchEmpty(uint64_t group) {
+    return group & ~(group << 6) & _YYLinkedMapGroupMSBs;
+}
+
+/// Returns a bit mask of the empty or deleted bytes in group.
+static inline uint64_t _YYLinkedMapGroupMatchEmptyOrDeleted(uint64_t group) {
+    return group & ~(group << 7) & _YYLinkedMapGroupMSBs;
+}
+
+/// Returns the position (0~7) of the lowest matched byte in mask.
+static inline NSUInteger _YYLinkedMapGroupFirst(uint64_t mask) {
+    return __builtin_ctzll(mask) >> 3;
+}
+
+static inline uint64_t _YYLinkedMapGroupLoad(const uint8_t *ctrl) {
+    uint64_t group;
+    memcpy(&group, ctrl, sizeof(group)); // little-endian on all supported architectures
+    return group;
+}
+
+
+/*
+ Frequency sketch of W-TinyLFU policy.
+ 
+ A count-min sketch with 4-bit counters, 16 counters are packed in a 64-bit
+ word. A key is counted in 4 rows, each row picks a word by a different hash,
+ and a counter in it by 2 bits of the key's hash. The estimated frequency is
+ the minimum of the 4 counters. After `sampleSize` increments, all counters are
+ halved, so the old popularity fades out.
+ */
+
+#define _YYFrequencySketchMaxLength (1 << 18)
+
+typedef struct {
+    uint64_t *table;
+    NSUInteger length;     // number of words, power of 2
+    NSUInteger additions;  // increments since last aging
+    NSUInteger sampleSize; // 10 * length
+} _YYFrequencySketch;
+
+static const uint64_t _YYFrequencySketchSeeds[4] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+};
+
+/// Make the table large enough for `capacity` keys, the counters are reset if
+/// it grows.
+static void _YYFrequencySketchEnsureCapacity(_YYFrequencySketch *sketch, NSUInteger capacity) {
+    NSUInteger length = 16;
+    while (length < capacity && length < _YYFrequencySketchMaxLength) length <<= 1;
+    if (length <= sketch->length) return;
+    free(sketch->table);
+    sketch->table = calloc(length, sizeof(uint64_t));
+    sketch->length = length;
+    sketch->additions = 0;
+    sketch->sampleSize = 10 * length;
+}
+
+/// Returns the bit offset of the key's counter in row `i`, and sets `word`.
+static inline NSUInteger _YYFrequencySketchLocate(_YYFrequencySketch *sketch, uint64_t hash, NSUInteger i, NSUInteger *word) {
+    uint64_t h = (hash + _YYFrequencySketchSeeds[i]) * _YYFrequencySketchSeeds[i];
+    h += h >> 32;
+    *word = (NSUInteger)h & (sketch->length - 1);
+    return ((i << 2) + ((hash >> (i << 3)) & 3)) << 2;
+}
+
+static inline NSUInteger _YYFrequencySketchFrequency(_YYFrequencySketch *sketch, uint64_t hash) {
+    NSUInteger frequency = 15;
+    for (NSUInteger i = 0; i < 4; i++) {
+        NSUInteger word;
+        NSUInteger offset = _YYFrequencySketchLocate(sketch, hash, i, &word);
+        NSUInteger count = (sketch->table[word] >> offset) & 0xF;
+        if (count < frequency) frequency = count;
+    }
+    return frequency;
+}
+
+static void _YYFrequencySketchIncrement(_YYFrequencySketch *sketch, uint64_t hash) {
+    BOOL added = NO;
+    for (NSUInteger i = 0; i < 4; i++) {
+        NSUInteger word;
+        NSUInteger offset = _YYFrequencySketchLocate(sketch, hash, i, &word);
+        if (((sketch->table[word] >> offset) & 0xF) != 0xF) {
+            sketch->table[word] += 1ULL << offset;
+            added = YES;
+        }
+    }
+    if (added && ++sketch->additions == sketch->sampleSize) {
+        // 衰减：所有计数减半
+        for (NSUInteger i = 0; i < sketch->length; i++) {
+            sketch->table[i] = (sketch->table[i] >> 1) & 0x7777777777777777ULL;
+        }
+        sketch->additions /= 2;
+    }
+}
+
+/*
+ Ghost entries of ARC, 2Q and S3-FIFO policies.
+ 
+ A bounded FIFO of the hashes of recently evicted keys, with a linear probing
+ set for lookup. The set remembers the FIFO slot of the newest entry of each
+ hash: `remove` only removes the hash from the set, and a popped entry removes
+ its hash only if it's the newest one, so the older entries of a hash which is
+ added again (or removed) are skipped. Hash collision may give a false hit,
+ which only makes the policy a little less accurate.
+ */
+
+#define _YYLinkedMapGhostMaxCapacity (1 << 20)
+
+typedef struct {
+    uint64_t *queue;    // FIFO ring of hashes
+    NSUInteger capacity; // power of 2, 0 before first use
+    NSUInteger start;    // index of the oldest hash in queue
+    NSUInteger queued;   // hashes in queue (including removed ones)
+    uint64_t *set;      // linear probing set of 2 * capacity slots, 0 is empty
+    uint32_t *latest;   // queue index of the newest entry of each hash in set
+    NSUInteger count;    // hashes in set
+} _YYLinkedMapGhost;
+
+/// Hash 0 marks an empty slot in set.
+static inline uint64_t _YYLinkedMapGhostKey(uint64_t hash) {
+    return hash ? hash : 1;
+}
+
+/// Returns the set slot of the hash, or the empty slot where it should be.
+static inline NSUInteger _YYLinkedMapGhostProbe(_YYLinkedMapGhost *ghost, uint64_t key) {
+    NSUInteger mask = ghost->capacity * 2 - 1;
+    NSUInteger i = (NSUInteger)key & mask;
+    while (ghost->set[i] && ghost->set[i] != key) i = (i + 1) & mask;
+    return i;
+}
+
+static inline BOOL _YYLinkedMapGhostContains(_YYLinkedMapGhost *ghost, uint64_t hash) {
+    if (ghost->count == 0) return NO;
+    return ghost->set[_YYLinkedMapGhostProbe(ghost, _YYLinkedMapGhostKey(hash))] != 0;
+}
+
+/// Remove the hash in set slot `i`.
+static void _YYLinkedMapGhostRemoveSlot(_YYLinkedMapGhost *ghost, NSUInteger i) {
+    NSUInteger mask = ghost->capacity * 2 - 1;
+    ghost->set[i] = 0;
+    ghost->count--;
+    // backward shift deletion, so the probe sequence doesn't need tombstones
+    for (NSUInteger j = (i + 1) & mask; ghost->set[j]; j = (j + 1) & mask) {
+        NSUInteger home = (NSUInteger)ghost->set[j] & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            ghost->set[i] = ghost->set[j];
+            ghost->latest[i] = ghost->latest[j];
+            ghost->set[j] = 0;
+            i = j;
+        }
+    }
+}
+
+/// Remove the hash from set, returns NO if it's not in the ghost.
+static BOOL _YYLinkedMapGhostRemove(_YYLinkedMapGhost *ghost, uint64_t hash) {
+    if (ghost->count == 0) return NO;
+    NSUInteger i = _YYLinkedMapGhostProbe(ghost, _YYLinkedMapGhostKey(hash));
+    if (!ghost->set[i]) return NO;
+    _YYLinkedMapGhostRemoveSlot(ghost, i);
+    return YES;
+}
+
+/// Add the hash as the newest entry, the oldest entry is dropped if the ghost
+/// is full.
+static void _YYLinkedMapGhostAdd(_YYLinkedMapGhost *ghost, uint64_t hash) {
+    if (ghost->capacity == 0) return;
+    uint64_t key = _YYLinkedMapGhostKey(hash);
+    if (ghost->queued == ghost->capacity) {
+        // 只有最新的一项才从集合中移除，同一hash更早的项已经过时
+        NSUInteger i = _YYLinkedMapGhostProbe(ghost, ghost->queue[ghost->start]);
+        if (ghost->set[i] && ghost->latest[i] == ghost->start) _YYLinkedMapGhostRemoveSlot(ghost, i);
+        ghost->start = (ghost->start + 1) & (ghost->capacity - 1);
+        ghost->queued--;
+    }
+    NSUInteger index = (ghost->start + ghost->queued) & (ghost->capacity - 1);
+    NSUInteger i = _YYLinkedMapGhostProbe(ghost, key);
+    if (!ghost->set[i]) {
+        ghost->set[i] = key;
+        ghost->count++;
+    }
+    ghost->latest[i] = (uint32_t)index;
+    ghost->queue[index] = key;
+    ghost->queued++;
+}
+
+/// Make the ghost hold at least `capacity` hashes, existing hashes are kept.
+static void _YYLinkedMapGhostReserve(_YYLinkedMapGhost *ghost, NSUInteger capacity) {
+    if (capacity <= ghost->capacity || ghost->capacity >= _YYLinkedMapGhostMaxCapacity) return;
+    NSUInteger newCapacity = 16;
+    while (newCapacity < capacity && newCapacity < _YYLinkedMapGhostMaxCapacity) newCapacity <<= 1;
+    if (newCapacity <= ghost->capacity) return;
+    _YYLinkedMapGhost old = *ghost;
+    ghost->queue = malloc(newCapacity * sizeof(uint64_t));
+    ghost->set = calloc(newCapacity * 2, sizeof(uint64_t));
+    ghost->latest = malloc(newCapacity * 2 * sizeof(uint32_t));
+    ghost->capacity = newCapacity;
+    ghost->start = ghost->queued = ghost->count = 0;
+    // 只保留每个hash最新的一项
+    for (NSUInteger i = 0; i < old.queued; i++) {
+        NSUInteger index = (old.start + i) & (old.capacity - 1);
+        uint64_t key = old.queue[index];
+        NSUInteger slot = _YYLinkedMapGhostProbe(&old, key);
+        if (old.set[slot] && old.latest[slot] == index) _YYLinkedMapGhostAdd(ghost, key);
+    }
+    free(old.queue);
+    free(old.set);
+    free(old.latest);
+}
+
+/**
+ A doubly linked list of nodes, head is MRU and tail is LRU.
+ A map has `_YYLinkedMapSegmentCount` lists, a node's `_segment` is the list
+ that holds it. Single list policies (LRU, CLOCK, BufferedLRU) only use list 0,
+ the meaning of the others depends on the policy:
+ 
+     W-TinyLFU: window, probation, protected
+     ARC:       T1 (seen once), T2 (seen at least twice)
+     2Q:        A1in (FIFO), Am (LRU)
+     S3-FIFO:   small (FIFO), main (FIFO)
+ */
+typedef struct {
+    _YYLinkedMapIndex head;
+    _YYLinkedMapIndex tail;
+    NSUInteger count;
+} _YYLinkedMapList;
+
+#define _YYLinkedMapSegmentCount 3
+
+@class _YYLinkedMap;
+
+/**
+ Callbacks of an eviction policy. The map calls them with the write lock held:
+ 
+     didInsert:  a new node is added to the map, link it into a list.
+     didHit:     a node is read by `objectForKey:` or updated by `setObject:`.
+     willRemove: a node will be removed from the map, unlink it.
+     victim:     returns the node to evict, or _YYLinkedMapNil if the map is 
+                 empty. It may reorder the lists or remember the key as ghost.
+ */
+typedef struct {
+    void (*didInsert)(_YYLinkedMap *map, _YYLinkedMapIndex index);
+    void (*didHit)(_YYLinkedMap *map, _YYLinkedMapIndex index);
+    void (*willRemove)(_YYLinkedMap *map, _YYLinkedMapIndex index);
+    _YYLinkedMapIndex (*victim)(_YYLinkedMap *map);
+} _YYLinkedMapPolicyCallBacks;
+
+/**
+ The position of an enumeration in a map, it's registered to the map while the
+ enumeration is in progress. When the node of a cursor is unlinked (removed or
+ moved), the map moves the cursor to the neighbor first, so the enumeration can
+ release the lock between batches and continue from the same position later.
+ */
+typedef struct _YYLinkedMapCursor {
+    uint8_t segment;          // the list being enumerated, _YYLinkedMapSegmentCount when finished
+    BOOL pending;             // YES: `index` is the next node to visit, NO: the last visited node
+    _YYLinkedMapIndex index;  // _YYLinkedMapNil with `pending` means the end of list
+    struct _YYLinkedMapCursor *next; // next cursor of the map
+} _YYLinkedMapCursor;
+
+
+/**
+ A linked map used by YYMemoryCache, each map is a shard of the cache.
+ It's not thread-safe and does not validate the parameters, the caller should
+ hold the lock (see `_YYLinkedMapLock()`) while accessing the map.
+ 
+ The lists are maintained by the eviction policy through `_callBacks`, see 
+ "Eviction policies" below. With CLOCK policy, a hit only sets the node's
+ `_referenced` bit, so it can be done with a shared (read) lock. With BufferedLRU
+ policy, a hit is recorded into `_readBuffers` with a shared lock, the records
+ are replayed in order by the next writer (see `drainReadBuffers`).
  
  Typically, you should not use this class directly.
  */
@@ -63,193 +647,1676 @@ static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
 @interface _YYLinkedMap : NSObject {
 //    @package是为了不让framework外部对其进行操作
     @package
-// 用字典保存所有节点_YYLinkedMapNode (为什么不用oc字典?因为用CFMutableDictionaryRef效率高，毕竟基于c)
-    CFMutableDictionaryRef _dic; // do not set object directly
+//    哈希表：控制字节与节点索引 (见上面的说明)
+    uint8_t *_ctrl;
+    _YYLinkedMapIndex *_slots;
+    NSUInteger _tableCapacity; // number of slots, 0 or power of 2 (>= 8)
+    NSUInteger _tableUsed;     // full and deleted slots
 //    总缓存开销
     NSUInteger _totalCost;
 //    总缓存数量
     NSUInteger _totalCount;
-//    链表头节点
-    _YYLinkedMapNode *_head; // MRU, do not change it directly
-//    链表尾节点
-    _YYLinkedMapNode *_tail; // LRU, do not change it directly
-    // 是否在主线程上，异步释放 _YYLinkedMapNode对象
+//    链表 (头节点MRU，尾节点LRU)，分段的策略会用到多个链表
+    _YYLinkedMapList _lists[_YYLinkedMapSegmentCount]; // do not change it directly
+    // 节点池：每个slab是一块连续的_YYLinkedMapNode数组，_linkSlabs是与之平行的_YYLinkedMapLink数组
+    _YYLinkedMapNode **_slabs;
+    _YYLinkedMapLink **_linkSlabs;
+    uint32_t _slabCount;
+    uint32_t _slabCapacity;
+    // 空闲节点链表
+    _YYLinkedMapIndex _freeList;
+    // 是否在主线程上，异步释放 key/value
     BOOL _releaseOnMainThread;
-    // 是否异步释放 _YYLinkedMapNode对象
+    // 是否异步释放 key/value
     BOOL _releaseAsynchronously;
+    YYMemoryCacheEvictionPolicy _policy;
+    BOOL _sharedRead; // use `_rwlock` instead of `_lock`, readers share the lock
+    _YYLinkedMapReadBuffer *_readBuffers; // BufferedLRU only, _YYLinkedMapReadBufferStripes buffers
+    // 淘汰策略
+    const _YYLinkedMapPolicyCallBacks *_callBacks;
+    _YYFrequencySketch _sketch;   // W-TinyLFU
+    _YYLinkedMapGhost _ghosts[2]; // ARC: B1, B2. 2Q: A1out. S3-FIFO: G
+    NSUInteger _arcTarget;        // ARC: target count of T1
+    NSUInteger _capacity;         // fixed capacity, 0 means the map grows on demand
+    _YYLinkedMapCursor *_cursors; // enumerations in progress
+    pthread_mutex_t _lock; // guards this map
+    pthread_rwlock_t _rwlock;
+    // 过期时间轮 (见 "Timer wheel")
+    _YYLinkedMapIndex *_wheel;  // bucket heads, NULL before the first node with TTL
+    uint64_t _wheelTick;         // the last processed tick
+    NSTimeInterval _wheelStart;  // time of tick 0
+    NSUInteger _timerCount;      // nodes in the wheel
+    _YYLinkedMapTotals *_totals; // shared by all maps of a cache, not owned
+}
+
+/// Create a map which also adds its cost and count to `totals`.
+- (instancetype)initWithTotals:(_YYLinkedMapTotals *)totals policy:(YYMemoryCacheEvictionPolicy)policy;
+
+/// Take a node from free list, insert it by the policy and update the total cost.
+/// Value should not be nil, and key should not be inside the map.
+/// `hash` should be `_YYMemoryCacheHash(key)`, or key is nil for an integer key (see `_YYLinkedMapFind`).
+// 添加节点到链表头节点
+- (_YYLinkedMapIndex)insertNodeAtHeadWithKey:(id)key hash:(uint64_t)hash value:(id)value cost:(NSUInteger)cost time:(NSTimeInterval)time;
+
+/// Bring a inner node to header of its list.
+/// Node should already inside the map.
+// 移动当前节点到链表头节点
+- (void)bringNodeToHead:(_YYLinkedMapIndex)index;
+
+/// Record a hit of a inner node, see `didHit` of the policy.
+- (void)accessNode:(_YYLinkedMapIndex)index;
+
+/// Remove a inner node and update the total cost, the node is put back to free list.
+/// Node should already inside the map.
+/// Returns the removed key-value pair, the caller should release it.
+// 移除链表节点
+- (_YYLinkedMapEntry)removeNode:(_YYLinkedMapIndex)index;
+
+/// Remove tail node of list 0 if exist.
+/// Returns the removed key-value pair (NULL if the map is empty).
+// 移除链表尾节点(如果存在)
+- (_YYLinkedMapEntry)removeTailNode;
+
+/// Remove the node chosen by eviction policy if exist, see `victim` of the policy.
+/// Returns the removed key-value pair (NULL if the map is empty).
+- (_YYLinkedMapEntry)removeVictimNode;
+
+/// Move the nodes recorded in read buffers to head, in the order of the hits.
+/// Records of removed nodes are skipped. The map should be locked for writing.
+- (void)drainReadBuffers;
+
+/// Returns the node which is the oldest by access time (approximately for 
+/// multiple lists and FIFO lists), or _YYLinkedMapNil if the map is empty.
+- (_YYLinkedMapIndex)oldestNode;
+
+/// Set the object for key, a node is inserted if the key is not in the map. 
+/// `ttl` <= 0 means never expire, `refreshAfter` <= 0 means never refresh.
+/// If the map has a fixed capacity and it's full, the victim node is removed into
+/// `evicted` first, and its node is reused by the new key.
+/// Returns the replaced value (retained), or NULL, the caller should release it after unlock.
+- (CFTypeRef)storeObject:(id)object forKey:(id)key hash:(uint64_t)hash cost:(NSUInteger)cost ttl:(NSTimeInterval)ttl refreshAfter:(NSTimeInterval)refreshAfter time:(NSTimeInterval)now evicted:(_YYLinkedMapEntry *)evicted;
+
+/// Preallocate the nodes, hash table, timer wheel and policy data for `capacity`
+/// nodes, and limit the map to `capacity` nodes (see `storeObject:`). After that,
+/// insertion and eviction never allocate memory. 0 means the map grows on demand.
+- (void)reserveCapacity:(NSUInteger)capacity;
+
+/// Change the expiration time of a inner node, 0 means never expire.
+- (void)setExpire:(NSTimeInterval)expire forNode:(_YYLinkedMapIndex)index;
+
+/// Advance the timer wheel to `now` and remove the expired nodes into holder.
+- (void)removeExpiredNodes:(NSTimeInterval)now holder:(_YYLinkedMapHolder *)holder;
+
+/// Change the cost of a inner node and update the total cost.
+- (void)setCost:(NSUInteger)cost forNode:(_YYLinkedMapIndex)index;
+
+/// Remove all node in background queue.
+// 移除所有缓存
+- (void)removeAll;
+
+/// Register the cursor at the head of list 0. The map should be locked for writing.
+- (void)addCursor:(_YYLinkedMapCursor *)cursor;
+
+/// Unregister the cursor. The map should be locked for writing.
+- (void)removeCursor:(_YYLinkedMapCursor *)cursor;
+
+/// Copy at most `count` unexpired entries from the cursor in MRU order of each
+/// list (list 0 first), and advance the cursor. Keys and values are retained, an
+/// integer key is NULL and its hash is in `hashes`. Returns the number of copied
+/// entries, 0 means the enumeration is finished. A shared lock is enough.
+- (NSUInteger)copyEntriesFromCursor:(_YYLinkedMapCursor *)cursor entries:(_YYLinkedMapEntry *)entries hashes:(uint64_t *)hashes count:(NSUInteger)count time:(NSTimeInterval)now;
+
+@end
+
+/// Lock the map for writing. Pending hits in read buffers are applied first.
+static inline void _YYLinkedMapLock(_YYLinkedMap *map) {
+    if (map->_sharedRead) pthread_rwlock_wrlock(&map->_rwlock);
+    else pthread_mutex_lock(&map->_lock);
+    if (map->_readBuffers) [map drainReadBuffers];
+}
+
+/// Try to lock the map for writing, returns 0 on success.
+static inline int _YYLinkedMapTryLock(_YYLinkedMap *map) {
+    int result;
+    if (map->_sharedRead) result = pthread_rwlock_trywrlock(&map->_rwlock);
+    else result = pthread_mutex_trylock(&map->_lock);
+    if (result == 0 && map->_readBuffers) [map drainReadBuffers];
+    return result;
+}
+
+/// Lock the map for reading, the reader should not change the map except the
+/// atomic fields. It's the same as `_YYLinkedMapLock()` if readers can't share.
+static inline void _YYLinkedMapLockForReading(_YYLinkedMap *map) {
+    if (map->_sharedRead) pthread_rwlock_rdlock(&map->_rwlock);
+    else pthread_mutex_lock(&map->_lock);
+}
+
+static inline void _YYLinkedMapUnlock(_YYLinkedMap *map) {
+    if (map->_sharedRead) pthread_rwlock_unlock(&map->_rwlock);
+    else pthread_mutex_unlock(&map->_lock);
+}
+
+/// Record a hit of the node into the read buffer of current thread's stripe.
+/// The map should be locked for reading. Returns YES if the buffer is half full
+/// (or full, the hit is dropped), the caller should try to drain it.
+static inline BOOL _YYLinkedMapRecordRead(_YYLinkedMap *map, _YYLinkedMapIndex index, uint32_t generation) {
+    NSUInteger stripe = _YYMemoryCacheHashMix((uintptr_t)pthread_self()) & (_YYLinkedMapReadBufferStripes - 1);
+    _YYLinkedMapReadBuffer *buffer = map->_readBuffers + stripe;
+    uint32_t write = atomic_load_explicit(&buffer->writeCount, memory_order_relaxed);
+    do {
+        if (write - buffer->readCount >= _YYLinkedMapReadBufferSize) return YES;
+    } while (!atomic_compare_exchange_weak_explicit(&buffer->writeCount, &write, write + 1, memory_order_relaxed, memory_order_relaxed));
+    atomic_store_explicit(&buffer->records[write & _YYLinkedMapReadBufferMask], ((uint64_t)generation << 32) | index, memory_order_relaxed);
+    return write + 1 - buffer->readCount >= _YYLinkedMapReadBufferSize / 2;
+}
+
+/// Returns the node at the index.
+static inline _YYLinkedMapNode *_YYLinkedMapGetNode(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    return _YYLinkedMapSlabsGetNode(map->_slabs, index);
+}
+
+/// Returns the link of the node at the index.
+static inline _YYLinkedMapLink *_YYLinkedMapGetLink(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    return &map->_linkSlabs[index >> _YYLinkedMapSlabShift][index & _YYLinkedMapSlabMask];
+}
+
+/// Move the cursors at the node to its neighbor, it should be called before
+/// the node is unlinked from its list.
+static void _YYLinkedMapCursorsWillUnlink(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    for (_YYLinkedMapCursor *cursor = map->_cursors; cursor; cursor = cursor->next) {
+        if (cursor->index != index) continue;
+        _YYLinkedMapLink *link = _YYLinkedMapGetLink(map, index);
+        if (cursor->pending || link->_prev == _YYLinkedMapNil) {
+            // 下一个要访问的节点被移走，或者已访问的节点是头节点：指向后一个未访问的节点
+            cursor->index = link->_next;
+            cursor->pending = YES;
+        } else {
+            // 已访问的节点被移走：退回到前一个节点，之后仍从它的下一个节点继续
+            cursor->index = link->_prev;
+        }
+    }
+}
+
+/// Unlink the node from its list.
+static inline void _YYLinkedMapListUnlink(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    if (map->_cursors) _YYLinkedMapCursorsWillUnlink(map, index);
+    _YYLinkedMapLink *link = _YYLinkedMapGetLink(map, index);
+    _YYLinkedMapList *list = &map->_lists[link->_segment];
+    if (link->_next != _YYLinkedMapNil) _YYLinkedMapGetLink(map, link->_next)->_prev = link->_prev;
+    if (link->_prev != _YYLinkedMapNil) _YYLinkedMapGetLink(map, link->_prev)->_next = link->_next;
+    if (list->head == index) list->head = link->_next;
+    if (list->tail == index) list->tail = link->_prev;
+    list->count--;
+}
+
+/// Link an unlinked node at the head of the segment's list.
+static inline void _YYLinkedMapListInsertHead(_YYLinkedMap *map, _YYLinkedMapIndex index, uint8_t segment) {
+    _YYLinkedMapLink *link = _YYLinkedMapGetLink(map, index);
+    _YYLinkedMapList *list = &map->_lists[segment];
+    link->_segment = segment;
+    link->_prev = _YYLinkedMapNil;
+    link->_next = list->head;
+    if (list->head != _YYLinkedMapNil) _YYLinkedMapGetLink(map, list->head)->_prev = index;
+    else list->tail = index;
+    list->head = index;
+    list->count++;
+}
+
+/// Move a linked node to the head of the segment's list.
+static inline void _YYLinkedMapListMoveToHead(_YYLinkedMap *map, _YYLinkedMapIndex index, uint8_t segment) {
+    _YYLinkedMapListUnlink(map, index);
+    _YYLinkedMapListInsertHead(map, index, segment);
+}
+
+/// Whether the node has expired at `now`.
+static inline BOOL _YYLinkedMapNodeExpired(_YYLinkedMapNode *node, NSTimeInterval now) {
+    return node->_expire != 0 && node->_expire <= now;
+}
+
+/// Returns YES if the node's refresh is due at `now`, the refresh is cleared so
+/// only one reader claims it. It may be called with a shared lock.
+static inline BOOL _YYLinkedMapNodeClaimRefresh(_YYLinkedMapNode *node, NSTimeInterval now) {
+    NSTimeInterval refresh, none = 0;
+    __atomic_load(&node->_refresh, &refresh, __ATOMIC_RELAXED);
+    if (refresh == 0 || refresh > now) return NO;
+    return __atomic_compare_exchange(&node->_refresh, &refresh, &none, NO, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+
+#pragma mark - Timer wheel
+
+/*
+ Hierarchical timing wheel of the nodes with TTL.
+ 
+ There are 4 levels of 64 buckets, a bucket of level L covers 64^L ticks (1 
+ second each), so the levels cover about 1 minute, 1 hour, 3 days and 6 months.
+ A node is put into the lowest level that can hold its expiration tick. When the
+ wheel advances to the start of a bucket of higher level, the nodes in it are
+ redistributed to the lower levels, and nodes in the level 0 bucket of the tick
+ are expired. Each node is moved at most 4 times, so expiration is O(1).
+ The wheel jumps over the ticks which have nothing to process, so catching up
+ after a long idle time costs at most one scan of each level per bucket.
+ */
+
+#define _YYTimerWheelBits 6
+#define _YYTimerWheelSize (1 << _YYTimerWheelBits)
+#define _YYTimerWheelLevels 4
+#define _YYTimerWheelTick 1.0 // seconds
+
+/// Allocate the buckets of timer wheel if needed.
+static inline void _YYTimerWheelReserve(_YYLinkedMap *map) {
+    if (map->_wheel) return;
+    map->_wheel = malloc(_YYTimerWheelLevels * _YYTimerWheelSize * sizeof(_YYLinkedMapIndex));
+    memset(map->_wheel, 0xFF, _YYTimerWheelLevels * _YYTimerWheelSize * sizeof(_YYLinkedMapIndex)); // _YYLinkedMapNil
+}
+
+/// Returns the first tick at or after `time`.
+static inline uint64_t _YYTimerWheelTickOfTime(_YYLinkedMap *map, NSTimeInterval time) {
+    if (time <= map->_wheelStart) return 0;
+    return (uint64_t)ceil((time - map->_wheelStart) / _YYTimerWheelTick);
+}
+
+/// Put the node into the bucket of `tick`, which should not be before `_wheelTick`.
+static inline void _YYTimerWheelInsert(_YYLinkedMap *map, _YYLinkedMapIndex index, uint64_t tick) {
+    uint64_t delta = tick - map->_wheelTick;
+    NSUInteger level = 0;
+    while (level < _YYTimerWheelLevels - 1 && delta >= (1ULL << (_YYTimerWheelBits * (level + 1)))) level++;
+    if (delta >= (1ULL << (_YYTimerWheelBits * _YYTimerWheelLevels))) {
+        // 超出时间轮范围，先放到最远的桶，之后重新分配
+        tick = map->_wheelTick + (1ULL << (_YYTimerWheelBits * _YYTimerWheelLevels)) - 1;
+    }
+    NSUInteger bucket = level * _YYTimerWheelSize + ((tick >> (_YYTimerWheelBits * level)) & (_YYTimerWheelSize - 1));
+    _YYLinkedMapNode *node = _YYLinkedMapGetNode(map, index);
+    node->_timerBucket = bucket;
+    node->_timerPrev = _YYLinkedMapNil;
+    node->_timerNext = map->_wheel[bucket];
+    if (node->_timerNext != _YYLinkedMapNil) _YYLinkedMapGetNode(map, node->_timerNext)->_timerPrev = index;
+    map->_wheel[bucket] = index;
+    map->_timerCount++;
+}
+
+/// Remove the node from its bucket.
+static inline void _YYTimerWheelUnlink(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYLinkedMapNode *node = _YYLinkedMapGetNode(map, index);
+    if (node->_timerNext != _YYLinkedMapNil) _YYLinkedMapGetNode(map, node->_timerNext)->_timerPrev = node->_timerPrev;
+    if (node->_timerPrev != _YYLinkedMapNil) _YYLinkedMapGetNode(map, node->_timerPrev)->_timerNext = node->_timerNext;
+    else map->_wheel[node->_timerBucket] = node->_timerNext;
+    map->_timerCount--;
+}
+
+/// Returns the next tick after `_wheelTick` which has a non-empty bucket to process
+/// (a level 0 bucket, or a higher level bucket to redistribute), or UINT64_MAX if
+/// the wheel is empty. A level holds the next 64 buckets of its size, so each
+/// level is scanned for at most one rotation.
+static uint64_t _YYTimerWheelNextTick(_YYLinkedMap *map) {
+    uint64_t next = UINT64_MAX;
+    for (NSUInteger level = 0; level < _YYTimerWheelLevels; level++) {
+        NSUInteger shift = _YYTimerWheelBits * level;
+        uint64_t base = map->_wheelTick >> shift;
+        for (uint64_t k = base + 1; k <= base + _YYTimerWheelSize; k++) {
+            if (map->_wheel[level * _YYTimerWheelSize + (k & (_YYTimerWheelSize - 1))] == _YYLinkedMapNil) continue;
+            next = MIN(next, k << shift);
+            break;
+        }
+    }
+    return next;
+}
+
+/// Returns the index of the node for the key, or _YYLinkedMapNil.
+/// `hash` should be `_YYMemoryCacheHash(key)`. For an integer key, `key` is nil
+/// and `hash` is `_YYMemoryCacheIntegerHash()`.
+static inline _YYLinkedMapIndex _YYLinkedMapFind(_YYLinkedMap *map, id key, uint64_t hash) {
+    if (map->_tableCapacity == 0) return _YYLinkedMapNil;
+    CFTypeRef keyRef = (__bridge CFTypeRef)(key);
+    uint8_t h2 = hash & 0x7F;
+    NSUInteger groupMask = map->_tableCapacity / _YYLinkedMapGroupSize - 1;
+    NSUInteger group = (NSUInteger)(hash >> 7) & groupMask;
+    for (NSUInteger step = 1; ; step++) {
+        uint64_t ctrl = _YYLinkedMapGroupLoad(map->_ctrl + group * _YYLinkedMapGroupSize);
+        for (uint64_t match = _YYLinkedMapGroupMatch(ctrl, h2); match; match &= match - 1) {
+            _YYLinkedMapIndex index = map->_slots[group * _YYLinkedMapGroupSize + _YYLinkedMapGroupFirst(match)];
+            _YYLinkedMapNode *node = _YYLinkedMapGetNode(map, index);
+            if (node->_hash == hash && (node->_key == keyRef || (keyRef && node->_key && CFEqual(node->_key, keyRef)))) return index;
+        }
+        if (_YYLinkedMapGroupMatchEmpty(ctrl)) return _YYLinkedMapNil;
+        group = (group + step) & groupMask;
+    }
+}
+
+/// Prefetch the home group of the hash, a batch prefetches all its keys before
+/// the first probe, so the cache misses of the table overlap.
+static inline void _YYLinkedMapPrefetch(_YYLinkedMap *map, uint64_t hash) {
+    if (map->_tableCapacity == 0) return;
+    NSUInteger groupMask = map->_tableCapacity / _YYLinkedMapGroupSize - 1;
+    NSUInteger group = (NSUInteger)(hash >> 7) & groupMask;
+    __builtin_prefetch(map->_ctrl + group * _YYLinkedMapGroupSize);
+    __builtin_prefetch(map->_slots + group * _YYLinkedMapGroupSize);
+}
+
+
+#pragma mark - Eviction policies
+
+/// Unlink the node, it's the `willRemove` of all policies.
+static void _YYLinkedMapPolicyUnlink(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYLinkedMapListUnlink(map, index);
+}
+
+/*
+ LRU (and BufferedLRU): a hit moves the node to head, the tail is evicted.
+ */
+
+static void _YYLRUPolicyInsert(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYLinkedMapListInsertHead(map, index, 0);
+}
+
+static void _YYLRUPolicyHit(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    [map bringNodeToHead:index];
+}
+
+static _YYLinkedMapIndex _YYLRUPolicyVictim(_YYLinkedMap *map) {
+    return map->_lists[0].tail;
+}
+
+static const _YYLinkedMapPolicyCallBacks _YYLRUPolicyCallBacks = {
+    _YYLRUPolicyInsert, _YYLRUPolicyHit, _YYLinkedMapPolicyUnlink, _YYLRUPolicyVictim
+};
+
+/*
+ CLOCK: the list is a FIFO queue, its tail is the clock hand. A hit sets the
+ node's reference bit, the hand gives referenced nodes a second chance.
+ */
+
+static void _YYCLOCKPolicyHit(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYLinkedMapGetLink(map, index)->_referenced = 1;
+}
+
+static _YYLinkedMapIndex _YYCLOCKPolicyVictim(_YYLinkedMap *map) {
+    // 时钟指针从尾部扫过，被引用过的节点清除引用位后移到头部 (second chance)
+    for (NSUInteger passed = 0; map->_lists[0].tail != _YYLinkedMapNil && passed < map->_totalCount; passed++) {
+        _YYLinkedMapLink *link = _YYLinkedMapGetLink(map, map->_lists[0].tail);
+        if (!link->_referenced) break;
+        link->_referenced = 0;
+        [map bringNodeToHead:map->_lists[0].tail];
+    }
+    return map->_lists[0].tail;
+}
+
+static const _YYLinkedMapPolicyCallBacks _YYCLOCKPolicyCallBacks = {
+    _YYLRUPolicyInsert, _YYCLOCKPolicyHit, _YYLinkedMapPolicyUnlink, _YYCLOCKPolicyVictim
+};
+
+/*
+ W-TinyLFU: list 0 is the admission window (1% of the nodes), lists 1 and 2 are
+ the probation and protected (80%) segments of the main region, a probation node
+ is promoted to protected on a hit. The node overflowing the window is the
+ candidate for the main region: if the map has to evict, the candidate and the
+ LRU node of probation (the victim) are compared by the frequency sketch, the
+ less frequent one is removed and the other one stays in the main region (ties
+ reject the candidate), so one-off keys can't flush the frequent ones. If no
+ eviction follows, the map has room and the candidate is admitted on the next
+ insert.
+ */
+
+#define _YYTinyLFUWindow 0
+#define _YYTinyLFUProbation 1
+#define _YYTinyLFUProtected 2
+
+static inline NSUInteger _YYTinyLFUWindowLimit(_YYLinkedMap *map) {
+    return MAX(map->_totalCount / 100, 1);
+}
+
+static void _YYTinyLFUPolicyInsert(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYFrequencySketchEnsureCapacity(&map->_sketch, map->_totalCount);
+    _YYFrequencySketchIncrement(&map->_sketch, _YYLinkedMapGetNode(map, index)->_hash);
+    // 上一次写入溢出窗口区的候选者没有被淘汰比较，说明还有空间，直接进入试用区
+    NSUInteger limit = _YYTinyLFUWindowLimit(map);
+    while (map->_lists[_YYTinyLFUWindow].count > limit) {
+        _YYLinkedMapListMoveToHead(map, map->_lists[_YYTinyLFUWindow].tail, _YYTinyLFUProbation);
+    }
+    // 窗口区可能超出1个，尾部是本次写入的候选者
+    _YYLinkedMapListInsertHead(map, index, _YYTinyLFUWindow);
+}
+
+static void _YYTinyLFUPolicyHit(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYFrequencySketchIncrement(&map->_sketch, _YYLinkedMapGetNode(map, index)->_hash);
+    switch (_YYLinkedMapGetLink(map, index)->_segment) {
+        case _YYTinyLFUWindow: {
+            [map bringNodeToHead:index];
+        } break;
+        case _YYTinyLFUProbation: {
+            // 晋升到保护区，保护区超出限制时把最旧的节点降回试用区
+            _YYLinkedMapListMoveToHead(map, index, _YYTinyLFUProtected);
+            NSUInteger protectedLimit = (map->_totalCount - _YYTinyLFUWindowLimit(map)) / 5 * 4;
+            if (map->_lists[_YYTinyLFUProtected].count > protectedLimit) {
+                _YYLinkedMapListMoveToHead(map, map->_lists[_YYTinyLFUProtected].tail, _YYTinyLFUProbation);
+            }
+        } break;
+        default: {
+            [map bringNodeToHead:index];
+        } break;
+    }
+}
+
+static _YYLinkedMapIndex _YYTinyLFUPolicyVictim(_YYLinkedMap *map) {
+    _YYLinkedMapIndex victim = map->_lists[_YYTinyLFUProbation].tail;
+    if (victim == _YYLinkedMapNil) victim = map->_lists[_YYTinyLFUProtected].tail;
+    _YYLinkedMapList *window = &map->_lists[_YYTinyLFUWindow];
+    if (window->count > _YYTinyLFUWindowLimit(map) || victim == _YYLinkedMapNil) {
+        // 候选者(窗口区尾部)和受害者(试用区尾部)比较频率，淘汰频率低的，胜者留在主区
+        _YYLinkedMapIndex candidate = window->tail;
+        if (victim == _YYLinkedMapNil ||
+            _YYFrequencySketchFrequency(&map->_sketch, _YYLinkedMapGetNode(map, candidate)->_hash) <=
+            _YYFrequencySketchFrequency(&map->_sketch, _YYLinkedMapGetNode(map, victim)->_hash)) {
+            return candidate;
+        }
+        _YYLinkedMapListMoveToHead(map, candidate, _YYTinyLFUProbation);
+    }
+    return victim;
+}
+
+static const _YYLinkedMapPolicyCallBacks _YYTinyLFUPolicyCallBacks = {
+    _YYTinyLFUPolicyInsert, _YYTinyLFUPolicyHit, _YYLinkedMapPolicyUnlink, _YYTinyLFUPolicyVictim
+};
+
+/*
+ ARC (Adaptive Replacement Cache): T1 holds the nodes seen once, T2 holds the
+ nodes seen at least twice, both are LRU. B1 and B2 are the ghosts of keys 
+ evicted from T1 and T2. A new key found in B1 means T1 is too small, so the 
+ target size of T1 grows, and a key found in B2 shrinks it. The cache size `c`
+ is the node count of the map when evicting, as the map is full then.
+ */
+
+#define _YYARCT1 0
+#define _YYARCT2 1
+
+static void _YYARCPolicyInsert(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    uint64_t hash = _YYLinkedMapGetNode(map, index)->_hash;
+    _YYLinkedMapGhost *b1 = &map->_ghosts[0], *b2 = &map->_ghosts[1];
+    NSUInteger b1Count = b1->count, b2Count = b2->count;
+    if (_YYLinkedMapGhostRemove(b1, hash)) {
+        NSUInteger delta = b1Count >= b2Count ? 1 : b2Count / b1Count;
+        map->_arcTarget = MIN(map->_arcTarget + delta, map->_totalCount);
+        _YYLinkedMapListInsertHead(map, index, _YYARCT2);
+    } else if (_YYLinkedMapGhostRemove(b2, hash)) {
+        NSUInteger delta = b2Count >= b1Count ? 1 : b1Count / b2Count;
+        map->_arcTarget = map->_arcTarget > delta ? map->_arcTarget - delta : 0;
+        _YYLinkedMapListInsertHead(map, index, _YYARCT2);
+    } else {
+        _YYLinkedMapListInsertHead(map, index, _YYARCT1);
+    }
+}
+
+static void _YYARCPolicyHit(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYLinkedMapListMoveToHead(map, index, _YYARCT2);
+}
+
+static _YYLinkedMapIndex _YYARCPolicyVictim(_YYLinkedMap *map) {
+    _YYLinkedMapList *t1 = &map->_lists[_YYARCT1], *t2 = &map->_lists[_YYARCT2];
+    _YYLinkedMapGhostReserve(&map->_ghosts[0], map->_totalCount);
+    _YYLinkedMapGhostReserve(&map->_ghosts[1], map->_totalCount);
+    _YYLinkedMapIndex victim;
+    if (t1->count > 0 && (t1->count > map->_arcTarget || t2->count == 0)) {
+        victim = t1->tail;
+        _YYLinkedMapGhostAdd(&map->_ghosts[0], _YYLinkedMapGetNode(map, victim)->_hash);
+    } else if (t2->count > 0) {
+        victim = t2->tail;
+        _YYLinkedMapGhostAdd(&map->_ghosts[1], _YYLinkedMapGetNode(map, victim)->_hash);
+    } else {
+        victim = _YYLinkedMapNil;
+    }
+    return victim;
+}
+
+static const _YYLinkedMapPolicyCallBacks _YYARCPolicyCallBacks = {
+    _YYARCPolicyInsert, _YYARCPolicyHit, _YYLinkedMapPolicyUnlink, _YYARCPolicyVictim
+};
+
+/*
+ 2Q (full version): new keys enter A1in, a FIFO queue of 25% of the nodes. Keys
+ evicted from A1in are remembered in the ghost A1out (50% of the nodes), a new
+ key found in A1out enters Am, which is LRU. Hits in A1in don't promote, so a
+ burst of correlated accesses can't take Am.
+ */
+
+#define _YY2QA1in 0
+#define _YY2QAm 1
+
+static void _YY2QPolicyInsert(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    uint64_t hash = _YYLinkedMapGetNode(map, index)->_hash;
+    if (_YYLinkedMapGhostRemove(&map->_ghosts[0], hash)) {
+        _YYLinkedMapListInsertHead(map, index, _YY2QAm);
+    } else {
+        _YYLinkedMapListInsertHead(map, index, _YY2QA1in);
+    }
+}
+
+static void _YY2QPolicyHit(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    if (_YYLinkedMapGetLink(map, index)->_segment == _YY2QAm) [map bringNodeToHead:index];
 }
 
-/// Insert a node at head and update the total cost.
-/// Node and node.key should not be nil.
-// 添加节点到链表头节点
-- (void)insertNodeAtHead:(_YYLinkedMapNode *)node;
+static _YYLinkedMapIndex _YY2QPolicyVictim(_YYLinkedMap *map) {
+    _YYLinkedMapList *a1in = &map->_lists[_YY2QA1in], *am = &map->_lists[_YY2QAm];
+    _YYLinkedMapGhostReserve(&map->_ghosts[0], map->_totalCount / 2);
+    if (a1in->count > 0 && (a1in->count > MAX(map->_totalCount / 4, 1) || am->count == 0)) {
+        _YYLinkedMapGhostAdd(&map->_ghosts[0], _YYLinkedMapGetNode(map, a1in->tail)->_hash);
+        return a1in->tail;
+    }
+    return am->tail;
+}
 
-/// Bring a inner node to header.
-/// Node should already inside the dic.
-// 移动当前节点到链表头节点
-- (void)bringNodeToHead:(_YYLinkedMapNode *)node;
+static const _YYLinkedMapPolicyCallBacks _YY2QPolicyCallBacks = {
+    _YY2QPolicyInsert, _YY2QPolicyHit, _YYLinkedMapPolicyUnlink, _YY2QPolicyVictim
+};
 
-/// Remove a inner node and update the total cost.
-/// Node should already inside the dic.
-// 移除链表节点
-- (void)removeNode:(_YYLinkedMapNode *)node;
+/*
+ S3-FIFO: new keys enter the small FIFO queue (10% of the nodes), keys found in
+ the ghost enter the main FIFO queue. A hit only increases the node's frequency
+ (`_referenced`, at most 3). When evicting from small queue, accessed nodes move
+ to main queue, others are evicted and remembered in the ghost. When evicting 
+ from main queue, accessed nodes are reinserted with frequency decreased.
+ */
 
-/// Remove tail node if exist.
-// 移除链表尾节点(如果存在)
-- (_YYLinkedMapNode *)removeTailNode;
+#define _YYS3FIFOSmall 0
+#define _YYS3FIFOMain 1
 
-/// Remove all node in background queue.
-// 移除所有缓存
-- (void)removeAll;
+static void _YYS3FIFOPolicyInsert(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    uint64_t hash = _YYLinkedMapGetNode(map, index)->_hash;
+    if (_YYLinkedMapGhostRemove(&map->_ghosts[0], hash)) {
+        _YYLinkedMapListInsertHead(map, index, _YYS3FIFOMain);
+    } else {
+        _YYLinkedMapListInsertHead(map, index, _YYS3FIFOSmall);
+    }
+}
 
-@end
+static void _YYS3FIFOPolicyHit(_YYLinkedMap *map, _YYLinkedMapIndex index) {
+    _YYLinkedMapLink *link = _YYLinkedMapGetLink(map, index);
+    if (link->_referenced < 3) link->_referenced++;
+}
+
+static _YYLinkedMapIndex _YYS3FIFOPolicyVictim(_YYLinkedMap *map) {
+    _YYLinkedMapList *smallQueue = &map->_lists[_YYS3FIFOSmall], *mainQueue = &map->_lists[_YYS3FIFOMain];
+    _YYLinkedMapGhostReserve(&map->_ghosts[0], map->_totalCount);
+    NSUInteger smallLimit = MAX(map->_totalCount / 10, 1);
+    // 每次循环都会淘汰一个节点，或者使某个节点的频率降低，所以循环一定会结束
+    for (;;) {
+        if (smallQueue->count > 0 && (smallQueue->count > smallLimit || mainQueue->count == 0)) {
+            _YYLinkedMapLink *link = _YYLinkedMapGetLink(map, smallQueue->tail);
+            if (link->_referenced == 0) {
+                _YYLinkedMapGhostAdd(&map->_ghosts[0], _YYLinkedMapGetNode(map, smallQueue->tail)->_hash);
+                return smallQueue->tail;
+            }
+            link->_referenced = 0;
+            _YYLinkedMapListMoveToHead(map, smallQueue->tail, _YYS3FIFOMain);
+        } else if (mainQueue->count > 0) {
+            _YYLinkedMapLink *link = _YYLinkedMapGetLink(map, mainQueue->tail);
+            if (link->_referenced == 0) return mainQueue->tail;
+            link->_referenced--;
+            [map bringNodeToHead:mainQueue->tail];
+        } else {
+            return _YYLinkedMapNil;
+        }
+    }
+}
+
+static const _YYLinkedMapPolicyCallBacks _YYS3FIFOPolicyCallBacks = {
+    _YYS3FIFOPolicyInsert, _YYS3FIFOPolicyHit, _YYLinkedMapPolicyUnlink, _YYS3FIFOPolicyVictim
+};
+
+static const _YYLinkedMapPolicyCallBacks *_YYLinkedMapPolicyGetCallBacks(YYMemoryCacheEvictionPolicy policy) {
+    switch (policy) {
+        case YYMemoryCacheEvictionPolicyCLOCK: return &_YYCLOCKPolicyCallBacks;
+        case YYMemoryCacheEvictionPolicyTinyLFU: return &_YYTinyLFUPolicyCallBacks;
+        case YYMemoryCacheEvictionPolicyARC: return &_YYARCPolicyCallBacks;
+        case YYMemoryCacheEvictionPolicy2Q: return &_YY2QPolicyCallBacks;
+        case YYMemoryCacheEvictionPolicyS3FIFO: return &_YYS3FIFOPolicyCallBacks;
+        default: return &_YYLRUPolicyCallBacks; // LRU, BufferedLRU
+    }
+}
 
 
 @implementation _YYLinkedMap
 
-- (instancetype)init {
+- (instancetype)initWithTotals:(_YYLinkedMapTotals *)totals policy:(YYMemoryCacheEvictionPolicy)policy {
     self = [super init];
-    _dic = CFDictionaryCreateMutable(CFAllocatorGetDefault(), 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    _freeList = _YYLinkedMapNil;
+    for (NSUInteger i = 0; i < _YYLinkedMapSegmentCount; i++) {
+        _lists[i].head = _lists[i].tail = _YYLinkedMapNil;
+    }
     _releaseOnMainThread = NO;
     _releaseAsynchronously = YES;
+    _policy = policy;
+    _sharedRead = (policy == YYMemoryCacheEvictionPolicyCLOCK || policy == YYMemoryCacheEvictionPolicyBufferedLRU);
+    if (policy == YYMemoryCacheEvictionPolicyBufferedLRU) {
+        posix_memalign((void **)&_readBuffers, 64, _YYLinkedMapReadBufferStripes * sizeof(_YYLinkedMapReadBuffer));
+        memset(_readBuffers, 0, _YYLinkedMapReadBufferStripes * sizeof(_YYLinkedMapReadBuffer));
+    }
+    _callBacks = _YYLinkedMapPolicyGetCallBacks(policy);
+    _wheelStart = _YYMemoryCacheNow();
+    if (policy == YYMemoryCacheEvictionPolicyTinyLFU) _YYFrequencySketchEnsureCapacity(&_sketch, 0);
+    pthread_mutex_init(&_lock, NULL);
+    pthread_rwlock_init(&_rwlock, NULL);
+    _totals = totals;
     return self;
 }
 
 - (void)dealloc {
-    CFRelease(_dic);
+    _YYLinkedMapSlabsRelease(_slabs, _linkSlabs, _slabCount);
+    free(_ctrl);
+    free(_sketch.table);
+    free(_wheel);
+    for (NSUInteger i = 0; i < 2; i++) {
+        free(_ghosts[i].queue);
+        free(_ghosts[i].set);
+        free(_ghosts[i].latest);
+    }
+    free(_slots);
+    free(_readBuffers);
+    pthread_mutex_destroy(&_lock);
+    pthread_rwlock_destroy(&_rwlock);
+}
+
+/// Allocate a new slab and put all its nodes into free list.
+- (void)_growSlabs {
+    if (_slabCount == _slabCapacity) {
+        _slabCapacity = _slabCapacity ? _slabCapacity * 2 : 4;
+        _slabs = realloc(_slabs, _slabCapacity * sizeof(_YYLinkedMapNode *));
+        _linkSlabs = realloc(_linkSlabs, _slabCapacity * sizeof(_YYLinkedMapLink *));
+    }
+    _YYLinkedMapLink *links = calloc(_YYLinkedMapSlabSize, sizeof(_YYLinkedMapLink));
+    _YYLinkedMapIndex base = _slabCount << _YYLinkedMapSlabShift;
+    for (_YYLinkedMapIndex i = 0; i < _YYLinkedMapSlabSize; i++) {
+        links[i]._next = (i + 1 < _YYLinkedMapSlabSize) ? base + i + 1 : _freeList;
+    }
+    _linkSlabs[_slabCount] = links;
+    _slabs[_slabCount++] = calloc(_YYLinkedMapSlabSize, sizeof(_YYLinkedMapNode));
+    _freeList = base;
+}
+
+/// Put the node into the first empty or deleted slot of its probe sequence.
+/// The table should have enough space.
+- (void)_tableInsertNode:(_YYLinkedMapIndex)index {
+    _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+    NSUInteger groupMask = _tableCapacity / _YYLinkedMapGroupSize - 1;
+    NSUInteger group = (NSUInteger)(node->_hash >> 7) & groupMask;
+    for (NSUInteger step = 1; ; step++) {
+        uint64_t ctrl = _YYLinkedMapGroupLoad(_ctrl + group * _YYLinkedMapGroupSize);
+        uint64_t match = _YYLinkedMapGroupMatchEmptyOrDeleted(ctrl);
+        if (match) {
+            NSUInteger slot = group * _YYLinkedMapGroupSize + _YYLinkedMapGroupFirst(match);
+            if (_ctrl[slot] == _YYLinkedMapCtrlEmpty) _tableUsed++;
+            _ctrl[slot] = node->_hash & 0x7F;
+            _slots[slot] = index;
+            node->_slot = (uint32_t)slot;
+            return;
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+/// Rebuild the table with the capacity, all deleted slots are dropped.
+- (void)_tableResize:(NSUInteger)capacity {
+    uint8_t *oldCtrl = _ctrl;
+    _YYLinkedMapIndex *oldSlots = _slots;
+    NSUInteger oldCapacity = _tableCapacity;
+    
+    _ctrl = malloc(capacity);
+    memset(_ctrl, _YYLinkedMapCtrlEmpty, capacity);
+    _slots = malloc(capacity * sizeof(_YYLinkedMapIndex));
+    _tableCapacity = capacity;
+    _tableUsed = 0;
+    for (NSUInteger i = 0; i < oldCapacity; i++) {
+        if (oldCtrl[i] & 0x80) continue; // empty or deleted
+        [self _tableInsertNode:oldSlots[i]];
+    }
+    free(oldCtrl);
+    free(oldSlots);
+}
+
+/// Rebuild the table in place from the nodes in use, all deleted slots are dropped.
+- (void)_tableRehash {
+    memset(_ctrl, _YYLinkedMapCtrlEmpty, _tableCapacity);
+    _tableUsed = 0;
+    for (uint32_t i = 0; i < _slabCount; i++) {
+        _YYLinkedMapNode *slab = _slabs[i];
+        for (_YYLinkedMapIndex j = 0; j < _YYLinkedMapSlabSize; j++) {
+            if (slab[j]._value) [self _tableInsertNode:(i << _YYLinkedMapSlabShift) | j];
+        }
+    }
+}
+
+/// Make sure there's space for one more node, the load factor is at most 7/8.
+/// It should be called before the new node is taken from free list.
+- (void)_tableReserve {
+    if (_tableUsed + 1 <= _tableCapacity / 8 * 7) return;
+    if (_tableCapacity && _totalCount + 1 <= _tableCapacity / 16 * 7) {
+        [self _tableRehash]; // too many deleted slots
+    } else {
+        [self _tableResize:_tableCapacity ? _tableCapacity * 2 : 16];
+    }
+}
+
+/// Remove the node's slot from table.
+- (void)_tableEraseNode:(_YYLinkedMapNode *)node {
+    NSUInteger slot = node->_slot;
+    uint64_t ctrl = _YYLinkedMapGroupLoad(_ctrl + slot / _YYLinkedMapGroupSize * _YYLinkedMapGroupSize);
+    if (_YYLinkedMapGroupMatchEmpty(ctrl)) {
+        // no lookup can probe past this group, so the slot can be empty again
+        _ctrl[slot] = _YYLinkedMapCtrlEmpty;
+        _tableUsed--;
+    } else {
+        _ctrl[slot] = _YYLinkedMapCtrlDeleted;
+    }
 }
 
 //方法插入、替换、查找方法实现
 
 // 添加节点到链表头节点
-- (void)insertNodeAtHead:(_YYLinkedMapNode *)node {
-    // 字典保存链表节点node
-    CFDictionarySetValue(_dic, (__bridge const void *)(node->_key), (__bridge const void *)(node));
+- (_YYLinkedMapIndex)insertNodeAtHeadWithKey:(id)key hash:(uint64_t)hash value:(id)value cost:(NSUInteger)cost time:(NSTimeInterval)time {
+    // 哈希表预留空间 (重建哈希表时会遍历使用中的节点，所以要在取出新节点前调用)
+    [self _tableReserve];
+    // 从空闲链表取出一个节点
+    if (_freeList == _YYLinkedMapNil) [self _growSlabs];
+    _YYLinkedMapIndex index = _freeList;
+    _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+    _YYLinkedMapLink *link = _YYLinkedMapGetLink(self, index);
+    _freeList = link->_next;
+    
+    cost = _YYLinkedMapClampCost(cost);
+    node->_key = key ? CFBridgingRetain(key) : NULL;
+    node->_value = CFBridgingRetain(value);
+    node->_hash = hash;
+    node->_cost = (uint32_t)cost;
+    node->_expire = 0;
+    node->_refresh = 0;
+    node->_incompressible = 0;
+    link->_time = _YYLinkedMapTimeFromInterval(time);
+    link->_referenced = 0;
+    // 哈希表保存节点索引
+    [self _tableInsertNode:index];
     // 叠加该缓存开销到总内存开销
-    _totalCost += node->_cost;
+    _totalCost += cost;
     // 总缓存数+1
     _totalCount++;
-    if (_head) {
-        // 存在链表头，取代当前表头
-        node->_next = _head;
-        _head->_prev = node;
-        // 重新赋值链表表头临时变量_head
-        _head = node;
-    } else {
-        // 不存在链表头
-        _head = _tail = node;
-    }
+    atomic_fetch_add_explicit(&_totals->cost, cost, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_totals->count, 1, memory_order_relaxed);
+    
+    // 由淘汰策略把节点插入链表 (LRU: 插入到链表头)
+    _callBacks->didInsert(self, index);
+    return index;
 }
 
 // 移动当前节点到链表头节点
-- (void)bringNodeToHead:(_YYLinkedMapNode *)node {
+- (void)bringNodeToHead:(_YYLinkedMapIndex)index {
     
+    _YYLinkedMapLink *node = _YYLinkedMapGetLink(self, index);
+    _YYLinkedMapList *list = &_lists[node->_segment];
     // 当前节点已是链表头节点
-    if (_head == node) return;
+    if (list->head == index) return;
+    if (_cursors) _YYLinkedMapCursorsWillUnlink(self, index);
     
-    if (_tail == node) {
+    if (list->tail == index) {
         //**如果node是链表尾节点**
         
         // 把node指向的上一个节点赋值给链表尾节点
-        _tail = node->_prev;
+        list->tail = node->_prev;
         // 把链表尾节点指向的下一个节点赋值nil
-        _tail->_next = nil;
+        _YYLinkedMapGetLink(self, list->tail)->_next = _YYLinkedMapNil;
     } else {
         //**如果node是非链表尾节点和链表头节点**
         
         // 把node指向的上一个节点赋值給node指向的下一个节点node指向的上一个节点
-        node->_next->_prev = node->_prev;
+        _YYLinkedMapGetLink(self, node->_next)->_prev = node->_prev;
         // 把node指向的下一个节点赋值给node指向的上一个节点node指向的下一个节点
-        node->_prev->_next = node->_next;
+        _YYLinkedMapGetLink(self, node->_prev)->_next = node->_next;
     }
     // 把链表头节点赋值给node指向的下一个节点
-    node->_next = _head;
+    node->_next = list->head;
     // 把node指向的上一个节点赋值nil
-    node->_prev = nil;
+    node->_prev = _YYLinkedMapNil;
     // 把节点赋值给链表头节点的指向的上一个节点
-    _head->_prev = node;
-    _head = node;
+    _YYLinkedMapGetLink(self, list->head)->_prev = index;
+    list->head = index;
 }
 
 // 移除节点
-- (void)removeNode:(_YYLinkedMapNode *)node {
-    // 从字典中移除node
-    CFDictionaryRemoveValue(_dic, (__bridge const void *)(node->_key));
+- (_YYLinkedMapEntry)removeNode:(_YYLinkedMapIndex)index {
+    _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+    // 从哈希表中移除node
+    [self _tableEraseNode:node];
     // 减掉总内存消耗
     _totalCost -= node->_cost;
     // // 总缓存数-1
     _totalCount--;
+    atomic_fetch_sub_explicit(&_totals->cost, node->_cost, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&_totals->count, 1, memory_order_relaxed);
     
     // 重新连接链表
-    if (node->_next) node->_next->_prev = node->_prev;
-    if (node->_prev) node->_prev->_next = node->_next;
-    if (_head == node) _head = node->_next;
-    if (_tail == node) _tail = node->_prev;
+    _callBacks->willRemove(self, index);
+    if (node->_expire != 0) _YYTimerWheelUnlink(self, index);
+    
+    // 取出key/value交给调用者释放，节点放回空闲链表
+    _YYLinkedMapEntry entry = {node->_key, node->_value};
+    node->_generation++;
+    node->_key = NULL;
+    node->_value = NULL;
+    _YYLinkedMapLink *link = _YYLinkedMapGetLink(self, index);
+    link->_prev = _YYLinkedMapNil;
+    link->_next = _freeList;
+    _freeList = index;
+    return entry;
+}
+
+// 移除尾节点(如果存在)
+- (_YYLinkedMapEntry)removeTailNode {
+    if (_lists[0].tail == _YYLinkedMapNil) return (_YYLinkedMapEntry){NULL, NULL};
+    return [self removeNode:_lists[0].tail];
+}
+
+- (void)accessNode:(_YYLinkedMapIndex)index {
+    _callBacks->didHit(self, index);
+}
+
+- (_YYLinkedMapEntry)removeVictimNode {
+    _YYLinkedMapIndex victim = _callBacks->victim(self);
+    if (victim == _YYLinkedMapNil) return (_YYLinkedMapEntry){NULL, NULL};
+    return [self removeNode:victim];
+}
+
+- (void)drainReadBuffers {
+    for (NSUInteger i = 0; i < _YYLinkedMapReadBufferStripes; i++) {
+        _YYLinkedMapReadBuffer *buffer = _readBuffers + i;
+        // 写锁保证没有读线程在写入，所有记录都已完成
+        uint32_t write = atomic_load_explicit(&buffer->writeCount, memory_order_relaxed);
+        for (uint32_t read = buffer->readCount; read != write; read++) {
+            uint64_t record = atomic_load_explicit(&buffer->records[read & _YYLinkedMapReadBufferMask], memory_order_relaxed);
+            _YYLinkedMapIndex index = (_YYLinkedMapIndex)record;
+            // 节点在记录之后被移除(可能已被复用)，忽略
+            if (_YYLinkedMapGetNode(self, index)->_generation != (uint32_t)(record >> 32)) continue;
+            [self bringNodeToHead:index];
+        }
+        buffer->readCount = write;
+    }
+}
+
+- (_YYLinkedMapIndex)oldestNode {
+    _YYLinkedMapIndex oldest = _YYLinkedMapNil;
+    for (NSUInteger i = 0; i < _YYLinkedMapSegmentCount; i++) {
+        _YYLinkedMapIndex tail = _lists[i].tail;
+        if (tail == _YYLinkedMapNil) continue;
+        if (oldest == _YYLinkedMapNil || _YYLinkedMapGetLink(self, tail)->_time < _YYLinkedMapGetLink(self, oldest)->_time) {
+            oldest = tail;
+        }
+    }
+    return oldest;
+}
+
+- (void)setExpire:(NSTimeInterval)expire forNode:(_YYLinkedMapIndex)index {
+    _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+    if (node->_expire != 0) _YYTimerWheelUnlink(self, index);
+    node->_expire = expire;
+    if (expire == 0) return;
+    _YYTimerWheelReserve(self);
+    _YYTimerWheelInsert(self, index, MAX(_YYTimerWheelTickOfTime(self, expire), _wheelTick + 1));
+}
+
+- (void)removeExpiredNodes:(NSTimeInterval)now holder:(_YYLinkedMapHolder *)holder {
+    if (!_wheel || now <= _wheelStart) return;
+    uint64_t nowTick = (uint64_t)((now - _wheelStart) / _YYTimerWheelTick);
+    while (_wheelTick < nowTick) {
+        // 跳过没有节点的tick，长时间空闲后也不会逐秒推进
+        uint64_t tick = _timerCount ? _YYTimerWheelNextTick(self) : UINT64_MAX;
+        if (tick > nowTick) {
+            _wheelTick = nowTick;
+            break;
+        }
+        _wheelTick = tick;
+        // 从高层到低层，到达桶的起点时把桶内节点重新分配到低层，最后处理第0层的桶
+        for (NSInteger level = _YYTimerWheelLevels - 1; level >= 0; level--) {
+            if (tick & ((1ULL << (_YYTimerWheelBits * level)) - 1)) continue;
+            NSUInteger bucket = level * _YYTimerWheelSize + ((tick >> (_YYTimerWheelBits * level)) & (_YYTimerWheelSize - 1));
+            _YYLinkedMapIndex index;
+            while ((index = _wheel[bucket]) != _YYLinkedMapNil) {
+                _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+                if (node->_expire <= now) {
+                    _YYLinkedMapHolderAdd(holder, [self removeNode:index]);
+                } else {
+                    _YYTimerWheelUnlink(self, index);
+                    _YYTimerWheelInsert(self, index, MAX(_YYTimerWheelTickOfTime(self, node->_expire), tick + 1));
+                }
+            }
+        }
+    }
+}
+
+- (CFTypeRef)storeObject:(id)object forKey:(id)key hash:(uint64_t)hash cost:(NSUInteger)cost ttl:(NSTimeInterval)ttl refreshAfter:(NSTimeInterval)refreshAfter time:(NSTimeInterval)now evicted:(_YYLinkedMapEntry *)evicted {
+//    查找缓存
+    _YYLinkedMapIndex index = _YYLinkedMapFind(self, key, hash);
+    CFTypeRef oldValue = NULL;
+    if (index != _YYLinkedMapNil) {
+        //** 之前有缓存，更新旧缓存 **
+        
+        // 更新值，旧值在解锁后释放
+        [self setCost:cost forNode:index];
+        _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+        _YYLinkedMapLink *link = _YYLinkedMapGetLink(self, index);
+        link->_time = _YYLinkedMapTimeFromInterval(now);
+        oldValue = node->_value;
+        node->_value = CFBridgingRetain(object);
+        node->_incompressible = 0;
+        if (_policy == YYMemoryCacheEvictionPolicyCLOCK) {
+            link->_referenced = 1;
+        } else {
+            // 移动节点到链表表头
+            [self accessNode:index];
+        }
+    } else {
+        //** 之前未有缓存，添加新缓存 **
+        
+        // 固定容量已满时先淘汰一个节点，淘汰的节点在空闲链表头部，随后被新缓存复用
+        if (_capacity && _totalCount >= _capacity) *evicted = [self removeVictimNode];
+        // 从节点池取出节点并添加到表头，节点是slab中的C结构体，不需要为每个缓存创建OC对象
+        index = [self insertNodeAtHeadWithKey:key hash:hash value:object cost:cost time:now];
+    }
+    // 设置过期时间
+    if (ttl > 0 || _YYLinkedMapGetNode(self, index)->_expire != 0) {
+        [self setExpire:(ttl > 0 ? now + ttl : 0) forNode:index];
+    }
+    // 设置软过期时间
+    _YYLinkedMapGetNode(self, index)->_refresh = refreshAfter > 0 ? now + refreshAfter : 0;
+    return oldValue;
+}
+
+- (void)setCost:(NSUInteger)cost forNode:(_YYLinkedMapIndex)index {
+    _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+    cost = _YYLinkedMapClampCost(cost);
+    _totalCost -= node->_cost;
+    _totalCost += cost;
+    atomic_fetch_sub_explicit(&_totals->cost, node->_cost, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_totals->cost, cost, memory_order_relaxed);
+    node->_cost = (uint32_t)cost;
+}
+
+- (void)reserveCapacity:(NSUInteger)capacity {
+    _capacity = MIN(capacity, (NSUInteger)_YYLinkedMapNil);
+    if (_capacity == 0) return;
+    while (((NSUInteger)_slabCount << _YYLinkedMapSlabShift) < _capacity) [self _growSlabs];
+    // 节点数不超过哈希表的 7/16，删除标记过多时只会原地重建，不会扩容
+    NSUInteger tableCapacity = 16;
+    while (tableCapacity / 16 * 7 < _capacity) tableCapacity <<= 1;
+    if (tableCapacity > _tableCapacity) [self _tableResize:tableCapacity];
+    _YYTimerWheelReserve(self);
+    if (_policy == YYMemoryCacheEvictionPolicyTinyLFU) _YYFrequencySketchEnsureCapacity(&_sketch, _capacity);
+    if (_policy == YYMemoryCacheEvictionPolicyARC || _policy == YYMemoryCacheEvictionPolicy2Q || _policy == YYMemoryCacheEvictionPolicyS3FIFO) {
+        _YYLinkedMapGhostReserve(&_ghosts[0], _capacity);
+        _YYLinkedMapGhostReserve(&_ghosts[1], _capacity);
+    }
+}
+
+- (void)addCursor:(_YYLinkedMapCursor *)cursor {
+    cursor->segment = 0;
+    cursor->pending = YES;
+    cursor->index = _lists[0].head;
+    cursor->next = _cursors;
+    _cursors = cursor;
+}
+
+- (void)removeCursor:(_YYLinkedMapCursor *)cursor {
+    for (_YYLinkedMapCursor **p = &_cursors; *p; p = &(*p)->next) {
+        if (*p == cursor) {
+            *p = cursor->next;
+            break;
+        }
+    }
+}
+
+- (NSUInteger)copyEntriesFromCursor:(_YYLinkedMapCursor *)cursor entries:(_YYLinkedMapEntry *)entries hashes:(uint64_t *)hashes count:(NSUInteger)count time:(NSTimeInterval)now {
+    NSUInteger copied = 0;
+    while (copied < count && cursor->segment < _YYLinkedMapSegmentCount) {
+        _YYLinkedMapIndex index = cursor->pending ? cursor->index : _YYLinkedMapGetLink(self, cursor->index)->_next;
+        if (index == _YYLinkedMapNil) {
+            // 当前链表已遍历完，继续下一个链表
+            cursor->segment++;
+            cursor->pending = YES;
+            cursor->index = cursor->segment < _YYLinkedMapSegmentCount ? _lists[cursor->segment].head : _YYLinkedMapNil;
+            continue;
+        }
+        cursor->index = index;
+        cursor->pending = NO;
+        _YYLinkedMapNode *node = _YYLinkedMapGetNode(self, index);
+        if (_YYLinkedMapNodeExpired(node, now)) continue;
+        entries[copied].key = node->_key ? CFRetain(node->_key) : NULL;
+        entries[copied].value = CFRetain(node->_value);
+        hashes[copied] = node->_hash;
+        copied++;
+    }
+    return copied;
+}
+
+// 移除所有缓存
+- (void)removeAll {
+    if (_totalCount == 0) return;
+    // 清空内存开销与缓存数量
+    atomic_fetch_sub_explicit(&_totals->cost, _totalCost, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&_totals->count, _totalCount, memory_order_relaxed);
+    _totalCost = 0;
+    _totalCount = 0;
+    
+    // 拷贝一份节点池，整体交给指定的队列释放
+    _YYLinkedMapNode **slabs = _slabs;
+    _YYLinkedMapLink **linkSlabs = _linkSlabs;
+    uint32_t slabCount = _slabCount;
+    // 重新分配新的空间
+    _slabs = NULL;
+    _linkSlabs = NULL;
+    _slabCount = 0;
+    _slabCapacity = 0;
+    _freeList = _YYLinkedMapNil;
+    free(_ctrl);
+    free(_slots);
+    _ctrl = NULL;
+    _slots = NULL;
+    _tableCapacity = 0;
+    _tableUsed = 0;
+    // 清空头尾节点
+    for (NSUInteger i = 0; i < _YYLinkedMapSegmentCount; i++) {
+        _lists[i].head = _lists[i].tail = _YYLinkedMapNil;
+        _lists[i].count = 0;
+    }
+    // 节点已全部移除，结束进行中的遍历
+    for (_YYLinkedMapCursor *cursor = _cursors; cursor; cursor = cursor->next) {
+        cursor->segment = _YYLinkedMapSegmentCount;
+        cursor->pending = YES;
+        cursor->index = _YYLinkedMapNil;
+    }
+    if (_wheel) memset(_wheel, 0xFF, _YYTimerWheelLevels * _YYTimerWheelSize * sizeof(_YYLinkedMapIndex));
+    _timerCount = 0;
+    // 节点池已替换，丢弃读缓冲区中的记录
+    for (NSUInteger i = 0; _readBuffers && i < _YYLinkedMapReadBufferStripes; i++) {
+        _readBuffers[i].readCount = atomic_load_explicit(&_readBuffers[i].writeCount, memory_order_relaxed);
+    }
+    
+    if (_releaseAsynchronously) {
+        // 异步释放缓存
+        dispatch_queue_t queue = _releaseOnMainThread ? dispatch_get_main_queue() : YYMemoryCacheGetReleaseQueue();
+        dispatch_async(queue, ^{
+            _YYLinkedMapSlabsRelease(slabs, linkSlabs, slabCount); // hold and release in specified queue
+        });
+    } else if (_releaseOnMainThread && !pthread_main_np()) {
+        // 主线程上释放缓存
+        dispatch_async(dispatch_get_main_queue(), ^{
+            _YYLinkedMapSlabsRelease(slabs, linkSlabs, slabCount); // hold and release in specified queue
+        });
+    } else {
+        // 同步释放缓存
+        _YYLinkedMapSlabsRelease(slabs, linkSlabs, slabCount);
+    }
+    // 固定容量的节点池和哈希表已交给其它队列释放，重新分配
+    if (_capacity) [self reserveCapacity:_capacity];
+}
+
+@end
+
+
+/// Release the key-value pair in the queue specified by the map's release options.
+static inline void _YYLinkedMapReleaseEntry(_YYLinkedMap *lru, _YYLinkedMapEntry entry) {
+    if (!entry.value) return;
+    CFTypeRef key = entry.key, value = entry.value;
+    if (lru->_releaseAsynchronously && !lru->_releaseOnMainThread) {
+        _YYReclaimerRelease(entry); // release in reclaimer thread, no block or GCD enqueue
+    } else if (lru->_releaseAsynchronously) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (key) CFRelease(key); // release in queue
+            CFRelease(value);
+        });
+    } else if (lru->_releaseOnMainThread && !pthread_main_np()) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (key) CFRelease(key); // release in queue
+            CFRelease(value);
+        });
+    } else {
+        if (key) CFRelease(key);
+        CFRelease(value);
+    }
+}
+
+/// The max number of objects evicted by a write, so a write (even with a large
+/// cost) doesn't stall for long. As each write adds one object, the cache still
+/// converges to its limits, and the automatic trim evicts the rest.
+#define _YYMemoryCacheMaxEvictionsPerWrite 8
+
+/// The max number of objects evicted while holding a shard's lock.
+#define _YYMemoryCacheEvictionBatch 32
+
+/// The max number of entries copied in one lock hold by the enumeration.
+#define _YYMemoryCacheEnumerationBatch 64
+
+/// Returns the shard for the key's hash. `shift` is 64 - log2(shard count).
+static inline _YYLinkedMap *_YYLinkedMapShardForHash(__unsafe_unretained _YYLinkedMap **shards, NSUInteger shift, uint64_t hash) {
+    if (shift >= 64) return shards[0];
+    return shards[hash >> shift];
+}
+
+/**
+ The keys of a batch grouped by shard (counting sort), so a batch locks each
+ shard once. Keys of shard `i` are `keys[order[j]]` for j in [bounds[i], bounds[i + 1]).
+ */
+typedef struct {
+    __unsafe_unretained id *keys;
+    uint64_t *hashes; ///< hash of keys[i]
+    NSUInteger *order;
+    NSUInteger *bounds; ///< shard count + 1
+} _YYMemoryCacheBatch;
+
+static _YYMemoryCacheBatch _YYMemoryCacheBatchCreate(NSArray *keys, NSUInteger shardCount, NSUInteger shift) {
+    NSUInteger count = keys.count;
+    _YYMemoryCacheBatch batch;
+    batch.keys = (__unsafe_unretained id *)malloc(count * sizeof(id));
+    batch.hashes = malloc(count * sizeof(uint64_t));
+    batch.order = malloc(count * sizeof(NSUInteger));
+    batch.bounds = calloc(shardCount + 1, sizeof(NSUInteger));
+    [keys getObjects:batch.keys range:NSMakeRange(0, count)];
+    for (NSUInteger i = 0; i < count; i++) {
+        batch.hashes[i] = _YYMemoryCacheHash(batch.keys[i]);
+        batch.bounds[(shift >= 64 ? 0 : batch.hashes[i] >> shift) + 1]++;
+    }
+    for (NSUInteger i = 0; i < shardCount; i++) batch.bounds[i + 1] += batch.bounds[i];
+    // bounds[i] 作为分片i的写入位置，写完后 bounds[i] 变成 分片i+1 的起点，再整体后移
+    for (NSUInteger i = 0; i < count; i++) {
+        NSUInteger shard = shift >= 64 ? 0 : batch.hashes[i] >> shift;
+        batch.order[batch.bounds[shard]++] = i;
+    }
+    memmove(batch.bounds + 1, batch.bounds, shardCount * sizeof(NSUInteger));
+    batch.bounds[0] = 0;
+    return batch;
+}
+
+static void _YYMemoryCacheBatchFree(_YYMemoryCacheBatch batch) {
+    free(batch.keys);
+    free(batch.hashes);
+    free(batch.order);
+    free(batch.bounds);
+}
+
+#pragma mark - Slab store
+
+/*
+ Slab store: the NSData values set by `setData:forKey:` are copied into chunks of
+ slab classes (like memcached). The chunk sizes grow by 1.25x from 64 bytes to
+ half a page, and a page is a 1MB arena carved into chunks of one class. A freed
+ chunk goes back to the free list of its page, and a page is freed as soon as
+ all of its chunks are free (except the last page of the class). So the payloads
+ don't fragment the malloc heap, and the memory is returned to system when the
+ cache shrinks. The cost of a value is the size of its chunk.
+ 
+ A value is a `_YYSlabData` pointing to its chunk, the chunk is freed when the
+ value is deallocated. The value retains the allocator, it may outlive the cache.
+ */
+
+#define _YYSlabPageSize (1 << 20)
+#define _YYSlabMinChunkSize 64
+#define _YYSlabMaxChunkSize (_YYSlabPageSize / 2)
+#define _YYSlabClassMax 64
+
+typedef struct _YYSlabPage {
+    uint8_t *base;
+    void *freeList;       // freed chunks, linked by their first word
+    uint32_t carved;      // chunks carved from base, the rest of the page is not touched yet
+    uint32_t used;        // chunks in use
+    uint32_t capacity;    // chunks in this page
+    uint8_t classIndex;
+    BOOL partial;         // in the partial list of its class
+    struct _YYSlabPage *prev, *next; // partial list
+} _YYSlabPage;
+
+typedef struct {
+    uint32_t chunkSize;
+    uint32_t pageCount;
+    _YYSlabPage *partial; // pages which have free chunks, head is used first
+    _YYSlabPage *partialTail;
+} _YYSlabClass;
+
+static void _YYSlabClassPushFront(_YYSlabClass *cls, _YYSlabPage *page) {
+    page->prev = NULL;
+    page->next = cls->partial;
+    if (cls->partial) cls->partial->prev = page;
+    else cls->partialTail = page;
+    cls->partial = page;
+    page->partial = YES;
+}
+
+static void _YYSlabClassPushBack(_YYSlabClass *cls, _YYSlabPage *page) {
+    page->next = NULL;
+    page->prev = cls->partialTail;
+    if (cls->partialTail) cls->partialTail->next = page;
+    else cls->partial = page;
+    cls->partialTail = page;
+    page->partial = YES;
+}
+
+static void _YYSlabClassRemove(_YYSlabClass *cls, _YYSlabPage *page) {
+    if (page->prev) page->prev->next = page->next;
+    else cls->partial = page->next;
+    if (page->next) page->next->prev = page->prev;
+    else cls->partialTail = page->prev;
+    page->prev = page->next = NULL;
+    page->partial = NO;
+}
+
+@interface _YYSlabAllocator : NSObject {
+    @package
+    pthread_mutex_t _lock;
+    _YYSlabClass _classes[_YYSlabClassMax];
+    NSUInteger _classCount;
+    _Atomic(NSUInteger) _pageBytes;
+}
+/// Returns a slab-backed copy of data and the chunk size as cost, or nil if the
+/// data is larger than `_YYSlabMaxChunkSize`.
+- (NSData *)copyData:(NSData *)data cost:(NSUInteger *)cost;
+/// Returns a slab-backed data whose bytes are not initialized, as `copyData:cost:`.
+- (NSData *)dataWithLength:(NSUInteger)length cost:(NSUInteger *)cost;
+- (void)freeChunk:(void *)chunk page:(_YYSlabPage *)page;
+@end
+
+@interface _YYSlabData : NSData {
+    @package
+    _YYSlabAllocator *_allocator;
+    _YYSlabPage *_page;
+    void *_bytes;
+    NSUInteger _length;
+}
+@end
+
+@implementation _YYSlabData
+
+- (instancetype)initWithAllocator:(_YYSlabAllocator *)allocator page:(_YYSlabPage *)page bytes:(void *)bytes length:(NSUInteger)length {
+    self = [super init];
+    _allocator = allocator;
+    _page = page;
+    _bytes = bytes;
+    _length = length;
+    return self;
+}
+
+- (void)dealloc {
+    [_allocator freeChunk:_bytes page:_page];
+}
+
+- (NSUInteger)length {
+    return _length;
+}
+
+- (const void *)bytes {
+    return _bytes;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    return self; // immutable
+}
+
+- (Class)classForCoder {
+    return [NSData class];
+}
+
+@end
+
+@implementation _YYSlabAllocator
+
+- (instancetype)init {
+    self = [super init];
+    pthread_mutex_init(&_lock, NULL);
+    NSUInteger size = _YYSlabMinChunkSize;
+    while (_classCount < _YYSlabClassMax) {
+        _classes[_classCount++].chunkSize = (uint32_t)MIN(size, _YYSlabMaxChunkSize);
+        if (size >= _YYSlabMaxChunkSize) break;
+        size = (size * 5 / 4 + 15) & ~(NSUInteger)15;
+    }
+    atomic_init(&_pageBytes, 0);
+    return self;
+}
+
+- (void)dealloc {
+    // 所有值都已释放，剩下的页都在空闲链表中
+    for (NSUInteger i = 0; i < _classCount; i++) {
+        for (_YYSlabPage *page = _classes[i].partial, *next; page; page = next) {
+            next = page->next;
+            free(page->base);
+            free(page);
+        }
+    }
+    pthread_mutex_destroy(&_lock);
+}
+
+- (NSData *)copyData:(NSData *)data cost:(NSUInteger *)cost {
+    NSUInteger length = data.length;
+    _YYSlabData *copy = (_YYSlabData *)[self dataWithLength:length cost:cost];
+    if (copy && length) memcpy(copy->_bytes, data.bytes, length);
+    return copy;
+}
+
+- (NSData *)dataWithLength:(NSUInteger)length cost:(NSUInteger *)cost {
+    if (length > _YYSlabMaxChunkSize) return nil;
+    // 找到能容纳数据的最小的slab class
+    NSUInteger low = 0, high = _classCount - 1;
+    while (low < high) {
+        NSUInteger mid = (low + high) / 2;
+        if (_classes[mid].chunkSize < length) low = mid + 1;
+        else high = mid;
+    }
+    _YYSlabClass *cls = _classes + low;
+    
+    pthread_mutex_lock(&_lock);
+    _YYSlabPage *page = cls->partial;
+    if (!page) {
+        page = calloc(1, sizeof(_YYSlabPage));
+        page->base = page ? malloc(_YYSlabPageSize) : NULL;
+        if (!page || !page->base) {
+            free(page);
+            pthread_mutex_unlock(&_lock);
+            return nil;
+        }
+        page->capacity = _YYSlabPageSize / cls->chunkSize;
+        page->classIndex = (uint8_t)low;
+        cls->pageCount++;
+        atomic_fetch_add_explicit(&_pageBytes, _YYSlabPageSize, memory_order_relaxed);
+        _YYSlabClassPushFront(cls, page);
+    }
+    void *chunk;
+    if (page->freeList) {
+        chunk = page->freeList;
+        page->freeList = *(void **)chunk;
+    } else {
+        chunk = page->base + (size_t)page->carved++ * cls->chunkSize;
+    }
+    page->used++;
+    if (page->used == page->capacity) _YYSlabClassRemove(cls, page);
+    pthread_mutex_unlock(&_lock);
+    
+    *cost = cls->chunkSize;
+    return [[_YYSlabData alloc] initWithAllocator:self page:page bytes:chunk length:length];
+}
+
+- (void)freeChunk:(void *)chunk page:(_YYSlabPage *)page {
+    _YYSlabClass *cls = _classes + page->classIndex;
+    pthread_mutex_lock(&_lock);
+    *(void **)chunk = page->freeList;
+    page->freeList = chunk;
+    page->used--;
+    // 从满变为有空闲：放到链表尾部，优先填满前面的页，让空闲多的页更容易被整页释放
+    if (!page->partial) _YYSlabClassPushBack(cls, page);
+    if (page->used == 0 && cls->pageCount > 1) {
+        _YYSlabClassRemove(cls, page);
+        cls->pageCount--;
+        atomic_fetch_sub_explicit(&_pageBytes, _YYSlabPageSize, memory_order_relaxed);
+        free(page->base);
+        free(page);
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+@end
+
+#pragma mark - Cold compression
+
+/*
+ Cold compression: with `compressesColdData`, the automatic trim compresses the
+ NSData values in the colder half of each list with LZ4 (block format, see
+ https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md). The node keeps a
+ `_YYCompressedData` instead of the data, and the data is decompressed and put
+ back by the next hit. The codec is implemented here as the system LZ4
+ (libcompression) requires iOS 9.
+ */
+
+#define _YYLZ4HashBits 12
+#define _YYLZ4MinMatch 4
+#define _YYLZ4LastLiterals 5
+#define _YYLZ4MatchLimit 12
+#define _YYLZ4MaxOffset 65535
+
+static inline uint32_t _YYLZ4Read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t _YYLZ4Hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - _YYLZ4HashBits);
+}
+
+/// Writes a length >= 15 after its token, the caller has checked the space.
+static inline uint8_t *_YYLZ4WriteLength(uint8_t *op, NSUInteger length) {
+    for (length -= 15; length >= 255; length -= 255) *op++ = 255;
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+/// Reads a length after its token, returns NO if the input is truncated.
+static inline BOOL _YYLZ4ReadLength(const uint8_t **ip, const uint8_t *iend, NSUInteger *length) {
+    uint8_t byte;
+    do {
+        if (*ip >= iend) return NO;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return YES;
+}
+
+NSUInteger _YYLZ4Compress(const uint8_t *src, NSUInteger length, uint8_t *dst, NSUInteger capacity) {
+    uint32_t table[1 << _YYLZ4HashBits];
+    memset(table, 0, sizeof(table));
+    const uint8_t *ip = src, *anchor = src, *end = src + length;
+    uint8_t *op = dst, *oend = dst + capacity;
+    if (length > _YYLZ4MatchLimit) {
+        const uint8_t *matchLimit = end - _YYLZ4MatchLimit; // a match starts before it
+        const uint8_t *matchEnd = end - _YYLZ4LastLiterals; // and ends before it
+        NSUInteger misses = 0;
+        ip++;
+        while (ip < matchLimit) {
+            uint32_t sequence = _YYLZ4Read32(ip);
+            uint32_t hash = _YYLZ4Hash(sequence);
+            const uint8_t *ref = src + table[hash];
+            table[hash] = (uint32_t)(ip - src);
+            if (ref >= ip || ip - ref > _YYLZ4MaxOffset || _YYLZ4Read32(ref) != sequence) {
+                // 连续未命中时加大步长，不可压缩的数据很快跳过
+                ip += (misses++ >> 6) + 1;
+                continue;
+            }
+            misses = 0;
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t *mp = ip + _YYLZ4MinMatch, *rp = ref + _YYLZ4MinMatch;
+            while (mp < matchEnd && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+            NSUInteger literals = ip - anchor, matchLength = mp - ip - _YYLZ4MinMatch;
+            if ((NSUInteger)(oend - op) < 1 + literals / 255 + 1 + literals + 2 + matchLength / 255 + 1) return 0;
+            uint8_t *token = op++;
+            *token = (uint8_t)(MIN(literals, 15) << 4 | MIN(matchLength, 15));
+            if (literals >= 15) op = _YYLZ4WriteLength(op, literals);
+            memcpy(op, anchor, literals);
+            op += literals;
+            NSUInteger offset = ip - ref;
+            *op++ = (uint8_t)offset;
+            *op++ = (uint8_t)(offset >> 8);
+            if (matchLength >= 15) op = _YYLZ4WriteLength(op, matchLength);
+            ip = anchor = mp;
+        }
+    }
+    NSUInteger literals = end - anchor;
+    if ((NSUInteger)(oend - op) < 1 + literals / 255 + 1 + literals) return 0;
+    *op++ = (uint8_t)(MIN(literals, 15) << 4);
+    if (literals >= 15) op = _YYLZ4WriteLength(op, literals);
+    memcpy(op, anchor, literals);
+    op += literals;
+    return op - dst;
+}
+
+BOOL _YYLZ4Decompress(const uint8_t *src, NSUInteger srcLength, uint8_t *dst, NSUInteger length) {
+    const uint8_t *ip = src, *iend = src + srcLength;
+    uint8_t *op = dst, *oend = dst + length;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        NSUInteger literals = token >> 4;
+        if (literals == 15 && !_YYLZ4ReadLength(&ip, iend, &literals)) return NO;
+        if (literals > (NSUInteger)(iend - ip) || literals > (NSUInteger)(oend - op)) return NO;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == iend) break; // the last sequence has no match
+        if (iend - ip < 2) return NO;
+        NSUInteger offset = ip[0] | (NSUInteger)ip[1] << 8;
+        ip += 2;
+        NSUInteger matchLength = token & 15;
+        if (matchLength == 15 && !_YYLZ4ReadLength(&ip, iend, &matchLength)) return NO;
+        matchLength += _YYLZ4MinMatch;
+        if (offset == 0 || offset > (NSUInteger)(op - dst) || matchLength > (NSUInteger)(oend - op)) return NO;
+        const uint8_t *ref = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, ref, matchLength);
+            op += matchLength;
+        } else {
+            // 重叠的匹配 (如连续重复的字节) 需要逐字节复制
+            for (NSUInteger i = 0; i < matchLength; i++) *op++ = *ref++;
+        }
+    }
+    return op == oend;
+}
+
+/// The min length of a data to be compressed.
+#define _YYMemoryCacheCompressMinLength 256
+
+/// A compressed value in a node, it's never returned to the caller.
+@interface _YYCompressedData : NSObject {
+    @package
+    uint8_t *_bytes;
+    NSUInteger _compressedLength;
+    NSUInteger _length; // length of the original data
+    uint32_t _cost;     // cost of the original data
+    _YYSlabAllocator *_allocator; // the original data is a `_YYSlabData` of it
+}
+@end
+
+@implementation _YYCompressedData
+
+- (void)dealloc {
+    free(_bytes);
 }
-// 移除尾节点(如果存在)
-- (_YYLinkedMapNode *)removeTailNode {
-    if (!_tail) return nil;
-    // 拷贝一份要删除的尾节点指针
-    _YYLinkedMapNode *tail = _tail;
-    // 移除链表尾节点
-    CFDictionaryRemoveValue(_dic, (__bridge const void *)(_tail->_key));
-    // 减掉总内存消耗
-    _totalCost -= _tail->_cost;
-    // 总缓存数-1
-    _totalCount--;
-    if (_head == _tail) {
-        // 清除节点，链表上已无节点了
-        _head = _tail = nil;
-    } else {
-        // 设倒数第二个节点为链表尾节点
-        _tail = _tail->_prev;
-        _tail->_next = nil;
-    }
-    // 返回完tail后_tail将会释放
-    return tail;
+
+@end
+
+_YYCompressedData *_YYCompressedDataCreate(uint8_t *bytes, NSUInteger compressedLength, NSUInteger length) {
+    _YYCompressedData *compressed = [_YYCompressedData new];
+    compressed->_bytes = bytes;
+    compressed->_compressedLength = compressedLength;
+    compressed->_length = length;
+    return compressed;
 }
 
-// 移除所有缓存
-- (void)removeAll {
-    // 清空内存开销与缓存数量
-    _totalCost = 0;
-    _totalCount = 0;
-    // 清空头尾节点
-    _head = nil;
-    _tail = nil;
-    
-    if (CFDictionaryGetCount(_dic) > 0) {
-        // 拷贝一份字典
-        CFMutableDictionaryRef holder = _dic;
-        // 重新分配新的空间
-        _dic = CFDictionaryCreateMutable(CFAllocatorGetDefault(), 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
-        
-        if (_releaseAsynchronously) {
-            // 异步释放缓存
-            dispatch_queue_t queue = _releaseOnMainThread ? dispatch_get_main_queue() : YYMemoryCacheGetReleaseQueue();
-            dispatch_async(queue, ^{
-                CFRelease(holder); // hold and release in specified queue
-            });
-        } else if (_releaseOnMainThread && !pthread_main_np()) {
-            // 主线程上释放缓存
-            dispatch_async(dispatch_get_main_queue(), ^{
-                CFRelease(holder); // hold and release in specified queue
-            });
-        } else {
-            // 同步释放缓存
-            CFRelease(holder);
+/// The data is decompressed into a slab chunk if the original data came from 
+/// the slab store.
+NSData *_YYCompressedDataInflate(_YYCompressedData *compressed) {
+    if (compressed->_allocator) {
+        NSUInteger cost = 0;
+        _YYSlabData *data = (_YYSlabData *)[compressed->_allocator dataWithLength:compressed->_length cost:&cost];
+        if (data) {
+            // 解压失败时data释放，chunk归还给slab
+            if (!_YYLZ4Decompress(compressed->_bytes, compressed->_compressedLength, data->_bytes, compressed->_length)) return nil;
+            return data;
         }
+        // 没有内存分配新的slab页时，退回到malloc
+    }
+    uint8_t *bytes = malloc(compressed->_length);
+    if (!bytes) return nil;
+    if (!_YYLZ4Decompress(compressed->_bytes, compressed->_compressedLength, bytes, compressed->_length)) {
+        free(bytes);
+        return nil;
     }
+    return [NSData dataWithBytesNoCopy:bytes length:compressed->_length freeWhenDone:YES];
 }
 
-@end
+/// A value to be compressed out of the lock.
+typedef struct {
+    _YYLinkedMapIndex index;
+    uint32_t generation;
+    CFTypeRef value; // retained
+} _YYMemoryCacheColdEntry;
+
+/// The statistics counters, see `YYMemoryCacheStatistics`.
+typedef enum {
+    _YYMemoryCacheStatHit = 0,
+    _YYMemoryCacheStatMiss,
+    _YYMemoryCacheStatInsert,
+    _YYMemoryCacheStatUpdate,
+    _YYMemoryCacheStatEvictCost,
+    _YYMemoryCacheStatEvictCount,
+    _YYMemoryCacheStatEvictAge,
+    _YYMemoryCacheStatRemove,
+    _YYMemoryCacheStatMax,
+} _YYMemoryCacheStat;
 
+/// A thread adds to the stripe selected by its pthread_self (like the read
+/// buffers), so the counters are rarely contended (readers of a shared lock
+/// don't write a common cache line). They're summed on read.
+#define _YYMemoryCacheStatStripeCount 16
 
+typedef struct {
+    _Atomic(uint64_t) counters[_YYMemoryCacheStatMax];
+} __attribute__((aligned(128))) _YYMemoryCacheStatStripe;
+
+static inline void _YYMemoryCacheStatAdd(_YYMemoryCacheStatStripe *stripes, _YYMemoryCacheStat stat, uint64_t n) {
+    if (n == 0) return;
+    NSUInteger index = _YYMemoryCacheHashMix((uintptr_t)pthread_self()) & (_YYMemoryCacheStatStripeCount - 1);
+    atomic_fetch_add_explicit(&stripes[index].counters[stat], n, memory_order_relaxed);
+}
+
+/// Records the key to the tracker if it's not nil, an integer key is recorded as NSNumber.
+static inline void _YYMemoryCacheRecordHotKey(__unsafe_unretained YYCacheHotKeyTracker *tracker, __unsafe_unretained id key, uint64_t hash) {
+    if (tracker) [tracker recordKey:key ?: @(_YYMemoryCacheIntegerKey(hash))];
+}
+
+/// Posted by the shared memory pressure source, the level is in userInfo.
+static NSString *const _YYMemoryCachePressureNotification = @"com.ibireme.cache.memory.pressure";
+static NSString *const _YYMemoryCachePressureLevelKey = @"level";
+
+/// The system memory pressure (warn / critical) is delivered by a dispatch source
+/// (iOS 8+), so the caches shed memory progressively before the app receives a
+/// memory warning. One source is shared by the process and fans out to the live
+/// caches with a notification; on older systems only the memory warning is used.
+static void _YYMemoryCacheStartPressureSource(void) {
+    static dispatch_source_t source;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        if (kCFCoreFoundationVersionNumber < kCFCoreFoundationVersionNumber_iOS_8_0) return;
+        dispatch_queue_t queue = dispatch_queue_create("com.ibireme.cache.memory.pressure", DISPATCH_QUEUE_SERIAL);
+        source = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0, DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL, queue);
+        if (!source) return;
+        dispatch_source_set_event_handler(source, ^{
+            unsigned long pressure = dispatch_source_get_data(source);
+            YYMemoryCachePressureLevel level;
+            if (pressure & DISPATCH_MEMORYPRESSURE_CRITICAL) level = YYMemoryCachePressureLevelCritical;
+            else if (pressure & DISPATCH_MEMORYPRESSURE_WARN) level = YYMemoryCachePressureLevelWarning;
+            else return;
+            [[NSNotificationCenter defaultCenter] postNotificationName:_YYMemoryCachePressureNotification object:nil userInfo:@{_YYMemoryCachePressureLevelKey : @(level)}];
+        });
+        dispatch_resume(source);
+    });
+}
 
 @implementation YYMemoryCache {
-    pthread_mutex_t _lock;
-    _YYLinkedMap *_lru;
+    _YYLinkedMapTotals _totals;
+    YYMemoryCacheEvictionPolicy _evictionPolicy;
+    NSArray *_shardHolder; // retains the shards
+    __unsafe_unretained _YYLinkedMap **_shards;
+    NSUInteger _shardCount;
+    NSUInteger _shardShift; // 64 - log2(_shardCount), the high bits of hash select a shard
     dispatch_queue_t _queue;
+    NSTimeInterval _pressureTime[3]; // last trim time of each pressure level
+    _YYMemoryCacheStatStripe *_stats; // _YYMemoryCacheStatStripeCount stripes
+    NSUInteger _capacity;
+    _YYSlabAllocator *_slabAllocator; // values of `setData:forKey:`
+    BOOL _hasCompressedData; // set once a value is compressed, see `compressesColdData`
 }
 
 //当我们初始化一个MemoryCache实例之后，这个实例就会自创建成功后递归调用- (void)_trimRecursively
@@ -267,117 +2334,313 @@ static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
 
 - (void)_trimInBackground {
     dispatch_async(_queue, ^{
+        YYCacheLatencyRecorder *recorder = self->_latencyRecorder;
+        uint64_t begin = recorder ? mach_absolute_time() : 0;
         [self _trimToCost:self->_costLimit];
+        begin = [recorder recordOperation:YYCacheOperationMemoryTrim beginTime:begin];
         [self _trimToCount:self->_countLimit];
+        begin = [recorder recordOperation:YYCacheOperationMemoryTrim beginTime:begin];
         [self _trimToAge:self->_ageLimit];
+        begin = [recorder recordOperation:YYCacheOperationMemoryTrim beginTime:begin];
+        [self _trimExpired];
+        [recorder recordOperation:YYCacheOperationMemoryTrim beginTime:begin];
+        if (self->_compressesColdData) [self _compressColdData];
     });
 }
 
+/**
+ Compress the NSData values in the colder half of each list (from tail). Nodes
+ are collected with the lock held for at most `_YYMemoryCacheEvictionBatch` nodes,
+ the values are compressed without lock, and then put into the nodes which still
+ hold the same values. The cost of a node is scaled by the compression ratio.
+ */
+- (void)_compressColdData {
+    _YYMemoryCacheColdEntry entries[_YYMemoryCacheEvictionBatch];
+    _YYCompressedData *compressed[_YYMemoryCacheEvictionBatch];
+    _YYLinkedMapHolder holder = {0}; // replaced data
+    Class dataClass = [NSData class], slabDataClass = [_YYSlabData class];
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        for (uint8_t segment = 0; segment < _YYLinkedMapSegmentCount; segment++) {
+            NSUInteger visited = 0, limit = 0;
+            _YYLinkedMapIndex last = _YYLinkedMapNil;
+            uint32_t lastGeneration = 0;
+            BOOL finish = NO;
+            while (!finish) {
+                NSUInteger count = 0;
+                _YYLinkedMapLockForReading(lru);
+                _YYLinkedMapIndex index;
+                if (last == _YYLinkedMapNil) {
+                    limit = lru->_lists[segment].count / 2;
+                    index = lru->_lists[segment].tail;
+                } else {
+                    // 从上一批最后的节点继续，节点已被移除或移到其它链表时结束本次压缩
+                    _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, last);
+                    _YYLinkedMapLink *link = _YYLinkedMapGetLink(lru, last);
+                    BOOL valid = node->_value && node->_generation == lastGeneration && link->_segment == segment;
+                    index = valid ? link->_prev : _YYLinkedMapNil;
+                }
+                for (NSUInteger n = 0; n < _YYMemoryCacheEvictionBatch && index != _YYLinkedMapNil && visited < limit; n++) {
+                    _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, index);
+                    id value = (__bridge id)node->_value;
+                    if (!node->_incompressible && [value isKindOfClass:dataClass] && [(NSData *)value length] >= _YYMemoryCacheCompressMinLength) {
+                        entries[count++] = (_YYMemoryCacheColdEntry){index, node->_generation, CFRetain(node->_value)};
+                    }
+                    last = index;
+                    lastGeneration = node->_generation;
+                    visited++;
+                    index = _YYLinkedMapGetLink(lru, index)->_prev;
+                }
+                finish = index == _YYLinkedMapNil || visited >= limit;
+                _YYLinkedMapUnlock(lru);
+                if (count == 0) continue;
+                
+                // 在锁外压缩，压缩后至少小1/8才保存
+                for (NSUInteger n = 0; n < count; n++) {
+                    NSData *data = (__bridge NSData *)entries[n].value;
+                    NSUInteger length = data.length, capacity = length - length / 8;
+                    uint8_t *bytes = malloc(capacity);
+                    NSUInteger compressedLength = bytes ? _YYLZ4Compress(data.bytes, length, bytes, capacity) : 0;
+                    if (compressedLength) {
+                        compressed[n] = _YYCompressedDataCreate(realloc(bytes, compressedLength) ?: bytes, compressedLength, length);
+                        // 解压时放回slab，保持 `setData:forKey:` 的值在slab中
+                        if ([data class] == slabDataClass) compressed[n]->_allocator = ((_YYSlabData *)data)->_allocator;
+                    } else {
+                        compressed[n] = nil;
+                        free(bytes);
+                    }
+                }
+                _YYLinkedMapLock(lru);
+                for (NSUInteger n = 0; n < count; n++) {
+                    _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, entries[n].index);
+                    if (node->_generation == entries[n].generation && node->_value == entries[n].value) {
+                        if (compressed[n]) {
+                            _YYCompressedData *value = compressed[n];
+                            value->_cost = node->_cost;
+                            _YYLinkedMapHolderAdd(&holder, (_YYLinkedMapEntry){NULL, node->_value});
+                            node->_value = CFBridgingRetain(value);
+                            [lru setCost:(NSUInteger)((uint64_t)node->_cost * value->_compressedLength / value->_length) forNode:entries[n].index];
+                            _hasCompressedData = YES;
+                        } else {
+                            node->_incompressible = 1;
+                        }
+                    }
+                    _YYLinkedMapHolderAdd(&holder, (_YYLinkedMapEntry){NULL, entries[n].value});
+                    compressed[n] = nil;
+                }
+                _YYLinkedMapUnlock(lru);
+            }
+        }
+    }
+    [self _releaseHolder:holder];
+}
+
+/// Decompress the value of a hit, and put the data back into its node, so the
+/// next hit doesn't decompress it again. The node gets back its original cost,
+/// so the limits are checked again as a write.
+- (id)_decompressObject:(_YYCompressedData *)compressed forKey:(id)key hash:(uint64_t)hash {
+    NSData *data = _YYCompressedDataInflate(compressed);
+    if (!data) return nil;
+    _YYLinkedMap *lru = _YYLinkedMapShardForHash(_shards, _shardShift, hash);
+    _YYLinkedMapEntry replaced = {NULL, NULL};
+    _YYLinkedMapLock(lru);
+    _YYLinkedMapIndex index = _YYLinkedMapFind(lru, key, hash);
+    if (index != _YYLinkedMapNil) {
+        _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, index);
+        if (node->_value == (__bridge CFTypeRef)compressed) {
+            replaced.value = node->_value;
+            node->_value = CFBridgingRetain(data);
+            [lru setCost:compressed->_cost forNode:index];
+        }
+    }
+    _YYLinkedMapUnlock(lru);
+    _YYLinkedMapReleaseEntry(lru, replaced);
+//    恢复了原来的cost，可能超过限制，同 `_setObject:` 淘汰 (不分配holder)
+    if (replaced.value &&
+        (atomic_load_explicit(&_totals.cost, memory_order_relaxed) > _costLimit ||
+         atomic_load_explicit(&_totals.count, memory_order_relaxed) > _countLimit)) {
+        [self _evictToCost:_costLimit count:_countLimit maxCount:_YYMemoryCacheMaxEvictionsPerWrite holder:NULL];
+    }
+    return data;
+}
+
+/// Returns the shard which holds the most cost (or count), the LRU node of this
+/// shard is the next one to evict. The totals of other shards are read without
+/// lock, it's just a hint.
+- (_YYLinkedMap *)_victimShardByCost:(BOOL)byCost {
+    _YYLinkedMap *victim = _shards[0];
+    if (_shardCount == 1) return victim;
+    NSUInteger max = byCost ? victim->_totalCost : victim->_totalCount;
+    for (NSUInteger i = 1; i < _shardCount; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        NSUInteger value = byCost ? lru->_totalCost : lru->_totalCount;
+        if (value > max) {
+            max = value;
+            victim = lru;
+        }
+    }
+    return victim;
+}
+
+/// Release the removed objects by the release options, as `_YYLinkedMapReleaseEntry()`.
+- (void)_releaseHolder:(_YYLinkedMapHolder)holder {
+    _YYLinkedMap *lru = _shards[0];
+    if (holder.count == 0) {
+        free(holder.entries);
+    } else if (lru->_releaseAsynchronously && !lru->_releaseOnMainThread) {
+        // 交给回收线程批量释放
+        for (NSUInteger i = 0; i < holder.count; i++) {
+            _YYReclaimerRelease(holder.entries[i]);
+        }
+        free(holder.entries);
+    } else if (lru->_releaseAsynchronously || (lru->_releaseOnMainThread && !pthread_main_np())) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            _YYLinkedMapHolderRelease(holder); // release in queue
+//            block对holder引用，让holder在指定的NSThread释放
+        });
+    } else {
+        // 同步释放
+        _YYLinkedMapHolderRelease(holder);
+    }
+}
+
+/**
+ Evict objects until the cache is within `costLimit` and `countLimit`, at most
+ `maxCount` objects. Objects are evicted from the largest shard, a shard's lock
+ is held for at most `_YYMemoryCacheEvictionBatch` evictions, so the writers 
+ of that shard don't wait long. The evicted objects are added to holder, or if
+ holder is NULL, released with `_YYLinkedMapReleaseEntry()` after each batch, 
+ so no memory is allocated (used by the writes of a fixed capacity cache).
+ */
+- (void)_evictToCost:(NSUInteger)costLimit count:(NSUInteger)countLimit maxCount:(NSUInteger)maxCount holder:(_YYLinkedMapHolder *)holder {
+    _YYLinkedMapEntry entries[_YYMemoryCacheEvictionBatch]; // holder is NULL
+    NSUInteger evicted = 0;
+    while (evicted < maxCount) {
+        BOOL overCost = atomic_load_explicit(&_totals.cost, memory_order_relaxed) > costLimit;
+        BOOL overCount = atomic_load_explicit(&_totals.count, memory_order_relaxed) > countLimit;
+        if (!overCost && !overCount) break;
+        _YYLinkedMap *lru = [self _victimShardByCost:overCost];
+        NSUInteger batch = MIN(maxCount - evicted, _YYMemoryCacheEvictionBatch), removed = 0;
+        _YYLinkedMapLock(lru);
+        while (removed < batch &&
+               (atomic_load_explicit(&_totals.cost, memory_order_relaxed) > costLimit ||
+                atomic_load_explicit(&_totals.count, memory_order_relaxed) > countLimit)) {
+            _YYLinkedMapEntry entry = [lru removeVictimNode];
+            if (!entry.value) break;
+            if (holder) _YYLinkedMapHolderAdd(holder, entry);
+            else entries[removed] = entry;
+            removed++;
+        }
+        _YYLinkedMapUnlock(lru);
+        for (NSUInteger i = 0; !holder && i < removed; i++) _YYLinkedMapReleaseEntry(lru, entries[i]);
+        _YYMemoryCacheStatAdd(_stats, overCost ? _YYMemoryCacheStatEvictCost : _YYMemoryCacheStatEvictCount, removed);
+        // 分片已空(统计数据是竞争读取的)，留给下一次写入或定时清理
+        if (removed == 0) break;
+        evicted += removed;
+    }
+}
+
 - (void)_trimToCost:(NSUInteger)costLimit {
-    BOOL finish = NO;
-    pthread_mutex_lock(&_lock);
     if (costLimit == 0) {
 //       首先判断外部设置的costLimit是否为0，是则将MemoryCache全部清除
-        [_lru removeAll];
-        finish = YES;
-    } else if (_lru->_totalCost <= costLimit) {
-        finish = YES;
+        [self removeAllObjects];
+        return;
     }
-    pthread_mutex_unlock(&_lock);
-    if (finish) return;
+    if (atomic_load_explicit(&_totals.cost, memory_order_relaxed) <= costLimit) return;
     
-//    判断costCount是否大于costLimit，若大于，则尝试加锁进行尾部节点的移除
+//    判断costCount是否大于costLimit，若大于，则分批加锁进行尾部节点的移除
 //    为了避免多次释放导致的性能开销，这里是将所有的尾节点放于一个数组中，集中释放。
-    NSMutableArray *holder = [NSMutableArray new];
-    while (!finish) {
-        if (pthread_mutex_trylock(&_lock) == 0) {
-            if (_lru->_totalCost > costLimit) {
-                _YYLinkedMapNode *node = [_lru removeTailNode];
-                if (node) [holder addObject:node];
-            } else {
-                finish = YES;
-            }
-            pthread_mutex_unlock(&_lock);
-        } else {
-            usleep(10 * 1000); //10 ms
-        }
-    }
-    if (holder.count) {
-        dispatch_queue_t queue = _lru->_releaseOnMainThread ? dispatch_get_main_queue() : YYMemoryCacheGetReleaseQueue();
-        dispatch_async(queue, ^{
-            [holder count]; // release in queue
-//            block对holder引用，为了hold住holder, 让holder在指定的NSThread释放, 调用对象方法count并没干什么事
-        });
-    }
+    _YYLinkedMapHolder holder = {0};
+    [self _evictToCost:costLimit count:NSUIntegerMax maxCount:NSUIntegerMax holder:&holder];
+    [self _releaseHolder:holder];
 }
 
 - (void)_trimToCount:(NSUInteger)countLimit {
-    BOOL finish = NO;
-    pthread_mutex_lock(&_lock);
     if (countLimit == 0) {
-        [_lru removeAll];
-        finish = YES;
-    } else if (_lru->_totalCount <= countLimit) {
-        finish = YES;
+        [self removeAllObjects];
+        return;
     }
-    pthread_mutex_unlock(&_lock);
-    if (finish) return;
+    if (atomic_load_explicit(&_totals.count, memory_order_relaxed) <= countLimit) return;
     
-    NSMutableArray *holder = [NSMutableArray new];
-    while (!finish) {
-        if (pthread_mutex_trylock(&_lock) == 0) {
-            if (_lru->_totalCount > countLimit) {
-                _YYLinkedMapNode *node = [_lru removeTailNode];
-                if (node) [holder addObject:node];
-            } else {
-                finish = YES;
-            }
-            pthread_mutex_unlock(&_lock);
-        } else {
-            usleep(10 * 1000); //10 ms
-        }
-    }
-    if (holder.count) {
-        dispatch_queue_t queue = _lru->_releaseOnMainThread ? dispatch_get_main_queue() : YYMemoryCacheGetReleaseQueue();
-        dispatch_async(queue, ^{
-            [holder count]; // release in queue
-        });
-    }
+    _YYLinkedMapHolder holder = {0};
+    [self _evictToCost:NSUIntegerMax count:countLimit maxCount:NSUIntegerMax holder:&holder];
+    [self _releaseHolder:holder];
 }
 
 - (void)_trimToAge:(NSTimeInterval)ageLimit {
-    BOOL finish = NO;
-    NSTimeInterval now = CACurrentMediaTime();
-    pthread_mutex_lock(&_lock);
     if (ageLimit <= 0) {
-        [_lru removeAll];
-        finish = YES;
-    } else if (!_lru->_tail || (now - _lru->_tail->_time) <= ageLimit) {
-        finish = YES;
+        [self removeAllObjects];
+        return;
     }
-    pthread_mutex_unlock(&_lock);
-    if (finish) return;
-    
-    NSMutableArray *holder = [NSMutableArray new];
-    while (!finish) {
-        if (pthread_mutex_trylock(&_lock) == 0) {
-            if (_lru->_tail && (now - _lru->_tail->_time) > ageLimit) {
-                _YYLinkedMapNode *node = [_lru removeTailNode];
-                if (node) [holder addObject:node];
-            } else {
-                finish = YES;
+    NSTimeInterval now = _YYMemoryCacheNow();
+    _YYLinkedMapHolder holder = {0};
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        BOOL finish = NO;
+        NSUInteger passed = 0;
+        while (!finish) {
+            // 分批加锁，每次最多处理 _YYMemoryCacheEvictionBatch 个节点
+            _YYLinkedMapLock(lru);
+            for (NSUInteger n = 0; n < _YYMemoryCacheEvictionBatch && !finish; n++) {
+                _YYLinkedMapIndex oldest = [lru oldestNode];
+                _YYLinkedMapLink *tail = oldest != _YYLinkedMapNil ? _YYLinkedMapGetLink(lru, oldest) : NULL;
+                if (tail && (now - _YYLinkedMapTimeToInterval(tail->_time)) > ageLimit) {
+                    _YYLinkedMapHolderAdd(&holder, [lru removeNode:oldest]);
+                } else if (tail && lru->_policy == YYMemoryCacheEvictionPolicyCLOCK && tail->_referenced && passed < lru->_totalCount) {
+                    // CLOCK: the list is not ordered by access time, skip the referenced nodes
+                    tail->_referenced = 0;
+                    [lru bringNodeToHead:oldest];
+                    passed++;
+                } else {
+                    finish = YES;
+                }
             }
-            pthread_mutex_unlock(&_lock);
-        } else {
-            usleep(10 * 1000); //10 ms
+            _YYLinkedMapUnlock(lru);
         }
     }
-    if (holder.count) {
-        dispatch_queue_t queue = _lru->_releaseOnMainThread ? dispatch_get_main_queue() : YYMemoryCacheGetReleaseQueue();
-        dispatch_async(queue, ^{
-            [holder count]; // release in queue
-        });
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictAge, holder.count);
+    [self _releaseHolder:holder];
+}
+
+- (void)_trimExpired {
+    NSTimeInterval now = _YYMemoryCacheNow();
+    _YYLinkedMapHolder holder = {0};
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        if (lru->_timerCount == 0) continue;
+        _YYLinkedMapLock(lru);
+        [lru removeExpiredNodes:now holder:&holder];
+        _YYLinkedMapUnlock(lru);
+    }
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictAge, holder.count);
+    [self _releaseHolder:holder];
+}
+
+- (void)_trimToRatio:(double)ratio {
+    if (ratio <= 0) {
+        [self removeAllObjects];
+        return;
+    }
+    if (ratio >= 1) return;
+    NSUInteger cost = MIN(_costLimit, (NSUInteger)atomic_load_explicit(&_totals.cost, memory_order_relaxed));
+    NSUInteger count = MIN(_countLimit, (NSUInteger)atomic_load_explicit(&_totals.count, memory_order_relaxed));
+    _YYLinkedMapHolder holder = {0};
+    [self _evictToCost:(NSUInteger)(cost * ratio) count:(NSUInteger)(count * ratio) maxCount:NSUIntegerMax holder:&holder];
+    [self _releaseHolder:holder];
+}
+
+/// The memory warning, memory pressure source and entering background may report
+/// the same pressure, a level is trimmed at most once per second, otherwise the
+/// ratio would be applied repeatedly.
+- (void)_trimForPressureLevelIfNeeded:(YYMemoryCachePressureLevel)level {
+    NSTimeInterval now = _YYMemoryCacheNow();
+    @synchronized (self) {
+        for (NSUInteger i = level; i <= YYMemoryCachePressureLevelCritical; i++) {
+            if (_pressureTime[i] != 0 && now - _pressureTime[i] < 1) return;
+        }
+        _pressureTime[level] = now;
     }
+    [self trimForPressureLevel:level];
 }
 
 - (void)_appDidReceiveMemoryWarningNotification {
@@ -385,7 +2648,8 @@ static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
         self.didReceiveMemoryWarningBlock(self);
     }
     if (self.shouldRemoveAllObjectsOnMemoryWarning) {
-        [self removeAllObjects];
+        // 按比例淘汰最冷的缓存，保留热点数据，避免清空后大量未命中
+        [self _trimForPressureLevelIfNeeded:YYMemoryCachePressureLevelCritical];
     }
 }
 
@@ -394,28 +2658,85 @@ static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
         self.didEnterBackgroundBlock(self);
     }
     if (self.shouldRemoveAllObjectsWhenEnteringBackground) {
-        [self removeAllObjects];
+        [self _trimForPressureLevelIfNeeded:YYMemoryCachePressureLevelWarning];
     }
 }
 
+- (void)_memoryPressureNotification:(NSNotification *)notification {
+    if (!self.shouldRemoveAllObjectsOnMemoryWarning) return;
+    YYMemoryCachePressureLevel level = [notification.userInfo[_YYMemoryCachePressureLevelKey] unsignedIntegerValue];
+    dispatch_async(_queue, ^{
+        [self _trimForPressureLevelIfNeeded:level];
+    });
+}
+
 #pragma mark - public
 
 - (instancetype)init {
+    return [self initWithShardCount:1 evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+}
+
+- (instancetype)initWithShardCount:(NSUInteger)shardCount {
+    return [self initWithShardCount:shardCount evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+}
+
+- (instancetype)initWithShardCount:(NSUInteger)shardCount evictionPolicy:(YYMemoryCacheEvictionPolicy)evictionPolicy {
+    return [self initWithCapacity:0 shardCount:shardCount evictionPolicy:evictionPolicy];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    return [self initWithCapacity:capacity shardCount:1 evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity shardCount:(NSUInteger)shardCount evictionPolicy:(YYMemoryCacheEvictionPolicy)evictionPolicy {
     self = super.init;
-    pthread_mutex_init(&_lock, NULL);
-    _lru = [_YYLinkedMap new];
+    NSUInteger count = 1;
+    while (count < shardCount && count < 1024) count <<= 1;
+    atomic_init(&_totals.cost, 0);
+    atomic_init(&_totals.count, 0);
+    NSMutableArray *holder = [NSMutableArray arrayWithCapacity:count];
+    _shards = (__unsafe_unretained _YYLinkedMap **)calloc(count, sizeof(_YYLinkedMap *));
+    for (NSUInteger i = 0; i < count; i++) {
+        _YYLinkedMap *lru = [[_YYLinkedMap alloc] initWithTotals:&_totals policy:evictionPolicy];
+        [holder addObject:lru];
+        _shards[i] = lru;
+    }
+    _shardHolder = holder;
+    _evictionPolicy = evictionPolicy;
+    _shardCount = count;
+    _shardShift = 64;
+    while (count > 1) {
+        count >>= 1;
+        _shardShift--;
+    }
     _queue = dispatch_queue_create("com.ibireme.cache.memory", DISPATCH_QUEUE_SERIAL);
+    _slabAllocator = [_YYSlabAllocator new];
+    posix_memalign((void **)&_stats, sizeof(_YYMemoryCacheStatStripe), _YYMemoryCacheStatStripeCount * sizeof(_YYMemoryCacheStatStripe));
+    memset(_stats, 0, _YYMemoryCacheStatStripeCount * sizeof(_YYMemoryCacheStatStripe));
     
     _countLimit = NSUIntegerMax;
+    if (capacity) {
+        // 每个分片固定容量，分片满时在分片内淘汰，总数不会超过 countLimit
+        NSUInteger shardCapacity = MIN((capacity + _shardCount - 1) / _shardCount, (NSUInteger)_YYLinkedMapNil);
+        for (NSUInteger i = 0; i < _shardCount; i++) {
+            [_shards[i] reserveCapacity:shardCapacity];
+        }
+        _capacity = shardCapacity * _shardCount;
+        _countLimit = _capacity;
+    }
     _costLimit = NSUIntegerMax;
     _ageLimit = DBL_MAX;
     _autoTrimInterval = 5.0;
     _shouldRemoveAllObjectsOnMemoryWarning = YES;
     _shouldRemoveAllObjectsWhenEnteringBackground = YES;
+    _warningPressureRatio = 0.5;
+    _criticalPressureRatio = 0.25;
     
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_appDidReceiveMemoryWarningNotification) name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_appDidEnterBackgroundNotification) name:UIApplicationDidEnterBackgroundNotification object:nil];
     
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_memoryPressureNotification:) name:_YYMemoryCachePressureNotification object:nil];
+    _YYMemoryCacheStartPressureSource();
     [self _trimRecursively];
     return self;
 }
@@ -423,185 +2744,523 @@ static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
     [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidEnterBackgroundNotification object:nil];
-    [_lru removeAll];
-    pthread_mutex_destroy(&_lock);
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:_YYMemoryCachePressureNotification object:nil];
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        [_shards[i] removeAll];
+    }
+    free(_shards);
+    free(_stats);
+}
+
+- (NSUInteger)shardCount {
+    return _shardCount;
+}
+
+- (NSUInteger)capacity {
+    return _capacity;
+}
+
+- (NSUInteger)totalSlabBytes {
+    return atomic_load_explicit(&_slabAllocator->_pageBytes, memory_order_relaxed);
+}
+
+- (YYMemoryCacheStatistics)statistics {
+    uint64_t sum[_YYMemoryCacheStatMax] = {0};
+    for (NSUInteger i = 0; i < _YYMemoryCacheStatStripeCount; i++) {
+        for (NSUInteger j = 0; j < _YYMemoryCacheStatMax; j++) {
+            sum[j] += atomic_load_explicit(&_stats[i].counters[j], memory_order_relaxed);
+        }
+    }
+    YYMemoryCacheStatistics statistics;
+    statistics.hits = sum[_YYMemoryCacheStatHit];
+    statistics.misses = sum[_YYMemoryCacheStatMiss];
+    statistics.inserts = sum[_YYMemoryCacheStatInsert];
+    statistics.updates = sum[_YYMemoryCacheStatUpdate];
+    statistics.costEvictions = sum[_YYMemoryCacheStatEvictCost];
+    statistics.countEvictions = sum[_YYMemoryCacheStatEvictCount];
+    statistics.ageEvictions = sum[_YYMemoryCacheStatEvictAge];
+    statistics.removals = sum[_YYMemoryCacheStatRemove];
+    return statistics;
+}
+
+- (YYMemoryCacheEvictionPolicy)evictionPolicy {
+    return _evictionPolicy;
 }
 
 - (NSUInteger)totalCount {
-    pthread_mutex_lock(&_lock);
-    NSUInteger count = _lru->_totalCount;
-    pthread_mutex_unlock(&_lock);
-    return count;
+    return atomic_load_explicit(&_totals.count, memory_order_relaxed);
 }
 
 - (NSUInteger)totalCost {
-    pthread_mutex_lock(&_lock);
-    NSUInteger totalCost = _lru->_totalCost;
-    pthread_mutex_unlock(&_lock);
-    return totalCost;
+    return atomic_load_explicit(&_totals.cost, memory_order_relaxed);
 }
 
 - (BOOL)releaseOnMainThread {
-    pthread_mutex_lock(&_lock);
-    BOOL releaseOnMainThread = _lru->_releaseOnMainThread;
-    pthread_mutex_unlock(&_lock);
+    _YYLinkedMap *lru = _shards[0];
+    _YYLinkedMapLock(lru);
+    BOOL releaseOnMainThread = lru->_releaseOnMainThread;
+    _YYLinkedMapUnlock(lru);
     return releaseOnMainThread;
 }
 
 - (void)setReleaseOnMainThread:(BOOL)releaseOnMainThread {
-    pthread_mutex_lock(&_lock);
-    _lru->_releaseOnMainThread = releaseOnMainThread;
-    pthread_mutex_unlock(&_lock);
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        _YYLinkedMapLock(lru);
+        lru->_releaseOnMainThread = releaseOnMainThread;
+        _YYLinkedMapUnlock(lru);
+    }
 }
 
 - (BOOL)releaseAsynchronously {
-    pthread_mutex_lock(&_lock);
-    BOOL releaseAsynchronously = _lru->_releaseAsynchronously;
-    pthread_mutex_unlock(&_lock);
+    _YYLinkedMap *lru = _shards[0];
+    _YYLinkedMapLock(lru);
+    BOOL releaseAsynchronously = lru->_releaseAsynchronously;
+    _YYLinkedMapUnlock(lru);
     return releaseAsynchronously;
 }
 
 - (void)setReleaseAsynchronously:(BOOL)releaseAsynchronously {
-    pthread_mutex_lock(&_lock);
-    _lru->_releaseAsynchronously = releaseAsynchronously;
-    pthread_mutex_unlock(&_lock);
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        _YYLinkedMapLock(lru);
+        lru->_releaseAsynchronously = releaseAsynchronously;
+        _YYLinkedMapUnlock(lru);
+    }
 }
 
 - (BOOL)containsObjectForKey:(id)key {
     if (!key) return NO;
-    pthread_mutex_lock(&_lock);
-    BOOL contains = CFDictionaryContainsKey(_lru->_dic, (__bridge const void *)(key));
-    pthread_mutex_unlock(&_lock);
+    return [self _containsObjectForKey:key hash:_YYMemoryCacheHash(key)];
+}
+
+- (BOOL)containsObjectForIntegerKey:(uint64_t)key {
+    return [self _containsObjectForKey:nil hash:_YYMemoryCacheIntegerHash(key)];
+}
+
+/// `key` is nil for an integer key, see `_YYLinkedMapFind`.
+- (BOOL)_containsObjectForKey:(id)key hash:(uint64_t)hash {
+    _YYLinkedMap *lru = _YYLinkedMapShardForHash(_shards, _shardShift, hash);
+    _YYLinkedMapLockForReading(lru);
+    _YYLinkedMapIndex index = _YYLinkedMapFind(lru, key, hash);
+    BOOL contains = index != _YYLinkedMapNil && !_YYLinkedMapNodeExpired(_YYLinkedMapGetNode(lru, index), _YYMemoryCacheNow());
+    _YYLinkedMapUnlock(lru);
     return contains;
 }
 // 查找缓存
 - (id)objectForKey:(id)key {
-    if (!key) return nil;
+    return [self objectForKey:key needsRefresh:NULL];
+}
+
+- (id)objectForKey:(id)key needsRefresh:(BOOL *)needsRefresh {
+    if (!key) {
+        if (needsRefresh) *needsRefresh = NO;
+        return nil;
+    }
+    return [self _objectForKey:key hash:_YYMemoryCacheHash(key) needsRefresh:needsRefresh];
+}
+
+- (id)objectForIntegerKey:(uint64_t)key {
+    return [self _objectForKey:nil hash:_YYMemoryCacheIntegerHash(key) needsRefresh:NULL];
+}
+
+- (id)_objectForKey:(id)key hash:(uint64_t)hash needsRefresh:(BOOL *)needsRefresh {
+    __unsafe_unretained YYCacheLatencyRecorder *recorder = _latencyRecorder;
+    uint64_t begin = recorder ? mach_absolute_time() : 0;
+    [_missRatioEstimator recordReadWithHash:hash cost:0];
+    _YYMemoryCacheRecordHotKey(_hotKeyTracker, key, hash);
+    id value = [self _lookupObjectForKey:key hash:hash needsRefresh:needsRefresh];
+    // 命中压缩过的值，解压后放回节点
+    if (_hasCompressedData && [value class] == [_YYCompressedData class]) {
+        value = [self _decompressObject:value forKey:key hash:hash];
+    }
+    if (recorder) [recorder recordOperation:YYCacheOperationMemoryGet beginTime:begin];
+    return value;
+}
+
+/// `key` is nil for an integer key, see `_YYLinkedMapFind`.
+- (id)_lookupObjectForKey:(id)key hash:(uint64_t)hash needsRefresh:(BOOL *)needsRefresh {
+    if (needsRefresh) *needsRefresh = NO;
+    // 根据key的hash找到所在的分片，不同分片之间互不影响
+    _YYLinkedMap *lru = _YYLinkedMapShardForHash(_shards, _shardShift, hash);
+    if (lru->_policy == YYMemoryCacheEvictionPolicyCLOCK) return [self _clockObjectForKey:key hash:hash shard:lru needsRefresh:needsRefresh];
+    if (lru->_policy == YYMemoryCacheEvictionPolicyBufferedLRU) return [self _bufferedObjectForKey:key hash:hash shard:lru needsRefresh:needsRefresh];
     // 加锁，防止资源竞争
     // OSSpinLock 自旋锁，性能最高的锁。原理很简单，就是一直 do while 忙等。它的缺点是当等待时会消耗大量 CPU 资源，所以它不适用于较长时间的任务。对于内存缓存的存取来说，它非常合适。
-    pthread_mutex_lock(&_lock);
-    // _lru为链表_YYLinkedMap，全部节点存在_lru->_dic中
+    _YYLinkedMapLock(lru);
+    // lru为链表_YYLinkedMap，全部节点索引存在lru的哈希表中
     // 获取节点
-    _YYLinkedMapNode *node = CFDictionaryGetValue(_lru->_dic, (__bridge const void *)(key));
-    if (node) {
+    _YYLinkedMapIndex index = _YYLinkedMapFind(lru, key, hash);
+    id value = nil;
+    _YYLinkedMapEntry expired = {NULL, NULL};
+    NSTimeInterval now = _YYMemoryCacheNow();
+    if (index != _YYLinkedMapNil && _YYLinkedMapNodeExpired(_YYLinkedMapGetNode(lru, index), now)) {
+        // 已过期，当作未命中并移除
+        expired = [lru removeNode:index];
+        _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictAge, 1);
+    } else if (index != _YYLinkedMapNil) {
         
         //** 有对应缓存 **
         
+        _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, index);
+        // 节点解锁后可能被复用，需要在锁内retain缓存值
+        value = (__bridge id)(node->_value);
         // 重新更新缓存时间
         
-        node->_time = CACurrentMediaTime();
+        _YYLinkedMapGetLink(lru, index)->_time = _YYLinkedMapTimeFromInterval(now);
         // 把当前node移到链表表头(为什么移到表头？根据LRU淘汰算法:Cache的容量是有限的，当Cache的空间都被占满后，如果再次发生缓存失效，就必须选择一个缓存块来替换掉.LRU法是依据各块使用的情况， 总是选择那个最长时间未被使用的块替换。这种方法比较好地反映了程序局部性规律)
         
     
-        [_lru bringNodeToHead:node];
+        [lru accessNode:index];
+        // 软过期，返回旧值并由调用者刷新
+        if (needsRefresh) *needsRefresh = _YYLinkedMapNodeClaimRefresh(node, now);
     }
     // 解锁
-    pthread_mutex_unlock(&_lock);
+    _YYLinkedMapUnlock(lru);
+    _YYMemoryCacheStatAdd(_stats, value ? _YYMemoryCacheStatHit : _YYMemoryCacheStatMiss, 1);
+    _YYLinkedMapReleaseEntry(lru, expired);
     // 有缓存则返回缓存值
-    return node ? node->_value : nil;
+    return value;
+}
+
+/// A CLOCK hit doesn't change the list, it only sets the node's reference bit
+/// (and access time, at most once per pass of the clock hand) with atomic store,
+/// so the readers can share the lock.
+- (id)_clockObjectForKey:(id)key hash:(uint64_t)hash shard:(_YYLinkedMap *)lru needsRefresh:(BOOL *)needsRefresh {
+    _YYLinkedMapLockForReading(lru);
+    _YYLinkedMapIndex index = _YYLinkedMapFind(lru, key, hash);
+    id value = nil;
+    NSTimeInterval now = _YYMemoryCacheNow();
+    // 过期的节点只能在写锁内移除，这里当作未命中
+    if (index != _YYLinkedMapNil && !_YYLinkedMapNodeExpired(_YYLinkedMapGetNode(lru, index), now)) {
+        _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, index);
+        _YYLinkedMapLink *link = _YYLinkedMapGetLink(lru, index);
+        value = (__bridge id)(node->_value);
+        // 已经设置过引用位时不再写入，避免多个读线程争抢同一个cache line
+        if (!__atomic_load_n(&link->_referenced, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&link->_time, _YYLinkedMapTimeFromInterval(now), __ATOMIC_RELAXED);
+            __atomic_store_n(&link->_referenced, 1, __ATOMIC_RELAXED);
+        }
+        if (needsRefresh) *needsRefresh = _YYLinkedMapNodeClaimRefresh(node, now);
+    }
+    _YYLinkedMapUnlock(lru);
+    _YYMemoryCacheStatAdd(_stats, value ? _YYMemoryCacheStatHit : _YYMemoryCacheStatMiss, 1);
+    return value;
+}
+
+/// A BufferedLRU hit is recorded into the read buffer with a shared lock, the
+/// reader tries to drain the buffer when it's half full, but never waits for
+/// the write lock: the next writer drains it anyway.
+- (id)_bufferedObjectForKey:(id)key hash:(uint64_t)hash shard:(_YYLinkedMap *)lru needsRefresh:(BOOL *)needsRefresh {
+    _YYLinkedMapLockForReading(lru);
+    _YYLinkedMapIndex index = _YYLinkedMapFind(lru, key, hash);
+    id value = nil;
+    BOOL drain = NO;
+    NSTimeInterval now = _YYMemoryCacheNow();
+    if (index != _YYLinkedMapNil && !_YYLinkedMapNodeExpired(_YYLinkedMapGetNode(lru, index), now)) {
+        _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, index);
+        value = (__bridge id)(node->_value);
+        __atomic_store_n(&_YYLinkedMapGetLink(lru, index)->_time, _YYLinkedMapTimeFromInterval(now), __ATOMIC_RELAXED);
+        drain = _YYLinkedMapRecordRead(lru, index, node->_generation);
+        if (needsRefresh) *needsRefresh = _YYLinkedMapNodeClaimRefresh(node, now);
+    }
+    _YYLinkedMapUnlock(lru);
+    _YYMemoryCacheStatAdd(_stats, value ? _YYMemoryCacheStatHit : _YYMemoryCacheStatMiss, 1);
+    if (drain && _YYLinkedMapTryLock(lru) == 0) _YYLinkedMapUnlock(lru);
+    return value;
 }
 
 - (void)setObject:(id)object forKey:(id)key {
     [self setObject:object forKey:key withCost:0];
 }
-//添加缓存
 - (void)setObject:(id)object forKey:(id)key withCost:(NSUInteger)cost {
+    [self setObject:object forKey:key withCost:cost ttl:0];
+}
+//添加缓存
+- (void)setObject:(id)object forKey:(id)key withCost:(NSUInteger)cost ttl:(NSTimeInterval)ttl {
+    [self setObject:object forKey:key withCost:cost ttl:ttl refreshAfter:0];
+}
+
+- (void)setObject:(id)object forKey:(id)key withCost:(NSUInteger)cost ttl:(NSTimeInterval)ttl refreshAfter:(NSTimeInterval)refreshAfter {
     if (!key) return;
+    [self _setObject:object forKey:key hash:_YYMemoryCacheHash(key) cost:cost ttl:ttl refreshAfter:refreshAfter];
+}
+
+- (void)setObject:(id)object forIntegerKey:(uint64_t)key {
+    [self setObject:object forIntegerKey:key withCost:0];
+}
+
+- (void)setObject:(id)object forIntegerKey:(uint64_t)key withCost:(NSUInteger)cost {
+    [self _setObject:object forKey:nil hash:_YYMemoryCacheIntegerHash(key) cost:cost ttl:0 refreshAfter:0];
+}
+
+/// `key` is nil for an integer key, see `_YYLinkedMapFind`.
+- (void)_setObject:(id)object forKey:(id)key hash:(uint64_t)hash cost:(NSUInteger)cost ttl:(NSTimeInterval)ttl refreshAfter:(NSTimeInterval)refreshAfter {
     if (!object) {
         // ** 缓存对象为空，移除缓存
 //        当object不存在时，调用removeObjectForKey 进行删除
 //        **
-        [self removeObjectForKey:key];
+        [self _removeObjectForKey:key hash:hash];
         return;
     }
+    __unsafe_unretained YYCacheLatencyRecorder *recorder = _latencyRecorder;
+    uint64_t begin = recorder ? mach_absolute_time() : 0;
+    [_missRatioEstimator recordWriteWithHash:hash cost:cost];
+    _YYMemoryCacheRecordHotKey(_hotKeyTracker, key, hash);
+    _YYLinkedMap *lru = _YYLinkedMapShardForHash(_shards, _shardShift, hash);
 //    加锁
-    pthread_mutex_lock(&_lock);
-//    查找缓存
-    _YYLinkedMapNode *node = CFDictionaryGetValue(_lru->_dic, (__bridge const void *)(key));
+    _YYLinkedMapLock(lru);
 //    当前时间
-    NSTimeInterval now = CACurrentMediaTime();
-    if (node) {
-        //** 之前有缓存，更新旧缓存 **
-        
-        // 更新值
-        _lru->_totalCost -= node->_cost;
-        _lru->_totalCost += cost;
-        node->_cost = cost;
-        node->_time = now;
-        node->_value = object;
-        // 移动节点到链表表头
-        [_lru bringNodeToHead:node];
-    } else {
-        
-        //** 之前未有缓存，添加新缓存 **
-        
-        // 新建节点
-        
-//        创建一个新的node，然后通过->来对成员变量进行赋值（不用点语法就是为了节省调用方法的时间，提升性能，还有OC中对象进行 ->是访问成员变量，由于之前采用了 @package操作，所以不能在外部通过->来访问成员变量，和结构体的->类似）
-        
-        node = [_YYLinkedMapNode new];
-        node->_cost = cost;
-        node->_time = now;
-        node->_key = key;
-        node->_value = object;
-        
-        // 添加节点到表头
-//        用_lru(_YYLinkedMap的实例)将node插入到链表头部
-        [_lru insertNodeAtHead:node];
-    }
+    NSTimeInterval now = _YYMemoryCacheNow();
+//    更新或添加缓存，旧值在解锁后释放
+    _YYLinkedMapEntry evicted = {NULL, NULL}; // fixed capacity only
+    CFTypeRef oldValue = [lru storeObject:object forKey:key hash:hash cost:cost ttl:ttl refreshAfter:refreshAfter time:now evicted:&evicted];
+    // 移除本分片中已过期的缓存 (固定容量时留给定时清理，写入时不分配内存)
+    _YYLinkedMapHolder holder = {0}; // expired and evicted objects
+    if (lru->_timerCount && !lru->_capacity) [lru removeExpiredNodes:now holder:&holder];
     
-//    检查是否超过数量和大小的限制，以进行尾部的node删除，然后在后台线程释放
-    if (_lru->_totalCost > _costLimit) {
-        
-        // ** 总缓存开销大于设定的开销 **
-        
-        // 异步清理最久未使用的缓存
-        dispatch_async(_queue, ^{
-            [self trimToCost:_costLimit];
-        });
+    _YYLinkedMapUnlock(lru);
+    _YYMemoryCacheStatAdd(_stats, oldValue ? _YYMemoryCacheStatUpdate : _YYMemoryCacheStatInsert, 1);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictAge, holder.count);
+    
+    if (oldValue) CFRelease(oldValue);
+    if (evicted.value) {
+        _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictCount, 1);
+        _YYLinkedMapReleaseEntry(lru, evicted);
     }
-    if (_lru->_totalCount > _countLimit) {
-        _YYLinkedMapNode *node = [_lru removeTailNode];
-        if (_lru->_releaseAsynchronously) {
-            dispatch_queue_t queue = _lru->_releaseOnMainThread ? dispatch_get_main_queue() : YYMemoryCacheGetReleaseQueue();
-            dispatch_async(queue, ^{
-                [node class]; //hold and release in queue
-            });
-        } else if (_lru->_releaseOnMainThread && !pthread_main_np()) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [node class]; //hold and release in queue
-                
-//                这里是为了给node增加使用的周期，如果没有在开的queue中调用node的方法，node就会在queue之前被释放掉 这样做的目的是为了让node在开的子线程中进行释放而不是在主线程
-            });
-        }
+//    检查是否超过数量和大小的限制，在当前线程淘汰 (每次写入最多淘汰 _YYMemoryCacheMaxEvictionsPerWrite 个)，然后在后台线程释放
+//    固定容量时直接交给回收线程，不分配holder
+    if (atomic_load_explicit(&_totals.cost, memory_order_relaxed) > _costLimit ||
+        atomic_load_explicit(&_totals.count, memory_order_relaxed) > _countLimit) {
+        [self _evictToCost:_costLimit count:_countLimit maxCount:_YYMemoryCacheMaxEvictionsPerWrite holder:(_capacity ? NULL : &holder)];
     }
-    pthread_mutex_unlock(&_lock);
+    [self _releaseHolder:holder];
+    if (recorder) [recorder recordOperation:YYCacheOperationMemorySet beginTime:begin];
+}
+
+- (void)setData:(NSData *)data forKey:(id)key {
+    if (!key) return;
+    if (!data) {
+        [self removeObjectForKey:key];
+        return;
+    }
+    NSUInteger cost = 0;
+    NSData *value = [_slabAllocator copyData:data cost:&cost];
+    if (!value) {
+        // 超过最大的slab class，使用普通的拷贝
+        value = [data copy];
+        cost = value.length;
+    }
+    [self setObject:value forKey:key withCost:cost];
 }
 
 - (void)removeObjectForKey:(id)key {
     if (!key) return;
-    pthread_mutex_lock(&_lock);
-    _YYLinkedMapNode *node = CFDictionaryGetValue(_lru->_dic, (__bridge const void *)(key));
-    if (node) {
-        [_lru removeNode:node];
-        if (_lru->_releaseAsynchronously) {
-            dispatch_queue_t queue = _lru->_releaseOnMainThread ? dispatch_get_main_queue() : YYMemoryCacheGetReleaseQueue();
-            dispatch_async(queue, ^{
-                [node class]; //hold and release in queue
-            });
-        } else if (_lru->_releaseOnMainThread && !pthread_main_np()) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [node class]; //hold and release in queue
-            });
+    [self _removeObjectForKey:key hash:_YYMemoryCacheHash(key)];
+}
+
+- (void)removeObjectForIntegerKey:(uint64_t)key {
+    [self _removeObjectForKey:nil hash:_YYMemoryCacheIntegerHash(key)];
+}
+
+/// `key` is nil for an integer key, see `_YYLinkedMapFind`.
+- (void)_removeObjectForKey:(id)key hash:(uint64_t)hash {
+    _YYMemoryCacheRecordHotKey(_hotKeyTracker, key, hash);
+    _YYLinkedMap *lru = _YYLinkedMapShardForHash(_shards, _shardShift, hash);
+    _YYLinkedMapLock(lru);
+    _YYLinkedMapIndex index = _YYLinkedMapFind(lru, key, hash);
+    _YYLinkedMapEntry removed = {NULL, NULL};
+    if (index != _YYLinkedMapNil) {
+        removed = [lru removeNode:index];
+    }
+    _YYLinkedMapUnlock(lru);
+    if (removed.value) _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatRemove, 1);
+    _YYLinkedMapReleaseEntry(lru, removed);
+}
+
+- (NSDictionary *)objectsForKeys:(NSArray *)keys {
+    NSUInteger count = keys.count;
+    if (count == 0) return @{};
+    _YYMemoryCacheBatch batch = _YYMemoryCacheBatchCreate(keys, _shardCount, _shardShift);
+    CFTypeRef *values = calloc(count, sizeof(CFTypeRef));
+    NSUInteger hits = 0;
+    YYCacheMissRatioEstimator *estimator = _missRatioEstimator;
+    for (NSUInteger i = 0; estimator && i < count; i++) [estimator recordReadWithHash:batch.hashes[i] cost:0];
+    YYCacheHotKeyTracker *tracker = _hotKeyTracker;
+    for (NSUInteger i = 0; tracker && i < count; i++) [tracker recordKey:batch.keys[i]];
+    _YYLinkedMapHolder holder = {0}; // expired objects
+    NSTimeInterval now = _YYMemoryCacheNow();
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        NSUInteger begin = batch.bounds[i], end = batch.bounds[i + 1];
+        if (begin == end) continue;
+        _YYLinkedMap *lru = _shards[i];
+        // 命中需要更新链表，所有策略都使用写锁
+        _YYLinkedMapLock(lru);
+        for (NSUInteger j = begin; j < end; j++) _YYLinkedMapPrefetch(lru, batch.hashes[batch.order[j]]);
+        for (NSUInteger j = begin; j < end; j++) {
+            NSUInteger k = batch.order[j];
+            _YYLinkedMapIndex index = _YYLinkedMapFind(lru, batch.keys[k], batch.hashes[k]);
+            if (index == _YYLinkedMapNil) continue;
+            _YYLinkedMapNode *node = _YYLinkedMapGetNode(lru, index);
+            if (_YYLinkedMapNodeExpired(node, now)) {
+                _YYLinkedMapHolderAdd(&holder, [lru removeNode:index]);
+                continue;
+            }
+            // 节点解锁后可能被复用，需要在锁内retain缓存值
+            values[k] = CFRetain(node->_value);
+            _YYLinkedMapGetLink(lru, index)->_time = _YYLinkedMapTimeFromInterval(now);
+            [lru accessNode:index];
+            hits++;
         }
+        _YYLinkedMapUnlock(lru);
     }
-    pthread_mutex_unlock(&_lock);
+    // 键不能被复制 (可能没有实现NSCopying)，只retain
+    CFMutableDictionaryRef dic = CFDictionaryCreateMutable(CFAllocatorGetDefault(), count, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    for (NSUInteger i = 0; i < count; i++) {
+        if (!values[i]) continue;
+        id value = (__bridge id)values[i];
+        if (_hasCompressedData && [value class] == [_YYCompressedData class]) {
+            value = [self _decompressObject:value forKey:batch.keys[i] hash:batch.hashes[i]];
+        }
+        if (value) CFDictionarySetValue(dic, (__bridge CFTypeRef)batch.keys[i], (__bridge CFTypeRef)value);
+        CFRelease(values[i]);
+    }
+    free(values);
+    _YYMemoryCacheBatchFree(batch);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatHit, hits);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatMiss, count - hits);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictAge, holder.count);
+    [self _releaseHolder:holder];
+    return CFBridgingRelease(dic);
+}
+
+- (void)setObjects:(NSArray *)objects forKeys:(NSArray *)keys costs:(NSArray<NSNumber *> *)costs {
+    NSUInteger count = keys.count;
+    if (count == 0 || objects.count != count || (costs && costs.count != count)) return;
+    _YYMemoryCacheBatch batch = _YYMemoryCacheBatchCreate(keys, _shardCount, _shardShift);
+    __unsafe_unretained id *values = (__unsafe_unretained id *)malloc(count * sizeof(id));
+    [objects getObjects:values range:NSMakeRange(0, count)];
+    NSUInteger *costValues = calloc(count, sizeof(NSUInteger));
+    for (NSUInteger i = 0; costs && i < count; i++) costValues[i] = costs[i].unsignedIntegerValue;
+    YYCacheMissRatioEstimator *estimator = _missRatioEstimator;
+    for (NSUInteger i = 0; estimator && i < count; i++) [estimator recordWriteWithHash:batch.hashes[i] cost:costValues[i]];
+    YYCacheHotKeyTracker *tracker = _hotKeyTracker;
+    for (NSUInteger i = 0; tracker && i < count; i++) [tracker recordKey:batch.keys[i]];
+    CFTypeRef *oldValues = calloc(count, sizeof(CFTypeRef));
+    NSUInteger updates = 0, evictions = 0;
+    _YYLinkedMapHolder holder = {0}; // expired and evicted objects
+    NSTimeInterval now = _YYMemoryCacheNow();
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        NSUInteger begin = batch.bounds[i], end = batch.bounds[i + 1];
+        if (begin == end) continue;
+        _YYLinkedMap *lru = _shards[i];
+        _YYLinkedMapLock(lru);
+        for (NSUInteger j = begin; j < end; j++) _YYLinkedMapPrefetch(lru, batch.hashes[batch.order[j]]);
+        for (NSUInteger j = begin; j < end; j++) {
+            NSUInteger k = batch.order[j];
+            _YYLinkedMapEntry evicted = {NULL, NULL};
+            oldValues[k] = [lru storeObject:values[k] forKey:batch.keys[k] hash:batch.hashes[k] cost:costValues[k] ttl:0 refreshAfter:0 time:now evicted:&evicted];
+            if (evicted.value) {
+                _YYLinkedMapHolderAdd(&holder, evicted);
+                evictions++;
+            }
+        }
+        // 固定容量时过期的缓存留给定时清理，同 `_setObject:`
+        if (lru->_timerCount && !lru->_capacity) [lru removeExpiredNodes:now holder:&holder];
+        _YYLinkedMapUnlock(lru);
+    }
+    // 旧值在解锁后释放
+    for (NSUInteger i = 0; i < count; i++) {
+        if (oldValues[i]) {
+            CFRelease(oldValues[i]);
+            updates++;
+        }
+    }
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatUpdate, updates);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatInsert, count - updates);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictCount, evictions);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatEvictAge, holder.count - evictions);
+    free(oldValues);
+    free(costValues);
+    free(values);
+    _YYMemoryCacheBatchFree(batch);
+//    整批写入后只淘汰一次，每个写入的对象最多淘汰 _YYMemoryCacheMaxEvictionsPerWrite 个
+    if (atomic_load_explicit(&_totals.cost, memory_order_relaxed) > _costLimit ||
+        atomic_load_explicit(&_totals.count, memory_order_relaxed) > _countLimit) {
+        [self _evictToCost:_costLimit count:_countLimit maxCount:_YYMemoryCacheMaxEvictionsPerWrite * count holder:(_capacity ? NULL : &holder)];
+    }
+    [self _releaseHolder:holder];
+}
+
+- (void)removeObjectsForKeys:(NSArray *)keys {
+    NSUInteger count = keys.count;
+    if (count == 0) return;
+    _YYMemoryCacheBatch batch = _YYMemoryCacheBatchCreate(keys, _shardCount, _shardShift);
+    _YYLinkedMapHolder holder = {0}; // removed objects
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        NSUInteger begin = batch.bounds[i], end = batch.bounds[i + 1];
+        if (begin == end) continue;
+        _YYLinkedMap *lru = _shards[i];
+        _YYLinkedMapLock(lru);
+        for (NSUInteger j = begin; j < end; j++) _YYLinkedMapPrefetch(lru, batch.hashes[batch.order[j]]);
+        for (NSUInteger j = begin; j < end; j++) {
+            NSUInteger k = batch.order[j];
+            _YYLinkedMapIndex index = _YYLinkedMapFind(lru, batch.keys[k], batch.hashes[k]);
+            if (index != _YYLinkedMapNil) _YYLinkedMapHolderAdd(&holder, [lru removeNode:index]);
+        }
+        _YYLinkedMapUnlock(lru);
+    }
+    _YYMemoryCacheBatchFree(batch);
+    _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatRemove, holder.count);
+    [self _releaseHolder:holder];
 }
 
 - (void)removeAllObjects {
-    pthread_mutex_lock(&_lock);
-    [_lru removeAll];
-    pthread_mutex_unlock(&_lock);
+    for (NSUInteger i = 0; i < _shardCount; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        _YYLinkedMapLock(lru);
+        NSUInteger removed = lru->_totalCount;
+        [lru removeAll];
+        _YYLinkedMapUnlock(lru);
+        _YYMemoryCacheStatAdd(_stats, _YYMemoryCacheStatRemove, removed);
+    }
+}
+
+- (void)enumerateKeysAndObjectsUsingBlock:(void (^)(id key, id obj, BOOL *stop))block {
+    if (!block) return;
+    _YYLinkedMapEntry entries[_YYMemoryCacheEnumerationBatch];
+    uint64_t hashes[_YYMemoryCacheEnumerationBatch];
+    BOOL stop = NO;
+    for (NSUInteger i = 0; i < _shardCount && !stop; i++) {
+        _YYLinkedMap *lru = _shards[i];
+        _YYLinkedMapCursor cursor;
+        _YYLinkedMapLock(lru);
+        [lru addCursor:&cursor];
+        _YYLinkedMapUnlock(lru);
+        while (!stop) {
+            // 每次加锁只拷贝一批，block在锁外调用
+            _YYLinkedMapLockForReading(lru);
+            NSUInteger count = [lru copyEntriesFromCursor:&cursor entries:entries hashes:hashes count:_YYMemoryCacheEnumerationBatch time:_YYMemoryCacheNow()];
+            _YYLinkedMapUnlock(lru);
+            if (count == 0) break;
+            for (NSUInteger j = 0; j < count; j++) {
+                if (!stop) {
+                    @autoreleasepool {
+                        id key = entries[j].key ? (__bridge id)entries[j].key : @(_YYMemoryCacheIntegerKey(hashes[j]));
+                        id obj = (__bridge id)entries[j].value;
+                        // 遍历不算命中，解压后不放回节点
+                        if (_hasCompressedData && [obj class] == [_YYCompressedData class]) obj = _YYCompressedDataInflate(obj);
+                        if (obj) block(key, obj, &stop);
+                    }
+                }
+                if (entries[j].key) CFRelease(entries[j].key);
+                CFRelease(entries[j].value);
+            }
+        }
+        _YYLinkedMapLock(lru);
+        [lru removeCursor:&cursor];
+        _YYLinkedMapUnlock(lru);
+    }
 }
 
 - (void)trimToCount:(NSUInteger)count {
@@ -609,15 +3268,25 @@ static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
         [self removeAllObjects];
         return;
     }
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     [self _trimToCount:count];
+    [_latencyRecorder recordOperation:YYCacheOperationMemoryTrim beginTime:begin];
 }
 
 - (void)trimToCost:(NSUInteger)cost {
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     [self _trimToCost:cost];
+    [_latencyRecorder recordOperation:YYCacheOperationMemoryTrim beginTime:begin];
 }
 
 - (void)trimToAge:(NSTimeInterval)age {
+    uint64_t begin = _latencyRecorder ? mach_absolute_time() : 0;
     [self _trimToAge:age];
+    [_latencyRecorder recordOperation:YYCacheOperationMemoryTrim beginTime:begin];
+}
+
+- (void)trimForPressureLevel:(YYMemoryCachePressureLevel)level {
+    [self _trimToRatio:level == YYMemoryCachePressureLevelCritical ? self.criticalPressureRatio : self.warningPressureRatio];
 }
 
 - (NSString *)description {
@@ -626,3 +3295,7 @@ static inline dispatch_queue_t YYMemoryCacheGetReleaseQueue() {
 }
 
 @end
+
+void _YYMemoryCacheCompressColdData(YYMemoryCache *cache) {
+    [cache _compressColdData];
+}
@@ -0,0 +1,62 @@
+//
+//  YYMemoryCacheInternal.h
+//  YYCache <https://github.com/ibireme/YYCache>
+//
+//  Copyright (c) 2015 ibireme.
+//
+//  This source code is licensed under the MIT-style license found in the
+//  LICENSE file in the root directory of this source tree.
+//
+
+#import <Foundation/Foundation.h>
+
+/*
+ The internals of YYMemoryCache which are used by the unit tests.
+ This is not a public header, don't import it in your app.
+ */
+
+/**
+ A key-value pair removed from linked map.
+ Both key and value are retained (key is NULL for an integer key), they should
+ be released with `_YYLinkedMapReleaseEntry()` or a `_YYLinkedMapHolder`.
+ */
+typedef struct {
+    CFTypeRef key;
+    CFTypeRef value;
+} _YYLinkedMapEntry;
+
+/// The clock of all memory caches (TTL, timing wheel, `ageLimit`), it's
+/// `CACurrentMediaTime()` if NULL. Tests set it to control the time.
+extern NSTimeInterval (*_YYMemoryCacheClock)(void);
+
+/// The number of cells in the reclaimer queue.
+#define _YYReclaimerQueueSize 4096
+
+/// Release the key-value pair in reclaimer thread (or current thread if the
+/// queue is full).
+void _YYReclaimerRelease(_YYLinkedMapEntry entry);
+
+/**
+ Compresses `src` into an LZ4 block (greedy parsing with a single-entry hash
+ table, like LZ4's fast mode). Returns the compressed length, or 0 if the result
+ doesn't fit in `capacity`.
+ */
+NSUInteger _YYLZ4Compress(const uint8_t *src, NSUInteger length, uint8_t *dst, NSUInteger capacity);
+
+/// Decompresses an LZ4 block of exactly `length` bytes, returns NO if the block is invalid.
+BOOL _YYLZ4Decompress(const uint8_t *src, NSUInteger srcLength, uint8_t *dst, NSUInteger length);
+
+@class _YYCompressedData;
+
+/// Returns a compressed value which owns the LZ4 block `bytes` (malloc'd),
+/// `length` is the length of the original data.
+_YYCompressedData *_YYCompressedDataCreate(uint8_t *bytes, NSUInteger compressedLength, NSUInteger length);
+
+/// Returns the original data, or nil if the compressed value is broken.
+NSData *_YYCompressedDataInflate(_YYCompressedData *compressed);
+
+@class YYMemoryCache;
+
+/// Compresses the cold data of the cache now, which is done by the auto trim
+/// when `compressesColdData` is YES.
+void _YYMemoryCacheCompressColdData(YYMemoryCache *cache);
@@ -0,0 +1,174 @@
+//
+//  YYCacheHotKeysTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the Space-Saving tracker YYCacheHotKeyTracker.
+//
+
+#import <XCTest/XCTest.h>
+#import "YYCacheHotKeys.h"
+
+#define YYTestCapacity 16
+#define YYTestKeyCount 64
+#define YYTestRecordCount 20000
+
+/// A key with a chosen hash, so the keys collide in the tracker's table.
+@interface YYTestHotKey : NSObject <NSCopying> {
+    @public
+    NSUInteger _identifier;
+    NSUInteger _hash;
+}
++ (instancetype)keyWithIdentifier:(NSUInteger)identifier hash:(NSUInteger)hash;
+@end
+
+@implementation YYTestHotKey
+
++ (instancetype)keyWithIdentifier:(NSUInteger)identifier hash:(NSUInteger)hash {
+    YYTestHotKey *key = [self new];
+    key->_identifier = identifier;
+    key->_hash = hash;
+    return key;
+}
+
+- (NSUInteger)hash {
+    return _hash;
+}
+
+- (BOOL)isEqual:(id)object {
+    return [object isKindOfClass:[YYTestHotKey class]] && ((YYTestHotKey *)object)->_identifier == _identifier;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    return self; // immutable
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"key%lu", (unsigned long)_identifier];
+}
+
+@end
+
+
+@interface YYCacheHotKeysTests : XCTestCase
+
+@end
+
+@implementation YYCacheHotKeysTests
+
+/// Returns the reported keys as {key: hot key}, and fails on a duplicate key.
+- (NSDictionary *)_hotKeysByKey:(NSArray<YYCacheHotKey *> *)hotKeys {
+    NSMutableDictionary *dic = [NSMutableDictionary dictionary];
+    for (YYCacheHotKey *hotKey in hotKeys) {
+        XCTAssertNil(dic[hotKey.key], @"duplicate %@", hotKey.key);
+        dic[hotKey.key] = hotKey;
+    }
+    return dic;
+}
+
+- (void)testReplacement {
+    YYCacheHotKeyTracker *tracker = [[YYCacheHotKeyTracker alloc] initWithCapacity:2];
+    for (NSString *key in @[@"a", @"a", @"b", @"c"]) [tracker recordKey:key];
+    // c 替换计数最小的 b，继承它的计数作为误差
+    NSDictionary *dic = [self _hotKeysByKey:[tracker hotKeys:10 reset:NO]];
+    XCTAssertEqual(dic.count, 2);
+    XCTAssertEqual([dic[@"a"] count], 2);
+    XCTAssertEqual([dic[@"a"] error], 0);
+    XCTAssertEqual([dic[@"c"] count], 2);
+    XCTAssertEqual([dic[@"c"] error], 1);
+
+    // c 增加后下沉，堆顶变为 a，b 替换 a
+    [tracker recordKey:@"c"];
+    [tracker recordKey:@"b"];
+    NSArray *hotKeys = [tracker hotKeys:10 reset:NO];
+    dic = [self _hotKeysByKey:hotKeys];
+    XCTAssertEqual(dic.count, 2);
+    XCTAssertEqual([dic[@"c"] count], 3);
+    XCTAssertEqual([dic[@"c"] error], 1);
+    XCTAssertEqual([dic[@"b"] count], 3);
+    XCTAssertEqual([dic[@"b"] error], 2);
+    XCTAssertEqual(tracker.recordedCount, 6);
+
+    // 导出时重置
+    XCTAssertEqual([tracker hotKeys:1 reset:YES].count, 1);
+    XCTAssertEqual([tracker hotKeys:10 reset:NO].count, 0);
+    XCTAssertEqual(tracker.recordedCount, 0);
+    [tracker recordKey:@"a"];
+    XCTAssertEqual([[tracker hotKeys:10 reset:NO].firstObject count], 1);
+}
+
+- (void)testSkewedStream {
+    const NSUInteger capacity = YYTestCapacity, keyCount = YYTestKeyCount, recordCount = YYTestRecordCount;
+    YYCacheHotKeyTracker *tracker = [[YYCacheHotKeyTracker alloc] initWithCapacity:capacity];
+    XCTAssertEqual(tracker.capacity, capacity);
+
+    // 哈希表有 32 个槽，所有key的起始槽是 30、31 或 0，探测序列跨过表尾，删除时需要向后移动
+    NSMutableArray *keys = [NSMutableArray array];
+    for (NSUInteger i = 0; i < keyCount; i++) [keys addObject:[YYTestHotKey keyWithIdentifier:i hash:30 + i % 3]];
+
+    // Zipf 分布 (s = 1)
+    double weights[YYTestKeyCount], total = 0;
+    for (NSUInteger i = 0; i < keyCount; i++) total += weights[i] = 1.0 / (i + 1);
+    uint64_t state = 88172645463325252ULL;
+    NSUInteger trueCounts[YYTestKeyCount];
+    memset(trueCounts, 0, sizeof(trueCounts));
+
+    NSDictionary *previous = @{};
+    for (NSUInteger step = 1; step <= recordCount; step++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double r = (double)(state >> 11) / (double)(1ULL << 53) * total;
+        NSUInteger k = 0;
+        while (k + 1 < keyCount && r >= weights[k]) r -= weights[k++];
+        YYTestHotKey *key = keys[k];
+        [tracker recordKey:key];
+        trueCounts[k]++;
+
+        NSArray<YYCacheHotKey *> *hotKeys = [tracker hotKeys:NSUIntegerMax reset:NO];
+        NSDictionary *current = [self _hotKeysByKey:hotKeys];
+        uint64_t sum = 0, lastCount = UINT64_MAX;
+        for (YYCacheHotKey *hotKey in hotKeys) {
+            NSUInteger identifier = ((YYTestHotKey *)hotKey.key)->_identifier;
+            // 估计值是真实值的上界，减去误差是下界
+            XCTAssertGreaterThanOrEqual(hotKey.count, trueCounts[identifier]);
+            XCTAssertLessThanOrEqual(hotKey.count - hotKey.error, trueCounts[identifier]);
+            XCTAssertLessThanOrEqual(hotKey.error, step / capacity);
+            XCTAssertLessThanOrEqual(hotKey.count, lastCount);
+            lastCount = hotKey.count;
+            sum += hotKey.count;
+        }
+        XCTAssertEqual(sum, step);
+        XCTAssertEqual(tracker.recordedCount, step);
+
+        YYCacheHotKey *before = previous[key], *after = current[key];
+        XCTAssertNotNil(after);
+        if (before) {
+            // 已跟踪的key必须能在哈希表中找到
+            XCTAssertEqual(after.count, before.count + 1);
+            XCTAssertEqual(after.error, before.error);
+            XCTAssertEqual(current.count, previous.count);
+        } else if (previous.count == capacity) {
+            // 替换的是计数最小的计数器
+            uint64_t min = UINT64_MAX;
+            for (YYCacheHotKey *hotKey in previous.allValues) min = MIN(min, hotKey.count);
+            XCTAssertEqual(after.error, min);
+            XCTAssertEqual(after.count, min + 1);
+            XCTAssertEqual(current.count, capacity);
+        } else {
+            XCTAssertEqual(after.count, 1);
+            XCTAssertEqual(after.error, 0);
+            XCTAssertEqual(current.count, previous.count + 1);
+        }
+        previous = current;
+    }
+
+    // 超过 1/capacity 的key一定被报告，最热的key排在第一位
+    NSArray<YYCacheHotKey *> *hotKeys = [tracker hotKeys:capacity reset:NO];
+    NSDictionary *reported = [self _hotKeysByKey:hotKeys];
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        if (trueCounts[i] > recordCount / capacity) XCTAssertNotNil(reported[keys[i]], @"key%lu", (unsigned long)i);
+    }
+    XCTAssertEqualObjects(hotKeys.firstObject.key, keys[0]);
+}
+
+@end
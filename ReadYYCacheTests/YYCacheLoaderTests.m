@@ -0,0 +1,190 @@
+//
+//  YYCacheLoaderTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the read-through loading of YYCache: concurrent misses of a key
+//  invoke the loader once, and a stale hit is refreshed in background.
+//
+
+#import <XCTest/XCTest.h>
+#import <stdatomic.h>
+#import "YYCache.h"
+#import "YYMemoryCacheInternal.h"
+
+#define YYTestCallerCount 16
+
+static _Atomic(NSUInteger) YYTestLoadCount;
+static NSTimeInterval YYTestTime;
+
+static NSTimeInterval YYTestClock(void) {
+    return YYTestTime;
+}
+
+@interface YYCacheLoaderTests : XCTestCase {
+    YYCache *_cache;
+}
+
+@end
+
+@implementation YYCacheLoaderTests
+
+- (void)setUp {
+    [super setUp];
+    atomic_store(&YYTestLoadCount, 0);
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    _cache = [YYCache cacheWithPath:path];
+}
+
+- (void)tearDown {
+    _YYMemoryCacheClock = NULL;
+    [_cache removeAllObjects];
+    [[NSFileManager defaultManager] removeItemAtPath:_cache.diskCache.path error:NULL];
+    _cache = nil;
+    [super tearDown];
+}
+
+- (void)testConcurrentMissesInvokeLoaderOnce {
+    id<NSCoding> (^loader)(NSString *) = ^id<NSCoding>(NSString *key) {
+        atomic_fetch_add(&YYTestLoadCount, 1);
+        // 加载较慢，其他调用者在此期间加入等待
+        usleep(200 * 1000);
+        return [[NSMutableString alloc] initWithFormat:@"value of %@", key];
+    };
+
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSUInteger i = 0; i < YYTestCallerCount; i++) [results addObject:[NSNull null]];
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_semaphore_t start = dispatch_semaphore_create(0);
+    YYCache *cache = _cache;
+    for (NSUInteger i = 0; i < YYTestCallerCount; i++) {
+        dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            dispatch_semaphore_wait(start, DISPATCH_TIME_FOREVER);
+            id object = [cache objectForKey:@"key" loader:loader];
+            @synchronized (results) {
+                results[i] = object ?: [NSNull null];
+            }
+        });
+    }
+    for (NSUInteger i = 0; i < YYTestCallerCount; i++) dispatch_semaphore_signal(start);
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)), 0);
+
+    XCTAssertEqual(atomic_load(&YYTestLoadCount), 1);
+    XCTAssertEqualObjects(results[0], @"value of key");
+    for (NSUInteger i = 1; i < YYTestCallerCount; i++) {
+        // 所有调用者得到同一个对象
+        XCTAssertEqual(results[i], results[0], @"caller %lu", (unsigned long)i);
+    }
+    XCTAssertEqual(_cache.statistics.loads, 1);
+    XCTAssertEqual(_cache.statistics.loadFailures, 0);
+
+    // 加载的对象写入了内存缓存和磁盘缓存
+    XCTAssertEqual([_cache.memoryCache objectForKey:@"key"], results[0]);
+    XCTAssertEqualObjects([_cache.diskCache objectForKey:@"key"], @"value of key");
+    XCTAssertEqual([_cache objectForKey:@"key" loader:loader], results[0]);
+    XCTAssertEqual(atomic_load(&YYTestLoadCount), 1);
+}
+
+- (void)testConcurrentMissesWithBlock {
+    dispatch_semaphore_t resume = dispatch_semaphore_create(0);
+    id<NSCoding> (^loader)(NSString *) = ^id<NSCoding>(NSString *key) {
+        atomic_fetch_add(&YYTestLoadCount, 1);
+        // 所有调用者都加入后才返回
+        dispatch_semaphore_wait(resume, DISPATCH_TIME_FOREVER);
+        return [[NSMutableString alloc] initWithFormat:@"value of %@", key];
+    };
+
+    NSMutableArray *results = [NSMutableArray array], *keys = [NSMutableArray array];
+    for (NSUInteger i = 0; i < YYTestCallerCount; i++) {
+        [results addObject:[NSNull null]];
+        [keys addObject:[NSNull null]];
+    }
+    dispatch_group_t group = dispatch_group_create();
+    for (NSUInteger i = 0; i < YYTestCallerCount; i++) {
+        dispatch_group_enter(group);
+        [_cache objectForKey:@"key" loader:loader withBlock:^(NSString *key, id<NSCoding> object) {
+            @synchronized (results) {
+                keys[i] = key ?: [NSNull null];
+                results[i] = object ?: [NSNull null];
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+    // 加载完成前没有回调
+    XCTAssertNotEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 100 * NSEC_PER_MSEC)), 0);
+    dispatch_semaphore_signal(resume);
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)), 0);
+
+    XCTAssertEqual(atomic_load(&YYTestLoadCount), 1);
+    XCTAssertEqualObjects(results[0], @"value of key");
+    for (NSUInteger i = 0; i < YYTestCallerCount; i++) {
+        XCTAssertEqualObjects(keys[i], @"key");
+        XCTAssertEqual(results[i], results[0], @"caller %lu", (unsigned long)i);
+    }
+    XCTAssertEqual(_cache.statistics.loads, 1);
+
+    // 已缓存时不再调用loader
+    dispatch_group_enter(group);
+    __block id cached = nil;
+    [_cache objectForKey:@"key" loader:loader withBlock:^(NSString *key, id<NSCoding> object) {
+        cached = object;
+        dispatch_group_leave(group);
+    }];
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)), 0);
+    XCTAssertEqual(cached, results[0]);
+    XCTAssertEqual(atomic_load(&YYTestLoadCount), 1);
+}
+
+/// Waits until the condition is true, returns NO on timeout.
+- (BOOL)_waitFor:(BOOL (^)(void))condition {
+    for (NSUInteger i = 0; i < 1000 && !condition(); i++) usleep(10 * 1000);
+    return condition();
+}
+
+- (void)testRefreshAhead {
+    YYTestTime = 1000;
+    _YYMemoryCacheClock = YYTestClock;
+    dispatch_semaphore_t resume = dispatch_semaphore_create(0);
+    _cache.loader = ^id<NSCoding>(NSString *key) {
+        atomic_fetch_add(&YYTestLoadCount, 1);
+        dispatch_semaphore_wait(resume, DISPATCH_TIME_FOREVER);
+        return @"new";
+    };
+    _cache.refreshAfter = 10;
+    [_cache setObject:@"old" forKey:@"key"];
+
+    // 未到刷新时间
+    YYTestTime = 1009;
+    XCTAssertEqualObjects([_cache objectForKey:@"key"], @"old");
+    usleep(50 * 1000);
+    XCTAssertEqual(atomic_load(&YYTestLoadCount), 0);
+
+    // 过期的命中返回旧值，只有一次后台加载
+    YYTestTime = 1011;
+    for (NSUInteger i = 0; i < 8; i++) {
+        XCTAssertEqualObjects([_cache objectForKey:@"key"], @"old");
+        XCTAssertEqualObjects([_cache objectForKey:@"key" loader:^id<NSCoding>(NSString *key) {
+            XCTFail(@"the object is cached");
+            return nil;
+        }], @"old");
+    }
+    XCTAssertTrue([self _waitFor:^BOOL{ return atomic_load(&YYTestLoadCount) == 1; }]);
+    dispatch_semaphore_signal(resume);
+    YYCache *cache = _cache;
+    XCTAssertTrue([self _waitFor:^BOOL{ return [[cache.memoryCache objectForKey:@"key"] isEqual:@"new"]; }]);
+    XCTAssertTrue([self _waitFor:^BOOL{ return [[cache.diskCache objectForKey:@"key"] isEqual:@"new"]; }]);
+    XCTAssertEqual(atomic_load(&YYTestLoadCount), 1);
+    XCTAssertEqual(_cache.statistics.loads, 1);
+    XCTAssertEqual(_cache.statistics.refreshes, 1);
+
+    // 新值重新计算刷新时间
+    XCTAssertEqualObjects([_cache objectForKey:@"key"], @"new");
+    usleep(50 * 1000);
+    XCTAssertEqual(atomic_load(&YYTestLoadCount), 1);
+    YYTestTime = 1022;
+    XCTAssertEqualObjects([_cache objectForKey:@"key"], @"new");
+    XCTAssertTrue([self _waitFor:^BOOL{ return atomic_load(&YYTestLoadCount) == 2; }]);
+    dispatch_semaphore_signal(resume);
+    XCTAssertTrue([self _waitFor:^BOOL{ return cache.statistics.refreshes == 2; }]);
+}
+
+@end
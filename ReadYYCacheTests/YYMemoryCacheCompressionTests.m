@@ -0,0 +1,221 @@
+//
+//  YYMemoryCacheCompressionTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the LZ4 codec used by the cold compression of YYMemoryCache.
+//
+
+#import <XCTest/XCTest.h>
+#import <sys/mman.h>
+#import "YYMemoryCacheInternal.h"
+
+/// A buffer of `length` bytes which ends at an inaccessible page, so any read or
+/// write past its end crashes.
+typedef struct {
+    uint8_t *bytes;
+    void *base;
+    size_t size;
+} YYTestGuardedBuffer;
+
+static YYTestGuardedBuffer YYTestGuardedBufferCreate(const void *bytes, NSUInteger length) {
+    size_t page = (size_t)getpagesize();
+    size_t dataSize = (length + page - 1) / page * page;
+    YYTestGuardedBuffer buffer;
+    buffer.size = dataSize + page;
+    buffer.base = mmap(NULL, buffer.size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    mprotect((uint8_t *)buffer.base + dataSize, page, PROT_NONE);
+    buffer.bytes = (uint8_t *)buffer.base + dataSize - length;
+    if (bytes && length) memcpy(buffer.bytes, bytes, length);
+    return buffer;
+}
+
+static void YYTestGuardedBufferFree(YYTestGuardedBuffer buffer) {
+    munmap(buffer.base, buffer.size);
+}
+
+/// A deterministic pseudo random generator (xorshift64).
+static uint64_t YYTestRandom(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+
+@interface YYMemoryCacheCompressionTests : XCTestCase
+
+@end
+
+@implementation YYMemoryCacheCompressionTests
+
+/// Compresses the data into a buffer large enough for any input, checks both
+/// the decoder and `_YYCompressedDataInflate` give back the data, and returns
+/// the compressed block.
+- (NSData *)_roundTrip:(NSData *)data {
+    NSUInteger length = data.length, capacity = length + length / 255 + 16;
+    uint8_t *bytes = malloc(capacity);
+    NSUInteger compressedLength = _YYLZ4Compress(data.bytes, length, bytes, capacity);
+    XCTAssertGreaterThan(compressedLength, 0);
+    NSData *block = [NSData dataWithBytes:bytes length:compressedLength];
+
+    // 输入和输出的末尾都是不可访问的页，越界读写会崩溃
+    YYTestGuardedBuffer src = YYTestGuardedBufferCreate(bytes, compressedLength);
+    YYTestGuardedBuffer dst = YYTestGuardedBufferCreate(NULL, length);
+    XCTAssertTrue(_YYLZ4Decompress(src.bytes, compressedLength, dst.bytes, length));
+    XCTAssertEqual(memcmp(dst.bytes, data.bytes, length), 0);
+    YYTestGuardedBufferFree(src);
+    YYTestGuardedBufferFree(dst);
+
+    _YYCompressedData *compressed = _YYCompressedDataCreate(bytes, compressedLength, length);
+    XCTAssertEqualObjects(_YYCompressedDataInflate(compressed), data);
+    return block;
+}
+
+/// Returns whether the block is rejected by the decoder (with guarded buffers)
+/// and by `_YYCompressedDataInflate`.
+- (BOOL)_rejectsBlock:(NSData *)block length:(NSUInteger)length {
+    YYTestGuardedBuffer src = YYTestGuardedBufferCreate(block.bytes, block.length);
+    YYTestGuardedBuffer dst = YYTestGuardedBufferCreate(NULL, length);
+    BOOL decoded = _YYLZ4Decompress(src.bytes, block.length, dst.bytes, length);
+    YYTestGuardedBufferFree(src);
+    YYTestGuardedBufferFree(dst);
+
+    uint8_t *bytes = malloc(MAX(block.length, 1));
+    memcpy(bytes, block.bytes, block.length);
+    NSData *inflated = _YYCompressedDataInflate(_YYCompressedDataCreate(bytes, block.length, length));
+    return !decoded && !inflated;
+}
+
+#pragma mark - round trip
+
+- (void)testEmptyInput {
+    NSData *block = [self _roundTrip:[NSData data]];
+    // 只有一个没有字面量的token
+    XCTAssertEqual(block.length, 1);
+    XCTAssertEqual(((const uint8_t *)block.bytes)[0], 0);
+}
+
+- (void)testIncompressibleInput {
+    uint64_t state = 88172645463325252ULL;
+    NSMutableData *data = [NSMutableData dataWithLength:64 * 1024];
+    uint8_t *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < data.length; i++) bytes[i] = (uint8_t)YYTestRandom(&state);
+
+    // 冷数据压缩要求至少小 1/8，放不下时返回 0
+    NSUInteger capacity = data.length - data.length / 8;
+    uint8_t *dst = malloc(capacity);
+    XCTAssertEqual(_YYLZ4Compress(bytes, data.length, dst, capacity), 0);
+    free(dst);
+
+    NSData *block = [self _roundTrip:data];
+    XCTAssertLessThanOrEqual(block.length, data.length + data.length / 255 + 16);
+}
+
+- (void)testShortInputs {
+    uint64_t state = 1;
+    for (NSUInteger length = 1; length < 256; length++) {
+        NSMutableData *data = [NSMutableData dataWithLength:length];
+        uint8_t *bytes = data.mutableBytes;
+        for (NSUInteger i = 0; i < length; i++) bytes[i] = (length % 2) ? (uint8_t)YYTestRandom(&state) : (uint8_t)(i % 3);
+        [self _roundTrip:data];
+    }
+}
+
+- (void)testLongMatches {
+    // 匹配长度需要多个 255 扩展字节，偏移接近最大值 65535
+    NSMutableData *data = [NSMutableData dataWithLength:1024 * 1024];
+    [self _roundTrip:data];
+
+    uint64_t state = 7;
+    NSMutableData *pattern = [NSMutableData dataWithLength:60000];
+    uint8_t *bytes = pattern.mutableBytes;
+    for (NSUInteger i = 0; i < pattern.length; i++) bytes[i] = (uint8_t)YYTestRandom(&state);
+    NSMutableData *repeated = [NSMutableData data];
+    for (NSUInteger i = 0; i < 8; i++) [repeated appendData:pattern];
+    NSData *block = [self _roundTrip:repeated];
+    XCTAssertLessThan(block.length, pattern.length + pattern.length / 8);
+}
+
+- (void)testOverlappingCopies {
+    // 偏移小于匹配长度，需要逐字节复制
+    const uint8_t block[] = {0x26, 'a', 'b', 0x02, 0x00};
+    uint8_t dst[12];
+    XCTAssertTrue(_YYLZ4Decompress(block, sizeof(block), dst, sizeof(dst)));
+    XCTAssertEqual(memcmp(dst, "abababababab", sizeof(dst)), 0);
+
+    NSMutableData *data = [NSMutableData dataWithLength:10000];
+    uint8_t *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < data.length; i++) bytes[i] = "abc"[i % 3];
+    XCTAssertLessThan([self _roundTrip:data].length, 100);
+}
+
+#pragma mark - malformed input
+
+- (void)testMalformedBlocks {
+    struct {
+        uint8_t bytes[8];
+        NSUInteger length;   // block length
+        NSUInteger expected; // declared length of the original data
+    } blocks[] = {
+        {{0x50, 'a', 'b'}, 3, 5},             // literals past the end of block
+        {{0xF0}, 1, 40},                      // literal length extension missing
+        {{0xF0, 0xFF, 0xFF}, 3, 600},         // literal length extension truncated
+        {{0x10, 'a', 0x01}, 3, 5},            // offset truncated
+        {{0x10, 'a', 0x00, 0x00}, 4, 5},      // offset 0
+        {{0x10, 'a', 0x05, 0x00}, 4, 5},      // offset before the start of output
+        {{0x1F, 'a', 0x01, 0x00}, 4, 40},     // match length extension missing
+        {{0x1F, 'a', 0x01, 0x00, 0x14}, 5, 30}, // match past the end of output
+        {{0x30, 'a', 'b', 'c'}, 4, 2},        // literals past the end of output
+        {{0x30, 'a', 'b', 'c'}, 4, 4},        // output shorter than declared
+        {{0x00}, 1, 1},                       // empty output, declared 1 byte
+        {{0}, 0, 1},                          // empty block
+    };
+    for (NSUInteger i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+        NSData *block = [NSData dataWithBytes:blocks[i].bytes length:blocks[i].length];
+        XCTAssertTrue([self _rejectsBlock:block length:blocks[i].expected], @"block %lu", (unsigned long)i);
+    }
+
+    // 上面的块在声明正确的长度时是合法的
+    const uint8_t valid[] = {0x1F, 'a', 0x01, 0x00, 0x14};
+    uint8_t dst[40];
+    XCTAssertTrue(_YYLZ4Decompress(valid, sizeof(valid), dst, sizeof(dst)));
+}
+
+- (void)testTruncatedAndCorruptedBlocks {
+    uint64_t state = 3;
+    NSMutableData *data = [NSMutableData dataWithLength:4096];
+    uint8_t *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < data.length; i++) bytes[i] = (uint8_t)(YYTestRandom(&state) % 4);
+    NSData *block = [self _roundTrip:data];
+
+    // 截断的块总是缺少最后的字面量，一定被拒绝
+    for (NSUInteger length = 0; length < block.length; length++) {
+        XCTAssertTrue([self _rejectsBlock:[block subdataWithRange:NSMakeRange(0, length)] length:data.length], @"length %lu", (unsigned long)length);
+    }
+
+    // 随机修改的块可能被接受，但不能越界读写
+    for (NSUInteger i = 0; i < 2000; i++) {
+        NSMutableData *corrupted = [block mutableCopy];
+        uint8_t *b = corrupted.mutableBytes;
+        for (NSUInteger n = 0; n < 1 + i % 4; n++) b[YYTestRandom(&state) % corrupted.length] ^= (uint8_t)(1 + YYTestRandom(&state) % 255);
+        YYTestGuardedBuffer src = YYTestGuardedBufferCreate(corrupted.bytes, corrupted.length);
+        YYTestGuardedBuffer dst = YYTestGuardedBufferCreate(NULL, data.length);
+        _YYLZ4Decompress(src.bytes, corrupted.length, dst.bytes, data.length);
+        YYTestGuardedBufferFree(src);
+        YYTestGuardedBufferFree(dst);
+    }
+
+    // 随机字节
+    for (NSUInteger i = 0; i < 2000; i++) {
+        uint8_t garbage[64];
+        NSUInteger length = YYTestRandom(&state) % sizeof(garbage), outputLength = YYTestRandom(&state) % 257;
+        for (NSUInteger n = 0; n < length; n++) garbage[n] = (uint8_t)YYTestRandom(&state);
+        YYTestGuardedBuffer src = YYTestGuardedBufferCreate(garbage, length);
+        YYTestGuardedBuffer dst = YYTestGuardedBufferCreate(NULL, outputLength);
+        _YYLZ4Decompress(src.bytes, length, dst.bytes, outputLength);
+        YYTestGuardedBufferFree(src);
+        YYTestGuardedBufferFree(dst);
+    }
+}
+
+@end
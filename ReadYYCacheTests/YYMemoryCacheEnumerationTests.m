@@ -0,0 +1,161 @@
+//
+//  YYMemoryCacheEnumerationTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the cursor enumeration of YYMemoryCache, which copies a batch of
+//  entries under the shard's lock and invokes the block without lock, while the
+//  cache is mutated by the block or by other threads.
+//
+
+#import <XCTest/XCTest.h>
+#import <stdatomic.h>
+#import "YYMemoryCache.h"
+
+static const YYMemoryCacheEvictionPolicy YYTestPolicies[] = {
+    YYMemoryCacheEvictionPolicyLRU,
+    YYMemoryCacheEvictionPolicyCLOCK,
+    YYMemoryCacheEvictionPolicyBufferedLRU,
+    YYMemoryCacheEvictionPolicyTinyLFU,
+    YYMemoryCacheEvictionPolicyARC,
+    YYMemoryCacheEvictionPolicy2Q,
+    YYMemoryCacheEvictionPolicyS3FIFO,
+};
+#define YYTestPolicyCount (sizeof(YYTestPolicies) / sizeof(YYTestPolicies[0]))
+#define YYTestKeyCount 1000
+
+static _Atomic(BOOL) YYTestWriterFinished;
+
+/// Whether the policy keeps a single list, so an object which is not accessed
+/// is never moved to a list which is not enumerated yet.
+static BOOL YYTestPolicyHasSingleList(YYMemoryCacheEvictionPolicy policy) {
+    return policy == YYMemoryCacheEvictionPolicyLRU || policy == YYMemoryCacheEvictionPolicyCLOCK || policy == YYMemoryCacheEvictionPolicyBufferedLRU;
+}
+
+static NSString *YYTestKey(NSUInteger i) {
+    return [NSString stringWithFormat:@"key%lu", (unsigned long)i];
+}
+
+
+@interface YYMemoryCacheEnumerationTests : XCTestCase
+
+@end
+
+@implementation YYMemoryCacheEnumerationTests
+
+- (void)testVisitEachObjectOnce {
+    for (NSUInteger p = 0; p < YYTestPolicyCount; p++) {
+        YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:0 shardCount:4 evictionPolicy:YYTestPolicies[p]];
+        for (NSUInteger i = 0; i < YYTestKeyCount; i++) [cache setObject:@(i) forKey:YYTestKey(i)];
+        // 部分key被访问过，分段策略的节点分布在多个链表中
+        for (NSUInteger i = 0; i < YYTestKeyCount; i += 3) [cache objectForKey:YYTestKey(i)];
+
+        NSCountedSet *visited = [NSCountedSet set];
+        [cache enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+            XCTAssertEqualObjects(key, YYTestKey([obj unsignedIntegerValue]));
+            [visited addObject:key];
+        }];
+        XCTAssertEqual(visited.count, YYTestKeyCount, @"policy %lu", (unsigned long)YYTestPolicies[p]);
+        for (id key in visited) XCTAssertEqual([visited countForObject:key], 1);
+    }
+}
+
+- (void)testMutateInBlock {
+    for (NSUInteger p = 0; p < YYTestPolicyCount; p++) {
+        YYMemoryCacheEvictionPolicy policy = YYTestPolicies[p];
+        YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:0 shardCount:4 evictionPolicy:policy];
+        for (NSUInteger i = 0; i < YYTestKeyCount; i++) [cache setObject:@(i) forKey:YYTestKey(i)];
+
+        // 在block中删除、访问、更新和添加对象 (锁在block外，不会死锁)
+        // i % 5 == 0 或 4 的key不被修改
+        NSCountedSet *visited = [NSCountedSet set];
+        __block NSUInteger step = 0, added = 0;
+        [cache enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+            [visited addObject:key];
+            NSUInteger i = [obj isKindOfClass:[NSNumber class]] ? [obj unsignedIntegerValue] : NSNotFound;
+            if (i != NSNotFound && i % 5 == 1) [cache removeObjectForKey:key];
+            NSUInteger target = step * 5 % YYTestKeyCount;
+            [cache removeObjectForKey:YYTestKey(target + 1)];
+            [cache objectForKey:YYTestKey(target + 2)];
+            [cache setObject:[NSString stringWithFormat:@"updated%lu", (unsigned long)(target + 3)] forKey:YYTestKey(target + 3)];
+            if (step < 300) {
+                [cache setObject:@"new" forKey:[NSString stringWithFormat:@"new%lu", (unsigned long)step]];
+                added++;
+            }
+            step++;
+        }];
+
+        if (YYTestPolicyHasSingleList(policy)) {
+            // 被访问、更新和新加入的节点移到链表头部，在游标之前，不会重复遍历
+            for (NSUInteger i = 0; i < YYTestKeyCount; i += 5) {
+                XCTAssertEqual([visited countForObject:YYTestKey(i)], 1, @"policy %lu key %lu", (unsigned long)policy, (unsigned long)i);
+                XCTAssertEqual([visited countForObject:YYTestKey(i + 4)], 1, @"policy %lu key %lu", (unsigned long)policy, (unsigned long)(i + 4));
+            }
+            for (id key in visited) XCTAssertEqual([visited countForObject:key], 1, @"policy %lu key %@", (unsigned long)policy, key);
+        } else {
+            // 分段策略可能把未访问的节点移到还没遍历的链表 (TinyLFU 的窗口区溢出)
+            for (NSUInteger i = 0; i < YYTestKeyCount; i += 5) {
+                XCTAssertLessThanOrEqual([visited countForObject:YYTestKey(i)], 2);
+                XCTAssertLessThanOrEqual([visited countForObject:YYTestKey(i + 4)], 2);
+            }
+        }
+        XCTAssertEqual(cache.totalCount, YYTestKeyCount - YYTestKeyCount / 5 + added, @"policy %lu", (unsigned long)policy);
+
+        // 遍历结束后游标已注销，再次遍历得到当前的全部对象
+        __block NSUInteger count = 0;
+        [cache enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+            count++;
+        }];
+        XCTAssertEqual(count, cache.totalCount);
+    }
+}
+
+- (void)testRemoveAllInBlockAndStop {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:4];
+    for (NSUInteger i = 0; i < YYTestKeyCount; i++) [cache setObject:@(i) forKey:YYTestKey(i)];
+    // 清空后只剩下已经拷贝的一批 (每批最多 64 个)
+    __block NSUInteger count = 0;
+    [cache enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+        if (count++ == 0) [cache removeAllObjects];
+    }];
+    XCTAssertLessThanOrEqual(count, 64);
+    XCTAssertEqual(cache.totalCount, 0);
+
+    for (NSUInteger i = 0; i < YYTestKeyCount; i++) [cache setObject:@(i) forKey:YYTestKey(i)];
+    count = 0;
+    [cache enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+        if (++count == 10) *stop = YES;
+    }];
+    XCTAssertEqual(count, 10);
+}
+
+- (void)testMutateConcurrently {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:0 shardCount:4 evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+    for (NSUInteger i = 0; i < YYTestKeyCount * 10; i++) [cache setObject:@(i) forKey:YYTestKey(i)];
+
+    // 另一个线程不断写入和删除其它key，不访问被遍历的key
+    atomic_store(&YYTestWriterFinished, NO);
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for (NSUInteger n = 0; !atomic_load(&YYTestWriterFinished); n++) {
+            NSString *key = [NSString stringWithFormat:@"other%lu", (unsigned long)(n % 2000)];
+            if (n % 3 == 2) [cache removeObjectForKey:key];
+            else [cache setObject:@(n) forKey:key];
+        }
+    });
+
+    for (NSUInteger round = 0; round < 5; round++) {
+        NSCountedSet *visited = [NSCountedSet set];
+        [cache enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+            [visited addObject:key];
+            if (visited.count % 100 == 0) usleep(100);
+        }];
+        for (NSUInteger i = 0; i < YYTestKeyCount * 10; i++) {
+            XCTAssertEqual([visited countForObject:YYTestKey(i)], 1, @"round %lu key %lu", (unsigned long)round, (unsigned long)i);
+        }
+        for (id key in visited) XCTAssertLessThanOrEqual([visited countForObject:key], 2);
+    }
+    atomic_store(&YYTestWriterFinished, YES);
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)), 0);
+}
+
+@end
@@ -0,0 +1,183 @@
+//
+//  YYMemoryCacheExpirationTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the per-object TTL of YYMemoryCache and its timing wheel, with a
+//  fake clock: expiration at each level of the wheel, the redistribution of
+//  higher levels, and catching up after a long idle time.
+//
+
+#import <XCTest/XCTest.h>
+#import <QuartzCore/QuartzCore.h>
+#import "YYMemoryCache.h"
+#import "YYMemoryCacheInternal.h"
+
+static NSTimeInterval YYTestTime;
+
+static NSTimeInterval YYTestClock(void) {
+    return YYTestTime;
+}
+
+/// A deterministic pseudo random generator (xorshift64).
+static uint64_t YYTestRandom(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+
+@interface YYMemoryCacheExpirationTests : XCTestCase
+
+@end
+
+@implementation YYMemoryCacheExpirationTests
+
+- (void)setUp {
+    [super setUp];
+    YYTestTime = 1000;
+    _YYMemoryCacheClock = YYTestClock;
+}
+
+- (void)tearDown {
+    _YYMemoryCacheClock = NULL;
+    [super tearDown];
+}
+
+/// A cache with one shard, so every write processes the wheel of all objects.
+- (YYMemoryCache *)_cache {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:1];
+    cache.autoTrimInterval = 3600; // 不让后台清理干扰
+    return cache;
+}
+
+/// Writes a key without TTL, which removes the expired objects in the shard.
+- (void)_touch:(YYMemoryCache *)cache {
+    [cache setObject:@"touch" forKey:@"touch"];
+}
+
+/// The number of objects except the touch key.
+- (NSUInteger)_countOf:(YYMemoryCache *)cache {
+    return cache.totalCount - ([cache containsObjectForKey:@"touch"] ? 1 : 0);
+}
+
+- (void)testExpireAtEachLevel {
+    // 第0层到第3层 (64^L 秒)，以及超出时间轮范围 (约 6 个月) 的TTL
+    NSTimeInterval ttls[] = {1, 10, 63, 64, 100, 4095, 4096, 5000, 262143, 262144, 300000, 16777215, 16777216, 20000000};
+    for (NSUInteger i = 0; i < sizeof(ttls) / sizeof(ttls[0]); i++) {
+        YYTestTime = 1000;
+        YYMemoryCache *cache = [self _cache];
+        [cache setObject:@"value" forKey:@"key" withCost:3 ttl:ttls[i]];
+        [self _touch:cache];
+        XCTAssertEqual([self _countOf:cache], 1);
+
+        // 到期前一秒仍然存在，高层的桶被逐层重新分配
+        YYTestTime = 1000 + ttls[i] - 1;
+        [self _touch:cache];
+        XCTAssertEqualObjects([cache objectForKey:@"key"], @"value", @"ttl %.0f", ttls[i]);
+        XCTAssertEqual([self _countOf:cache], 1, @"ttl %.0f", ttls[i]);
+
+        // 到期后被时间轮移除 (先写入，读取过期对象也会移除它)
+        YYTestTime = 1000 + ttls[i];
+        [self _touch:cache];
+        XCTAssertEqual([self _countOf:cache], 0, @"ttl %.0f", ttls[i]);
+        XCTAssertEqual(cache.totalCost, 0);
+        XCTAssertEqual(cache.statistics.ageEvictions, 1);
+        XCTAssertNil([cache objectForKey:@"key"], @"ttl %.0f", ttls[i]);
+    }
+}
+
+- (void)testUpdateAndRemoveTTL {
+    YYMemoryCache *cache = [self _cache];
+    [cache setObject:@"a" forKey:@"a" withCost:0 ttl:100];
+    [cache setObject:@"b" forKey:@"b" withCost:0 ttl:100];
+    [cache setObject:@"c" forKey:@"c" withCost:0 ttl:100];
+
+    // 更新TTL时从原来的桶中移除，没有TTL的写入也移除
+    [cache setObject:@"a" forKey:@"a" withCost:0 ttl:5000];
+    [cache setObject:@"b" forKey:@"b"];
+    [cache removeObjectForKey:@"c"];
+    YYTestTime = 1000 + 200;
+    [self _touch:cache];
+    XCTAssertEqualObjects([cache objectForKey:@"a"], @"a");
+    XCTAssertEqualObjects([cache objectForKey:@"b"], @"b");
+    XCTAssertEqual([self _countOf:cache], 2);
+
+    YYTestTime = 1000 + 5000;
+    [self _touch:cache];
+    XCTAssertNil([cache objectForKey:@"a"]);
+    XCTAssertEqual([self _countOf:cache], 1);
+
+    // 清空后时间轮仍然可用
+    [cache setObject:@"d" forKey:@"d" withCost:0 ttl:10];
+    [cache removeAllObjects];
+    [cache setObject:@"e" forKey:@"e" withCost:0 ttl:10];
+    YYTestTime += 10;
+    [self _touch:cache];
+    XCTAssertEqual([self _countOf:cache], 0);
+}
+
+- (void)testStaggeredExpiration {
+    // 各层的TTL混合，时钟按不同步长推进，每一步存活的对象必须和到期时间一致
+    const NSUInteger count = 2000;
+    YYMemoryCache *cache = [self _cache];
+    NSTimeInterval *expires = malloc(count * sizeof(NSTimeInterval));
+    uint64_t state = 88172645463325252ULL;
+    for (NSUInteger i = 0; i < count; i++) {
+        uint64_t level = YYTestRandom(&state) % 4;
+        NSTimeInterval ttl = 1 + YYTestRandom(&state) % (64ULL << (6 * level));
+        expires[i] = YYTestTime + ttl;
+        [cache setObject:@(i) forKey:@(i) withCost:0 ttl:ttl];
+    }
+    NSTimeInterval end = YYTestTime + (64ULL << 18);
+    while (YYTestTime < end) {
+        uint64_t r = YYTestRandom(&state) % 8;
+        YYTestTime += (r < 4) ? 1 + r : (r < 6) ? 61 : (r < 7) ? 4099 : 70000;
+        [self _touch:cache];
+        NSUInteger alive = 0;
+        for (NSUInteger i = 0; i < count; i++) {
+            if (expires[i] > YYTestTime) alive++;
+        }
+        XCTAssertEqual([self _countOf:cache], alive, @"time %.0f", YYTestTime);
+        if ([self _countOf:cache] != alive) break;
+    }
+    XCTAssertEqual([self _countOf:cache], 0);
+    XCTAssertEqual(cache.statistics.ageEvictions, count);
+    free(expires);
+}
+
+- (void)testCatchUpAfterIdle {
+    // 长时间空闲后跳过空的tick，不会逐秒推进 (一年约 3000 万个tick)
+    YYMemoryCache *cache = [self _cache];
+    for (NSUInteger i = 0; i < 64; i++) {
+        [cache setObject:@(i) forKey:@(i) withCost:0 ttl:1 + i * 300000];
+    }
+    YYTestTime = 1000 + 365 * 24 * 3600;
+    CFTimeInterval begin = CACurrentMediaTime();
+    [self _touch:cache];
+    CFTimeInterval elapsed = CACurrentMediaTime() - begin;
+    XCTAssertEqual([self _countOf:cache], 0);
+    XCTAssertLessThan(elapsed, 0.5);
+
+    // 空闲之后新的TTL仍然准确
+    [cache setObject:@"a" forKey:@"a" withCost:0 ttl:30];
+    YYTestTime += 29;
+    [self _touch:cache];
+    XCTAssertEqual([self _countOf:cache], 1);
+    YYTestTime += 1;
+    [self _touch:cache];
+    XCTAssertEqual([self _countOf:cache], 0);
+
+    // 一个很远的对象不会让空闲的时间轮逐秒推进
+    [cache setObject:@"far" forKey:@"far" withCost:0 ttl:20000000];
+    YYTestTime += 10000000;
+    begin = CACurrentMediaTime();
+    [self _touch:cache];
+    XCTAssertLessThan(CACurrentMediaTime() - begin, 0.5);
+    XCTAssertEqual([self _countOf:cache], 1);
+    YYTestTime += 10000000;
+    [self _touch:cache];
+    XCTAssertEqual([self _countOf:cache], 0);
+}
+
+@end
@@ -0,0 +1,143 @@
+//
+//  YYMemoryCacheIntegerKeyTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the integer keys of YYMemoryCache: the key is identified by its
+//  mixed hash only, and is a different key from any object key.
+//
+
+#import <XCTest/XCTest.h>
+#import "YYMemoryCache.h"
+#import "YYCacheHotKeys.h"
+
+static const YYMemoryCacheEvictionPolicy YYTestPolicies[] = {
+    YYMemoryCacheEvictionPolicyLRU,
+    YYMemoryCacheEvictionPolicyCLOCK,
+    YYMemoryCacheEvictionPolicyBufferedLRU,
+    YYMemoryCacheEvictionPolicyTinyLFU,
+    YYMemoryCacheEvictionPolicyARC,
+    YYMemoryCacheEvictionPolicy2Q,
+    YYMemoryCacheEvictionPolicyS3FIFO,
+};
+#define YYTestPolicyCount (sizeof(YYTestPolicies) / sizeof(YYTestPolicies[0]))
+
+/// A deterministic pseudo random generator (xorshift64).
+static uint64_t YYTestRandom(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/// Returns sequential keys, random keys and the edge values of uint64_t.
+static NSArray<NSNumber *> *YYTestIntegerKeys(void) {
+    NSMutableOrderedSet *keys = [NSMutableOrderedSet orderedSet];
+    const uint64_t edges[] = {0, 1, 2, UINT32_MAX, (uint64_t)UINT32_MAX + 1, 1ULL << 63, UINT64_MAX - 1, UINT64_MAX};
+    for (NSUInteger i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) [keys addObject:@(edges[i])];
+    for (uint64_t i = 0; i < 2000; i++) [keys addObject:@(i << 32)];
+    uint64_t state = 88172645463325252ULL;
+    for (NSUInteger i = 0; i < 2000; i++) [keys addObject:@(YYTestRandom(&state))];
+    return keys.array;
+}
+
+
+@interface YYMemoryCacheIntegerKeyTests : XCTestCase
+
+@end
+
+@implementation YYMemoryCacheIntegerKeyTests
+
+- (void)testGetSetRemove {
+    NSArray<NSNumber *> *keys = YYTestIntegerKeys();
+    for (NSUInteger p = 0; p < YYTestPolicyCount; p++) {
+        for (NSUInteger capacity = 0; capacity <= 8192; capacity += 8192) {
+            YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:capacity shardCount:8 evictionPolicy:YYTestPolicies[p]];
+            NSUInteger cost = 0;
+            for (NSUInteger i = 0; i < keys.count; i++) {
+                [cache setObject:keys[i] forIntegerKey:keys[i].unsignedLongLongValue withCost:i % 7];
+                cost += i % 7;
+            }
+            XCTAssertEqual(cache.totalCount, keys.count, @"policy %lu", (unsigned long)YYTestPolicies[p]);
+            XCTAssertEqual(cache.totalCost, cost);
+            for (NSNumber *key in keys) {
+                XCTAssertTrue([cache containsObjectForIntegerKey:key.unsignedLongLongValue]);
+                XCTAssertEqualObjects([cache objectForIntegerKey:key.unsignedLongLongValue], key);
+            }
+
+            // 移除一半，另一半不受影响
+            for (NSUInteger i = 0; i < keys.count; i += 2) [cache removeObjectForIntegerKey:keys[i].unsignedLongLongValue];
+            for (NSUInteger i = 0; i < keys.count; i++) {
+                id object = [cache objectForIntegerKey:keys[i].unsignedLongLongValue];
+                if (i % 2) XCTAssertEqualObjects(object, keys[i]);
+                else XCTAssertNil(object, @"key %@", keys[i]);
+            }
+            XCTAssertEqual(cache.totalCount, keys.count / 2);
+
+            // 更新值和开销
+            [cache setObject:@"updated" forIntegerKey:UINT64_MAX withCost:100];
+            XCTAssertEqualObjects([cache objectForIntegerKey:UINT64_MAX], @"updated");
+            [cache setObject:nil forIntegerKey:UINT64_MAX];
+            XCTAssertFalse([cache containsObjectForIntegerKey:UINT64_MAX]);
+            [cache removeAllObjects];
+            XCTAssertEqual(cache.totalCount, 0);
+            XCTAssertNil([cache objectForIntegerKey:0]);
+        }
+    }
+}
+
+- (void)testIntegerKeysAreNotObjectKeys {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:4];
+    [cache setObject:@"integer" forIntegerKey:1];
+    [cache setObject:@"number" forKey:@1];
+    [cache setObject:@"string" forKey:@"1"];
+    XCTAssertEqual(cache.totalCount, 3);
+    XCTAssertEqualObjects([cache objectForIntegerKey:1], @"integer");
+    XCTAssertEqualObjects([cache objectForKey:@1], @"number");
+    XCTAssertEqualObjects([cache objectForKey:@"1"], @"string");
+
+    [cache removeObjectForKey:@1];
+    XCTAssertEqualObjects([cache objectForIntegerKey:1], @"integer");
+    [cache removeObjectForIntegerKey:1];
+    XCTAssertEqualObjects([cache objectForKey:@"1"], @"string");
+    XCTAssertFalse([cache containsObjectForIntegerKey:1]);
+    XCTAssertEqual(cache.totalCount, 1);
+}
+
+- (void)testEnumerationPassesNumbers {
+    NSArray<NSNumber *> *keys = YYTestIntegerKeys();
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:8];
+    for (NSNumber *key in keys) [cache setObject:key forIntegerKey:key.unsignedLongLongValue];
+    [cache setObject:@"object" forKey:@"object"];
+
+    // 整数key被还原为NSNumber
+    NSMutableSet *visited = [NSMutableSet set];
+    [cache enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+        if ([key isEqual:@"object"]) return;
+        XCTAssertTrue([key isKindOfClass:[NSNumber class]]);
+        XCTAssertEqualObjects(key, obj);
+        [visited addObject:key];
+    }];
+    XCTAssertEqualObjects(visited, [NSSet setWithArray:keys]);
+}
+
+- (void)testLimitsAndTracking {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:4];
+    cache.hotKeyTracker = [[YYCacheHotKeyTracker alloc] initWithCapacity:4];
+    for (uint64_t i = 0; i < 100; i++) [cache setObject:@(i) forIntegerKey:i withCost:10];
+    for (NSUInteger n = 0; n < 50; n++) XCTAssertNotNil([cache objectForIntegerKey:7]);
+    XCTAssertEqual(cache.statistics.hits, 50);
+    XCTAssertNil([cache objectForIntegerKey:1000]);
+    XCTAssertEqual(cache.statistics.misses, 1);
+
+    // 热点key以NSNumber报告
+    XCTAssertEqualObjects([cache.hotKeyTracker hotKeys:1 reset:NO].firstObject.key, @7);
+
+    // 整数key和对象key共享开销和数量限制
+    [cache trimToCost:500];
+    XCTAssertEqual(cache.totalCost, 500);
+    XCTAssertEqual(cache.totalCount, 50);
+    [cache trimToCount:10];
+    XCTAssertEqual(cache.totalCount, 10);
+}
+
+@end
@@ -0,0 +1,162 @@
+//
+//  YYMemoryCacheReclaimerTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the reclaimer thread which releases the removed objects of
+//  YYMemoryCache: every pushed pair is released exactly once, by the reclaimer
+//  or inline by the producer when the queue is full.
+//
+
+#import <XCTest/XCTest.h>
+#import <stdatomic.h>
+#import "YYMemoryCacheInternal.h"
+
+#define YYTestProducerCount 4
+#define YYTestPairsPerProducer _YYReclaimerQueueSize
+
+static _Atomic(uint8_t) *YYTestReleaseFlags; // release count of each object
+static _Atomic(NSUInteger) YYTestReleasedCount;
+static _Atomic(NSUInteger) YYTestInlineReleasedCount;
+static __thread BOOL YYTestIsProducer;
+static dispatch_semaphore_t YYTestBlockerStarted;
+static dispatch_semaphore_t YYTestBlockerResume;
+
+/// Records its release, and whether it's released by a producer thread.
+@interface YYTestReleaseCounter : NSObject {
+    NSUInteger _index;
+}
+- (instancetype)initWithIndex:(NSUInteger)index;
+@end
+
+@implementation YYTestReleaseCounter
+
+- (instancetype)initWithIndex:(NSUInteger)index {
+    self = [super init];
+    _index = index;
+    return self;
+}
+
+- (void)dealloc {
+    atomic_fetch_add(&YYTestReleaseFlags[_index], 1);
+    if (YYTestIsProducer) atomic_fetch_add(&YYTestInlineReleasedCount, 1);
+    atomic_fetch_add(&YYTestReleasedCount, 1);
+}
+
+@end
+
+/// Blocks the releasing thread until `YYTestBlockerResume` is signaled.
+@interface YYTestBlockingObject : NSObject
+@end
+
+@implementation YYTestBlockingObject
+
+- (void)dealloc {
+    dispatch_semaphore_signal(YYTestBlockerStarted);
+    dispatch_semaphore_wait(YYTestBlockerResume, DISPATCH_TIME_FOREVER);
+}
+
+@end
+
+
+@interface YYMemoryCacheReclaimerTests : XCTestCase
+
+@end
+
+@implementation YYMemoryCacheReclaimerTests
+
+- (void)setUp {
+    [super setUp];
+    NSUInteger count = YYTestProducerCount * YYTestPairsPerProducer * 2;
+    YYTestReleaseFlags = calloc(count, sizeof(_Atomic(uint8_t)));
+    atomic_store(&YYTestReleasedCount, 0);
+    atomic_store(&YYTestInlineReleasedCount, 0);
+    YYTestBlockerStarted = dispatch_semaphore_create(0);
+    YYTestBlockerResume = dispatch_semaphore_create(0);
+}
+
+- (void)tearDown {
+    free(YYTestReleaseFlags);
+    YYTestReleaseFlags = NULL;
+    [super tearDown];
+}
+
+/// Pushes `YYTestPairsPerProducer` pairs from each producer thread, every 4th
+/// pair has no key (as an integer key).
+- (void)_pushPairsConcurrently {
+    dispatch_apply(YYTestProducerCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t producer) {
+        YYTestIsProducer = YES;
+        for (NSUInteger i = 0; i < YYTestPairsPerProducer; i++) {
+            NSUInteger index = (producer * YYTestPairsPerProducer + i) * 2;
+            _YYLinkedMapEntry entry;
+            entry.key = (i % 4 == 0) ? NULL : CFBridgingRetain([[YYTestReleaseCounter alloc] initWithIndex:index]);
+            entry.value = CFBridgingRetain([[YYTestReleaseCounter alloc] initWithIndex:index + 1]);
+            if (!entry.key) atomic_fetch_add(&YYTestReleaseFlags[index], 1); // counted as released
+            _YYReclaimerRelease(entry);
+        }
+        YYTestIsProducer = NO;
+    });
+}
+
+/// Waits until `count` objects are released, returns NO on timeout.
+- (BOOL)_waitForReleasedCount:(NSUInteger)count {
+    for (NSUInteger i = 0; i < 1000 && atomic_load(&YYTestReleasedCount) < count; i++) usleep(10 * 1000);
+    return atomic_load(&YYTestReleasedCount) >= count;
+}
+
+/// Returns the number of pairs whose key and value are not released exactly once.
+- (NSUInteger)_badReleaseCount {
+    NSUInteger bad = 0;
+    for (NSUInteger i = 0; i < YYTestProducerCount * YYTestPairsPerProducer * 2; i++) {
+        if (atomic_load(&YYTestReleaseFlags[i]) != 1) bad++;
+    }
+    return bad;
+}
+
+/// The number of objects pushed by `_pushPairsConcurrently`.
+- (NSUInteger)_pushedObjectCount {
+    return YYTestProducerCount * YYTestPairsPerProducer * 2 - YYTestProducerCount * YYTestPairsPerProducer / 4;
+}
+
+- (void)testMultipleProducers {
+    [self _pushPairsConcurrently];
+    XCTAssertTrue([self _waitForReleasedCount:[self _pushedObjectCount]]);
+    // 给可能的重复释放一点时间
+    usleep(100 * 1000);
+    XCTAssertEqual(atomic_load(&YYTestReleasedCount), [self _pushedObjectCount]);
+    XCTAssertEqual([self _badReleaseCount], 0);
+}
+
+- (void)testQueueFull {
+    // 回收线程在释放这个对象时阻塞，队列被填满
+    _YYLinkedMapEntry blocker = {NULL, CFBridgingRetain([YYTestBlockingObject new])};
+    _YYReclaimerRelease(blocker);
+    XCTAssertEqual(dispatch_semaphore_wait(YYTestBlockerStarted, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)), 0);
+
+    [self _pushPairsConcurrently];
+    // 回收线程阻塞期间，队列装不下的pair都由生产者线程释放
+    NSUInteger pushed = [self _pushedObjectCount];
+    NSUInteger inlineCount = atomic_load(&YYTestInlineReleasedCount);
+    XCTAssertEqual(atomic_load(&YYTestReleasedCount), inlineCount);
+    XCTAssertGreaterThanOrEqual(inlineCount, pushed - _YYReclaimerQueueSize * 2);
+    XCTAssertLessThan(inlineCount, pushed);
+
+    // 恢复后队列中剩下的pair由回收线程释放
+    dispatch_semaphore_signal(YYTestBlockerResume);
+    XCTAssertTrue([self _waitForReleasedCount:pushed]);
+    usleep(100 * 1000);
+    XCTAssertEqual(atomic_load(&YYTestReleasedCount), pushed);
+    XCTAssertEqual(atomic_load(&YYTestInlineReleasedCount), inlineCount);
+    XCTAssertEqual([self _badReleaseCount], 0);
+
+    // 队列清空后，新的pair重新交给回收线程
+    atomic_store(&YYTestReleasedCount, 0);
+    atomic_store(&YYTestInlineReleasedCount, 0);
+    memset(YYTestReleaseFlags, 0, YYTestProducerCount * YYTestPairsPerProducer * 2 * sizeof(_Atomic(uint8_t)));
+    [self _pushPairsConcurrently];
+    XCTAssertTrue([self _waitForReleasedCount:pushed]);
+    usleep(100 * 1000);
+    XCTAssertEqual(atomic_load(&YYTestReleasedCount), pushed);
+    XCTAssertEqual([self _badReleaseCount], 0);
+}
+
+@end
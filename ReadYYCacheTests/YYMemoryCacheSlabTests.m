@@ -0,0 +1,188 @@
+//
+//  YYMemoryCacheSlabTests.m
+//  ReadYYCacheTests
+//
+//  Tests of the slab store of YYMemoryCache (`setData:forKey:`): the rounding
+//  to size classes, the reuse and release of pages, and the cold compression of
+//  the values which are inflated back into the slab.
+//
+
+#import <XCTest/XCTest.h>
+#import "YYMemoryCache.h"
+#import "YYMemoryCacheInternal.h"
+
+#define YYTestPageSize (1 << 20)
+
+/// The chunk size of the slab class for the length, or 0 if it's larger than
+/// the max chunk size (same as `_YYSlabAllocator`).
+static NSUInteger YYTestChunkSize(NSUInteger length) {
+    NSUInteger size = 64;
+    while (size < length) {
+        if (size >= YYTestPageSize / 2) return 0;
+        size = MIN((size * 5 / 4 + 15) & ~(NSUInteger)15, YYTestPageSize / 2);
+    }
+    return size;
+}
+
+/// Data of the length, compressible if `text` is YES.
+static NSData *YYTestData(NSUInteger length, BOOL text, uint8_t seed) {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    uint8_t *bytes = data.mutableBytes;
+    uint32_t state = 2463534242u + seed;
+    for (NSUInteger i = 0; i < length; i++) {
+        if (text) {
+            bytes[i] = "{\"name\":\"value\",\"id\":12345}"[(i + seed) % 27];
+        } else {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            bytes[i] = (uint8_t)state;
+        }
+    }
+    return data;
+}
+
+
+@interface YYMemoryCacheSlabTests : XCTestCase
+
+@end
+
+@implementation YYMemoryCacheSlabTests
+
+/// A cache which releases the values synchronously, so the chunks are freed
+/// when the objects are removed.
+- (YYMemoryCache *)_cache {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:0 shardCount:1 evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+    cache.releaseAsynchronously = NO;
+    cache.autoTrimInterval = 3600; // 不让后台清理干扰
+    return cache;
+}
+
+/// Waits until the condition is true, returns NO on timeout.
+- (BOOL)_waitFor:(BOOL (^)(void))condition {
+    for (NSUInteger i = 0; i < 500 && !condition(); i++) usleep(10 * 1000);
+    return condition();
+}
+
+- (void)testSizeClassRounding {
+    XCTAssertEqual(YYTestChunkSize(1), 64);
+    XCTAssertEqual(YYTestChunkSize(65), 80);
+    XCTAssertEqual(YYTestChunkSize(81), 112);
+    XCTAssertEqual(YYTestChunkSize(512 * 1024), 512 * 1024);
+    XCTAssertEqual(YYTestChunkSize(512 * 1024 + 1), 0);
+
+    const NSUInteger lengths[] = {0, 1, 63, 64, 65, 80, 81, 100, 255, 256, 1000, 4096, 4097, 100000, 512 * 1024 - 1, 512 * 1024, 512 * 1024 + 1, 600 * 1024};
+    for (NSUInteger i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        @autoreleasepool {
+            YYMemoryCache *cache = [self _cache];
+            NSData *data = YYTestData(lengths[i], NO, (uint8_t)i);
+            [cache setData:data forKey:@"key"];
+            // 开销是chunk的大小，超过最大的chunk时是数据的长度
+            NSUInteger chunk = YYTestChunkSize(lengths[i]);
+            XCTAssertEqual(cache.totalCost, chunk ?: lengths[i], @"length %lu", (unsigned long)lengths[i]);
+            XCTAssertEqual(cache.totalSlabBytes, chunk ? YYTestPageSize : 0, @"length %lu", (unsigned long)lengths[i]);
+
+            NSData *value = [cache objectForKey:@"key"];
+            XCTAssertEqualObjects(value, data);
+            XCTAssertTrue(value != data);
+            if (chunk) XCTAssertEqualObjects(NSStringFromClass(value.class), @"_YYSlabData");
+
+            // 更新后开销随新的chunk变化
+            [cache setData:YYTestData(lengths[i] + 200, NO, 0) forKey:@"key"];
+            XCTAssertEqual(cache.totalCost, YYTestChunkSize(lengths[i] + 200) ?: lengths[i] + 200);
+        }
+    }
+}
+
+- (void)testPageReuse {
+    YYMemoryCache *cache = [self _cache];
+    const NSUInteger length = 1000, chunk = YYTestChunkSize(length), perPage = YYTestPageSize / chunk;
+    const NSUInteger count = perPage * 3;
+    @autoreleasepool {
+        for (NSUInteger i = 0; i < count; i++) [cache setData:YYTestData(length, NO, (uint8_t)i) forKey:@(i)];
+    }
+    XCTAssertEqual(cache.totalCost, count * chunk);
+    XCTAssertEqual(cache.totalSlabBytes, 3 * YYTestPageSize);
+
+    // 每页删除一部分：页不会被释放，空出的chunk被下一批值复用
+    for (NSUInteger i = 0; i < count; i += 2) [cache removeObjectForKey:@(i)];
+    XCTAssertEqual(cache.totalSlabBytes, 3 * YYTestPageSize);
+    @autoreleasepool {
+        for (NSUInteger i = 0; i < count; i += 2) [cache setData:YYTestData(length, NO, (uint8_t)i) forKey:@(i)];
+    }
+    XCTAssertEqual(cache.totalSlabBytes, 3 * YYTestPageSize);
+    for (NSUInteger i = 0; i < count; i++) {
+        @autoreleasepool {
+            XCTAssertEqualObjects([cache objectForKey:@(i)], YYTestData(length, NO, (uint8_t)i), @"key %lu", (unsigned long)i);
+        }
+    }
+
+    // 全部删除后空页被释放，每个class保留最后一页
+    [cache removeAllObjects];
+    XCTAssertTrue([self _waitFor:^BOOL{ return cache.totalSlabBytes == YYTestPageSize; }]);
+    @autoreleasepool {
+        for (NSUInteger i = 0; i < perPage; i++) [cache setData:YYTestData(length, NO, (uint8_t)i) forKey:@(i)];
+    }
+    XCTAssertEqual(cache.totalSlabBytes, YYTestPageSize);
+
+    // 不同的class使用各自的页
+    [cache setData:YYTestData(10, NO, 0) forKey:@"small"];
+    XCTAssertEqual(cache.totalSlabBytes, 2 * YYTestPageSize);
+
+    // 取出的值比缓存活得久，chunk在值释放时才归还
+    NSData *held = [cache objectForKey:@"small"];
+    [cache removeObjectForKey:@"small"];
+    XCTAssertEqualObjects(held, YYTestData(10, NO, 0));
+    XCTAssertEqual(cache.totalCost, perPage * chunk);
+
+    // 缓存释放后，值仍然有效
+    cache = nil;
+    XCTAssertEqualObjects(held, YYTestData(10, NO, 0));
+}
+
+- (void)testCompressColdData {
+    YYMemoryCache *cache = [self _cache];
+    const NSUInteger count = 8, length = 4096;
+    [cache setData:YYTestData(length, NO, 0) forKey:@"random"]; // 不可压缩
+    [cache setData:YYTestData(100, YES, 0) forKey:@"short"];    // 太短不压缩
+    for (NSUInteger i = 0; i < count; i++) {
+        @autoreleasepool {
+            [cache setData:YYTestData(length, YES, (uint8_t)i) forKey:@(i)];
+        }
+    }
+    NSUInteger chunk = YYTestChunkSize(length);
+    NSUInteger cost = count * chunk + chunk + YYTestChunkSize(100);
+    XCTAssertEqual(cache.totalCost, cost);
+    NSUInteger slabBytes = cache.totalSlabBytes;
+
+    // 压缩较冷的一半 (random、short、key 0~2)，开销按压缩率缩小
+    _YYMemoryCacheCompressColdData(cache);
+    XCTAssertLessThan(cache.totalCost, cost - 3 * chunk / 2);
+    XCTAssertEqual(cache.totalCount, count + 2);
+
+    // 命中时解压回slab，数据完整，恢复原来的开销
+    for (NSUInteger i = 0; i < count; i++) {
+        @autoreleasepool {
+            NSData *value = [cache objectForKey:@(i)];
+            XCTAssertEqualObjects(value, YYTestData(length, YES, (uint8_t)i), @"key %lu", (unsigned long)i);
+            XCTAssertEqualObjects(NSStringFromClass(value.class), @"_YYSlabData");
+            XCTAssertEqual(value.length, length);
+        }
+    }
+    XCTAssertEqualObjects([cache objectForKey:@"random"], YYTestData(length, NO, 0));
+    XCTAssertEqualObjects([cache objectForKey:@"short"], YYTestData(100, YES, 0));
+    XCTAssertEqual(cache.totalCost, cost);
+    XCTAssertEqual(cache.totalSlabBytes, slabBytes);
+
+    // 再次压缩和解压，数据仍然完整
+    _YYMemoryCacheCompressColdData(cache);
+    _YYMemoryCacheCompressColdData(cache);
+    for (NSUInteger i = 0; i < count; i++) {
+        @autoreleasepool {
+            XCTAssertEqualObjects([cache objectForKey:@(i)], YYTestData(length, YES, (uint8_t)i), @"key %lu", (unsigned long)i);
+        }
+    }
+    XCTAssertEqual(cache.totalCost, cost);
+}
+
+@end
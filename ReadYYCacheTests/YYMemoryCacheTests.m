@@ -0,0 +1,432 @@
+//
+//  YYMemoryCacheTests.m
+//  ReadYYCacheTests
+//
+//  Tests of YYMemoryCache: sharding with global limits, the slab nodes and
+//  hash table, and the eviction order of each policy.
+//
+
+#import <XCTest/XCTest.h>
+#import "YYMemoryCache.h"
+
+static const YYMemoryCacheEvictionPolicy YYTestPolicies[] = {
+    YYMemoryCacheEvictionPolicyLRU,
+    YYMemoryCacheEvictionPolicyCLOCK,
+    YYMemoryCacheEvictionPolicyBufferedLRU,
+    YYMemoryCacheEvictionPolicyTinyLFU,
+    YYMemoryCacheEvictionPolicyARC,
+    YYMemoryCacheEvictionPolicy2Q,
+    YYMemoryCacheEvictionPolicyS3FIFO,
+};
+#define YYTestPolicyCount (sizeof(YYTestPolicies) / sizeof(YYTestPolicies[0]))
+
+/// A key which doesn't conform to NSCopying, the cache should retain it.
+@interface YYTestUncopyableKey : NSObject {
+    @public
+    NSUInteger _identifier;
+}
+@end
+
+@implementation YYTestUncopyableKey
+
+- (NSUInteger)hash {
+    return _identifier;
+}
+
+- (BOOL)isEqual:(id)object {
+    return [object isKindOfClass:[YYTestUncopyableKey class]] && ((YYTestUncopyableKey *)object)->_identifier == _identifier;
+}
+
+@end
+
+@interface YYMemoryCacheTests : XCTestCase
+
+@end
+
+@implementation YYMemoryCacheTests
+
+/// Returns the number of keys in [from, to) which are (or aren't) in the cache.
+- (NSUInteger)_countIntegerKeysFrom:(uint64_t)from to:(uint64_t)to inCache:(YYMemoryCache *)cache contained:(BOOL)contained {
+    NSUInteger count = 0;
+    for (uint64_t i = from; i < to; i++) {
+        if ([cache containsObjectForIntegerKey:i] == contained) count++;
+    }
+    return count;
+}
+
+#pragma mark - get/set/remove
+
+- (void)testGetSetRemove {
+    for (NSUInteger p = 0; p < YYTestPolicyCount; p++) {
+        for (NSUInteger capacity = 0; capacity <= 64; capacity += 64) {
+            YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:capacity shardCount:4 evictionPolicy:YYTestPolicies[p]];
+            XCTAssertEqual(cache.evictionPolicy, YYTestPolicies[p]);
+            XCTAssertNil([cache objectForKey:@"a"]);
+
+            [cache setObject:@"1" forKey:@"a" withCost:5];
+            XCTAssertEqualObjects([cache objectForKey:@"a"], @"1");
+            XCTAssertTrue([cache containsObjectForKey:@"a"]);
+            XCTAssertEqual(cache.totalCount, 1);
+            XCTAssertEqual(cache.totalCost, 5);
+
+            // 更新值和开销
+            [cache setObject:@"2" forKey:@"a" withCost:7];
+            XCTAssertEqualObjects([cache objectForKey:@"a"], @"2");
+            XCTAssertEqual(cache.totalCount, 1);
+            XCTAssertEqual(cache.totalCost, 7);
+
+            // 整数key和对象key互不影响
+            [cache setObject:@"3" forIntegerKey:42 withCost:3];
+            XCTAssertEqualObjects([cache objectForIntegerKey:42], @"3");
+            XCTAssertNil([cache objectForKey:@42]);
+            XCTAssertEqual(cache.totalCount, 2);
+            XCTAssertEqual(cache.totalCost, 10);
+
+            [cache removeObjectForKey:@"a"];
+            XCTAssertNil([cache objectForKey:@"a"]);
+            XCTAssertFalse([cache containsObjectForKey:@"a"]);
+            [cache setObject:nil forIntegerKey:42];
+            XCTAssertNil([cache objectForIntegerKey:42]);
+            XCTAssertEqual(cache.totalCount, 0);
+            XCTAssertEqual(cache.totalCost, 0);
+
+            for (NSUInteger i = 0; i < 32; i++) [cache setObject:@(i) forKey:@(i).stringValue];
+            [cache removeAllObjects];
+            XCTAssertEqual(cache.totalCount, 0);
+            XCTAssertNil([cache objectForKey:@"0"]);
+        }
+    }
+}
+
+- (void)testBatchWithUncopyableKeys {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:0 shardCount:4 evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+    NSMutableArray *keys = [NSMutableArray array], *objects = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 16; i++) {
+        YYTestUncopyableKey *key = [YYTestUncopyableKey new];
+        key->_identifier = i;
+        [keys addObject:key];
+        [objects addObject:@(i)];
+    }
+    [cache setObjects:[objects subarrayWithRange:NSMakeRange(0, 8)] forKeys:[keys subarrayWithRange:NSMakeRange(0, 8)] costs:nil];
+    [cache setObject:@8 forKey:keys[8]];
+
+    // 返回的字典只retain键，不要求NSCopying
+    NSDictionary *dic = nil;
+    XCTAssertNoThrow(dic = [cache objectsForKeys:keys]);
+    XCTAssertEqual(dic.count, 9);
+    for (NSUInteger i = 0; i < 9; i++) {
+        XCTAssertEqualObjects(dic[keys[i]], objects[i]);
+        // 键是同一个对象，没有被复制
+        __block id stored = nil;
+        [dic enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+            if ([key isEqual:keys[i]]) stored = key;
+        }];
+        XCTAssertEqual(stored, keys[i]);
+    }
+    XCTAssertNil(dic[keys[9]]);
+    XCTAssertEqual([cache objectsForKeys:@[]].count, 0);
+}
+
+#pragma mark - sharding
+
+- (void)testShardCount {
+    XCTAssertEqual([[YYMemoryCache alloc] init].shardCount, 1);
+    XCTAssertEqual([[YYMemoryCache alloc] initWithShardCount:0].shardCount, 1);
+    XCTAssertEqual([[YYMemoryCache alloc] initWithShardCount:4].shardCount, 4);
+    XCTAssertEqual([[YYMemoryCache alloc] initWithShardCount:5].shardCount, 8);
+    XCTAssertEqual([[YYMemoryCache alloc] initWithShardCount:4096].shardCount, 1024);
+
+    // 固定容量向上取整到分片数的倍数
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:10 shardCount:4 evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+    XCTAssertEqual(cache.capacity, 12);
+    XCTAssertEqual(cache.countLimit, 12);
+}
+
+- (void)testShardedCountLimit {
+    for (NSUInteger p = 0; p < YYTestPolicyCount; p++) {
+        YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:4 evictionPolicy:YYTestPolicies[p]];
+        cache.countLimit = 100;
+        for (uint64_t i = 0; i < 1000; i++) {
+            [cache setObject:@(i) forIntegerKey:i];
+            // 每次写入后总数不超过所有分片共享的限制，刚写入的对象不会被淘汰
+            XCTAssertLessThanOrEqual(cache.totalCount, 100);
+            XCTAssertTrue([cache containsObjectForIntegerKey:i]);
+        }
+        XCTAssertEqual(cache.totalCount, 100);
+        XCTAssertEqual([self _countIntegerKeysFrom:0 to:1000 inCache:cache contained:YES], 100);
+
+        [cache trimToCount:10];
+        XCTAssertEqual(cache.totalCount, 10);
+    }
+}
+
+- (void)testShardedCostLimit {
+    for (NSUInteger p = 0; p < YYTestPolicyCount; p++) {
+        YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:4 evictionPolicy:YYTestPolicies[p]];
+        cache.costLimit = 1000;
+        for (uint64_t i = 0; i < 1000; i++) {
+            [cache setObject:@(i) forIntegerKey:i withCost:10];
+            XCTAssertLessThanOrEqual(cache.totalCost, 1000);
+        }
+        XCTAssertEqual(cache.totalCost, 1000);
+        XCTAssertEqual(cache.totalCount, 100);
+
+        [cache trimToCost:100];
+        XCTAssertEqual(cache.totalCost, 100);
+    }
+}
+
+- (void)testShardedCapacity {
+    for (NSUInteger p = 0; p < YYTestPolicyCount; p++) {
+        YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:100 shardCount:4 evictionPolicy:YYTestPolicies[p]];
+        for (uint64_t i = 0; i < 1000; i++) {
+            [cache setObject:@(i) forIntegerKey:i];
+            XCTAssertLessThanOrEqual(cache.totalCount, 100);
+        }
+        // 每个分片最多 capacity / shardCount 个对象
+        XCTAssertEqual(cache.totalCount, 100);
+        XCTAssertEqual([self _countIntegerKeysFrom:0 to:1000 inCache:cache contained:YES], 100);
+
+        // 固定容量时 costLimit 仍然有效
+        cache = [[YYMemoryCache alloc] initWithCapacity:100 shardCount:4 evictionPolicy:YYTestPolicies[p]];
+        cache.costLimit = 500;
+        for (uint64_t i = 0; i < 1000; i++) {
+            [cache setObject:@(i) forIntegerKey:i withCost:10];
+            XCTAssertLessThanOrEqual(cache.totalCost, 500);
+            XCTAssertTrue([cache containsObjectForIntegerKey:i]);
+        }
+        XCTAssertEqual(cache.totalCount, 50);
+    }
+}
+
+#pragma mark - slab nodes and hash table
+
+- (void)testLRUOrderAcrossSlabs {
+    // 节点分布在多个slab中 (每个slab 256 个节点)，链表通过索引连接
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:1];
+    for (uint64_t i = 0; i < 2000; i++) [cache setObject:@(i) forIntegerKey:i];
+    for (int64_t i = 1998; i >= 0; i -= 2) XCTAssertNotNil([cache objectForIntegerKey:i]);
+
+    // 奇数key最久未访问，先被淘汰
+    [cache trimToCount:1000];
+    for (uint64_t i = 0; i < 2000; i++) {
+        XCTAssertEqual([cache containsObjectForIntegerKey:i], (BOOL)(i % 2 == 0), @"key %llu", i);
+    }
+    // 偶数key按访问的顺序淘汰，最后访问的是 0
+    [cache trimToCount:500];
+    for (uint64_t i = 0; i < 2000; i += 2) {
+        XCTAssertEqual([cache containsObjectForIntegerKey:i], (BOOL)(i < 1000), @"key %llu", i);
+    }
+    XCTAssertEqual(cache.totalCount, 500);
+}
+
+- (void)testTableChurn {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithShardCount:1];
+    // 哈希表多次扩容
+    for (uint64_t i = 0; i < 10000; i++) {
+        [cache setObject:@(i) forIntegerKey:i];
+        [cache setObject:@(i) forKey:[NSString stringWithFormat:@"key%llu", i]];
+    }
+    XCTAssertEqual(cache.totalCount, 20000);
+    XCTAssertEqual([self _countIntegerKeysFrom:0 to:10000 inCache:cache contained:YES], 10000);
+
+    // 删除一半，留下删除标记
+    for (uint64_t i = 1; i < 10000; i += 2) {
+        [cache removeObjectForIntegerKey:i];
+        [cache removeObjectForKey:[NSString stringWithFormat:@"key%llu", i]];
+    }
+    XCTAssertEqual(cache.totalCount, 10000);
+
+    // 反复插入和删除新的key，删除标记累积后哈希表原地重建
+    for (uint64_t round = 0; round < 50; round++) {
+        uint64_t base = 100000 + round * 1000;
+        for (uint64_t i = base; i < base + 1000; i++) [cache setObject:@(i) forIntegerKey:i];
+        XCTAssertEqual([self _countIntegerKeysFrom:base to:base + 1000 inCache:cache contained:YES], 1000);
+        for (uint64_t i = base; i < base + 1000; i++) [cache removeObjectForIntegerKey:i];
+        XCTAssertEqual([self _countIntegerKeysFrom:base to:base + 1000 inCache:cache contained:NO], 1000);
+    }
+    XCTAssertEqual(cache.totalCount, 10000);
+
+    NSUInteger mismatches = 0;
+    for (uint64_t i = 0; i < 10000; i++) {
+        BOOL expected = i % 2 == 0;
+        if ([cache containsObjectForIntegerKey:i] != expected) mismatches++;
+        id value = [cache objectForKey:[NSString stringWithFormat:@"key%llu", i]];
+        if (expected ? ![value isEqual:@(i)] : value != nil) mismatches++;
+    }
+    XCTAssertEqual(mismatches, 0);
+}
+
+- (void)testCapacityChurn {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:1000 shardCount:1 evictionPolicy:YYMemoryCacheEvictionPolicyLRU];
+    // 节点被淘汰后复用
+    for (uint64_t i = 0; i < 20000; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertEqual(cache.totalCount, 1000);
+    XCTAssertEqual([self _countIntegerKeysFrom:19000 to:20000 inCache:cache contained:YES], 1000);
+    XCTAssertEqual([self _countIntegerKeysFrom:0 to:19000 inCache:cache contained:NO], 19000);
+
+    // 删除后的空闲节点先被使用，不淘汰
+    for (uint64_t i = 19000; i < 19500; i++) [cache removeObjectForIntegerKey:i];
+    for (uint64_t i = 30000; i < 30500; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertEqual(cache.totalCount, 1000);
+    XCTAssertEqual([self _countIntegerKeysFrom:19500 to:20000 inCache:cache contained:YES], 500);
+    XCTAssertEqual([self _countIntegerKeysFrom:30000 to:30500 inCache:cache contained:YES], 500);
+}
+
+#pragma mark - eviction order
+
+/**
+ A cache with one shard and capacity 4: set keys 0...3, read key 0, then set
+ key 4 and 5. Checks the key evicted by each write, then sets the first evicted
+ key again and checks the keys which survive a scan of new keys.
+ */
+- (void)_testEvictionPolicy:(YYMemoryCacheEvictionPolicy)policy hits:(NSUInteger)hits
+               firstEvicted:(uint64_t)first secondEvicted:(uint64_t)second
+               scanSurvivors:(NSArray<NSNumber *> *)survivors {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:4 shardCount:1 evictionPolicy:policy];
+    for (uint64_t i = 0; i < 4; i++) [cache setObject:@(i) forIntegerKey:i];
+    for (NSUInteger i = 0; i < hits; i++) XCTAssertNotNil([cache objectForIntegerKey:0]);
+
+    [cache setObject:@4 forIntegerKey:4];
+    XCTAssertEqual(cache.totalCount, 4);
+    for (uint64_t i = 0; i <= 4; i++) {
+        XCTAssertEqual([cache containsObjectForIntegerKey:i], (BOOL)(i != first), @"policy %lu key %llu", (unsigned long)policy, i);
+    }
+    [cache setObject:@5 forIntegerKey:5];
+    XCTAssertEqual(cache.totalCount, 4);
+    for (uint64_t i = 0; i <= 5; i++) {
+        XCTAssertEqual([cache containsObjectForIntegerKey:i], (BOOL)(i != first && i != second), @"policy %lu key %llu", (unsigned long)policy, i);
+    }
+    if (!survivors) return;
+
+    [cache setObject:@(first) forIntegerKey:first];
+    for (uint64_t i = 100; i < 108; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertEqual(cache.totalCount, 4);
+    for (NSNumber *key in survivors) {
+        XCTAssertTrue([cache containsObjectForIntegerKey:key.unsignedLongLongValue], @"policy %lu key %@", (unsigned long)policy, key);
+    }
+}
+
+- (void)testLRUEviction {
+    [self _testEvictionPolicy:YYMemoryCacheEvictionPolicyLRU hits:1 firstEvicted:1 secondEvicted:2 scanSurvivors:nil];
+}
+
+- (void)testCLOCKEviction {
+    // 被访问过的 0 得到第二次机会，引用位被清除
+    [self _testEvictionPolicy:YYMemoryCacheEvictionPolicyCLOCK hits:1 firstEvicted:1 secondEvicted:2 scanSurvivors:nil];
+}
+
+- (void)testBufferedLRUEviction {
+    // 读缓冲在下一次写入时回放
+    [self _testEvictionPolicy:YYMemoryCacheEvictionPolicyBufferedLRU hits:1 firstEvicted:1 secondEvicted:2 scanSurvivors:nil];
+}
+
+- (void)testTinyLFUEviction {
+    // 固定容量在写入前淘汰：候选者 2 与试用区尾部的 1 频率相同，被拒绝；之后的 3 同样被拒绝
+    [self _testEvictionPolicy:YYMemoryCacheEvictionPolicyTinyLFU hits:3 firstEvicted:2 secondEvicted:3 scanSurvivors:nil];
+}
+
+- (void)testTinyLFUAdmission {
+    // 窗口区: 3 2，试用区: 1 0，2 和 3 的频率较高
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:4 shardCount:1 evictionPolicy:YYMemoryCacheEvictionPolicyTinyLFU];
+    for (uint64_t i = 0; i < 4; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertNotNil([cache objectForIntegerKey:2]);
+    XCTAssertNotNil([cache objectForIntegerKey:2]);
+    XCTAssertNotNil([cache objectForIntegerKey:3]);
+
+    // 候选者 2 的频率高于试用区尾部的 0，进入试用区，淘汰 0
+    [cache setObject:@4 forIntegerKey:4];
+    XCTAssertEqual(cache.totalCount, 4);
+    XCTAssertEqual([self _countIntegerKeysFrom:1 to:5 inCache:cache contained:YES], 4);
+
+    // 候选者 3 的频率高于试用区尾部的 1，淘汰 1
+    [cache setObject:@5 forIntegerKey:5];
+    XCTAssertEqual(cache.totalCount, 4);
+    XCTAssertEqual([self _countIntegerKeysFrom:2 to:6 inCache:cache contained:YES], 4);
+
+    // 候选者 4 的频率低于试用区尾部的 2，被拒绝
+    [cache setObject:@6 forIntegerKey:6];
+    XCTAssertEqual(cache.totalCount, 4);
+    XCTAssertFalse([cache containsObjectForIntegerKey:4]);
+    XCTAssertTrue([cache containsObjectForIntegerKey:2]);
+    XCTAssertTrue([cache containsObjectForIntegerKey:3]);
+    XCTAssertTrue([cache containsObjectForIntegerKey:5]);
+    XCTAssertTrue([cache containsObjectForIntegerKey:6]);
+}
+
+- (void)testARCEviction {
+    // 1 在 B1 中命中后进入 T2，和 0 一起在扫描中保留
+    [self _testEvictionPolicy:YYMemoryCacheEvictionPolicyARC hits:1 firstEvicted:1 secondEvicted:2 scanSurvivors:@[@0, @1]];
+}
+
+- (void)test2QEviction {
+    // A1in 中的命中不晋升，0 最先被淘汰；再次写入时在 A1out 中命中，进入 Am
+    [self _testEvictionPolicy:YYMemoryCacheEvictionPolicy2Q hits:1 firstEvicted:0 secondEvicted:1 scanSurvivors:@[@0]];
+}
+
+- (void)test2QGhostReadded {
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:16 shardCount:1 evictionPolicy:YYMemoryCacheEvictionPolicy2Q];
+    for (uint64_t i = 0; i <= 16; i++) [cache setObject:@(i) forIntegerKey:i];
+    // 0 在 A1out 中命中进入 Am，它在A1out队列中的旧项还在
+    [cache setObject:@0 forIntegerKey:0];
+    [cache removeObjectForIntegerKey:0];
+    for (uint64_t i = 2; i < 16; i++) [cache removeObjectForIntegerKey:i];
+
+    // 0 再次从 A1in 被淘汰，重新进入 A1out
+    [cache setObject:@0 forIntegerKey:0];
+    for (uint64_t i = 17; i <= 32; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertFalse([cache containsObjectForIntegerKey:0]);
+
+    // 旧项先出队，不能把仍在队列中的 0 从A1out中移除
+    for (uint64_t i = 100; i < 112; i++) [cache setObject:@(i) forIntegerKey:i];
+    [cache setObject:@0 forIntegerKey:0];
+    for (uint64_t i = 300; i < 332; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertTrue([cache containsObjectForIntegerKey:0]);
+    XCTAssertEqual(cache.totalCount, 16);
+}
+
+- (void)testS3FIFOEviction {
+    // 0 被访问过，离开小队列时进入主队列；1 在ghost中命中，直接进入主队列
+    [self _testEvictionPolicy:YYMemoryCacheEvictionPolicyS3FIFO hits:1 firstEvicted:1 secondEvicted:2 scanSurvivors:@[@0, @1]];
+}
+
+- (void)testRecentlyReadKeySurvivesScan {
+    YYMemoryCacheEvictionPolicy policies[] = {YYMemoryCacheEvictionPolicyLRU, YYMemoryCacheEvictionPolicyCLOCK, YYMemoryCacheEvictionPolicyBufferedLRU};
+    for (NSUInteger p = 0; p < 3; p++) {
+        YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:8 shardCount:1 evictionPolicy:policies[p]];
+        for (uint64_t i = 0; i < 8; i++) [cache setObject:@(i) forIntegerKey:i];
+        for (uint64_t i = 100; i < 200; i++) {
+            XCTAssertNotNil([cache objectForIntegerKey:0], @"policy %lu", (unsigned long)policies[p]);
+            [cache setObject:@(i) forIntegerKey:i];
+        }
+        XCTAssertEqual(cache.totalCount, 8);
+    }
+}
+
+- (void)testFrequentKeysSurviveScan {
+    // 扫描的key只访问一次，不会冲掉频繁访问的key
+    YYMemoryCacheEvictionPolicy policies[] = {YYMemoryCacheEvictionPolicyTinyLFU, YYMemoryCacheEvictionPolicyARC, YYMemoryCacheEvictionPolicyS3FIFO};
+    for (NSUInteger p = 0; p < 3; p++) {
+        YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:64 shardCount:1 evictionPolicy:policies[p]];
+        for (uint64_t i = 1000; i < 1008; i++) [cache setObject:@(i) forIntegerKey:i];
+        for (uint64_t i = 0; i < 56; i++) [cache setObject:@(i) forIntegerKey:i];
+        for (NSUInteger n = 0; n < 3; n++) {
+            for (uint64_t i = 1000; i < 1008; i++) XCTAssertNotNil([cache objectForIntegerKey:i]);
+        }
+        for (uint64_t i = 10000; i < 10500; i++) [cache setObject:@(i) forIntegerKey:i];
+        XCTAssertEqual(cache.totalCount, 64);
+        XCTAssertEqual([self _countIntegerKeysFrom:1000 to:1008 inCache:cache contained:YES], 8, @"policy %lu", (unsigned long)policies[p]);
+    }
+
+    // 2Q: A1in 中的命中无效，key被淘汰后再次写入才进入 Am
+    YYMemoryCache *cache = [[YYMemoryCache alloc] initWithCapacity:64 shardCount:1 evictionPolicy:YYMemoryCacheEvictionPolicy2Q];
+    for (uint64_t i = 1000; i < 1008; i++) [cache setObject:@(i) forIntegerKey:i];
+    for (uint64_t i = 0; i < 64; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertEqual([self _countIntegerKeysFrom:1000 to:1008 inCache:cache contained:NO], 8);
+    for (uint64_t i = 1000; i < 1008; i++) [cache setObject:@(i) forIntegerKey:i];
+    for (uint64_t i = 10000; i < 10500; i++) [cache setObject:@(i) forIntegerKey:i];
+    XCTAssertEqual(cache.totalCount, 64);
+    XCTAssertEqual([self _countIntegerKeysFrom:1000 to:1008 inCache:cache contained:YES], 8);
+}
+
+@end